@@ -0,0 +1,107 @@
+// Worker backed version of the `MnemonicWallet` class: the seed derivation, the key derivation
+// and the signing are performed inside a Web Worker so they don't block the page rendering.
+// Each method returns a Promise resolved with the result of the corresponding `MnemonicWallet`
+// method.
+import WalletWorker from "worker-loader!./wallet.worker.js";
+
+let worker = null;
+let nextRequestId = 1;
+const pendingRequests = new Map();
+
+/// Rejects all the pending requests and discards the worker, so the next call starts a new
+/// one. The wallets created inside the discarded worker can't be used anymore.
+function failWorker(failedWorker, error) {
+    if (worker !== failedWorker) {
+        return;
+    }
+    worker.terminate();
+    worker = null;
+    for (const request of pendingRequests.values()) {
+        request.reject(error);
+    }
+    pendingRequests.clear();
+}
+
+function getWorker() {
+    if (worker === null) {
+        const newWorker = new WalletWorker();
+        newWorker.addEventListener("message", ({data: {id, result, error}}) => {
+            const request = pendingRequests.get(id);
+            pendingRequests.delete(id);
+            if (error !== undefined) {
+                request.reject(new Error(error));
+            } else {
+                request.resolve(result);
+            }
+        });
+        newWorker.addEventListener("error", (event) => {
+            failWorker(newWorker, new Error(`wallet worker error: ${event.message}`));
+        });
+        newWorker.addEventListener("messageerror", () => {
+            failWorker(newWorker, new Error("unable to deserialize the wallet worker message"));
+        });
+        worker = newWorker;
+    }
+    return worker;
+}
+
+function call(method, walletId, ...args) {
+    return new Promise((resolve, reject) => {
+        const id = nextRequestId++;
+        pendingRequests.set(id, {resolve, reject});
+        getWorker().postMessage({id, method, walletId, args});
+    });
+}
+
+export class AsyncMnemonicWallet {
+    constructor(walletId) {
+        this.walletId = walletId;
+    }
+
+    /// Imports the wallet from the provided mnemonic.
+    static async create(mnemonic, derivationPath) {
+        return new AsyncMnemonicWallet(await call("create", null, mnemonic, derivationPath));
+    }
+
+    /// Creates a wallet from a random mnemonic, the mnemonic stays inside the worker until
+    /// it's requested with `exportMnemonic`.
+    static async random(derivationPath) {
+        return new AsyncMnemonicWallet(await call("random", null, derivationPath));
+    }
+
+    /// Sends the mnemonic of a wallet created with `random` to the main thread, e.g. to let
+    /// the user back it up.
+    exportMnemonic() {
+        return call("exportMnemonic", this.walletId);
+    }
+
+    setDerivationPath(derivationPath) {
+        return call("setDerivationPath", this.walletId, derivationPath);
+    }
+
+    getBech32Address(hrp) {
+        return call("getBech32Address", this.walletId, hrp);
+    }
+
+    getPubKey(compressed) {
+        return call("getPubKey", this.walletId, compressed);
+    }
+
+    sign(data) {
+        return call("sign", this.walletId, data);
+    }
+
+    /// Signs all the `payloads` with a single round trip to the worker.
+    signBatch(payloads) {
+        return call("signBatch", this.walletId, payloads);
+    }
+
+    deriveRange(basePath, start, count, hrp) {
+        return call("deriveRange", this.walletId, basePath, start, count, hrp);
+    }
+
+    /// Releases the wallet keys inside the worker.
+    free() {
+        return call("free", this.walletId);
+    }
+}
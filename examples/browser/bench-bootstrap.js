@@ -0,0 +1,3 @@
+// Like `bootstrap.js`, the benchmarks import the wasm code asynchronously.
+import("./bench-runner.js")
+  .catch(e => console.error("Error importing `bench-runner.js`:", e));
@@ -0,0 +1,54 @@
+import {MnemonicWallet} from "crw-wallet";
+import {AsyncMnemonicWallet} from "./async-wallet.js";
+
+const cosmos_dp = "m/44'/118'/0'/0/0";
+const mnemonic = "battle call once stool three mammal hybrid list sign field athlete amateur cinnamon eagle shell erupt voyage hero assist maple matrix maximum able barrel";
+const run_btn = document.getElementById("run_btn");
+const results = document.getElementById("results");
+
+// Runs `fn` `iterations` times and appends the average time to the results table.
+async function bench(name, iterations, fn) {
+    // Warm up the jit and the wallet caches
+    await fn();
+    const start = performance.now();
+    for (let i = 0; i < iterations; i++) {
+        await fn();
+    }
+    const elapsed = (performance.now() - start) / iterations;
+
+    const row = results.insertRow();
+    row.insertCell().textContent = name;
+    row.insertCell().textContent = iterations;
+    row.insertCell().textContent = `${elapsed.toFixed(3)} ms`;
+}
+
+async function runBenchmarks() {
+    const data = new Uint8Array(256).fill(42);
+    const payloads = Array.from({length: 100}, () => data);
+
+    await bench("new MnemonicWallet", 10, () => new MnemonicWallet(mnemonic, cosmos_dp).free());
+
+    const wallet = new MnemonicWallet(mnemonic, cosmos_dp);
+    await bench("setDerivationPath", 100, () => wallet.setDerivationPath(cosmos_dp));
+    await bench("getBech32Address", 1000, () => wallet.getBech32Address("cosmos"));
+    await bench("sign", 100, () => wallet.sign(data));
+    await bench("signBatch (100 payloads)", 10, () => wallet.signBatch(payloads));
+    wallet.free();
+
+    // The worker round trip cost on top of the same operations
+    await bench("AsyncMnemonicWallet.create", 10, async () => (await AsyncMnemonicWallet.create(mnemonic, cosmos_dp)).free());
+    const asyncWallet = await AsyncMnemonicWallet.create(mnemonic, cosmos_dp);
+    await bench("AsyncMnemonicWallet sign", 100, () => asyncWallet.sign(data));
+    await bench("AsyncMnemonicWallet signBatch (100 payloads)", 10, () => asyncWallet.signBatch(payloads));
+    await asyncWallet.free();
+}
+
+run_btn.addEventListener("click", async () => {
+    run_btn.disabled = true;
+    results.innerHTML = "";
+    try {
+        await runBenchmarks();
+    } finally {
+        run_btn.disabled = false;
+    }
+});
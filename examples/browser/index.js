@@ -1,15 +1,22 @@
-import {randomMnemonic, MnemonicWallet} from "crw-wallet";
+import {AsyncMnemonicWallet} from "./async-wallet.js";
 
 const cosmos_dp = "m/44'/118'/0'/0/0";
 const generate_btn = document.getElementById("generate_btn");
 const mnemonic_container = document.getElementById("mnemonic");
 const address_container = document.getElementById("address");
 
-generate_btn.addEventListener("click", () => {
-    const mnemonic = randomMnemonic();
-    const wallet = new MnemonicWallet(mnemonic, cosmos_dp);
-    const address = wallet.getBech32Address("cosmos");
-    mnemonic_container.textContent = mnemonic;
-    address_container.textContent = address;
-    wallet.free();
-});
\ No newline at end of file
+generate_btn.addEventListener("click", async () => {
+    generate_btn.disabled = true;
+    try {
+        // The keys are derived inside a worker so the page stays responsive.
+        const wallet = await AsyncMnemonicWallet.random(cosmos_dp);
+        const address = await wallet.getBech32Address("cosmos");
+        // The mnemonic is shown so that the user can back it up.
+        const mnemonic = await wallet.exportMnemonic();
+        mnemonic_container.textContent = mnemonic;
+        address_container.textContent = address;
+        await wallet.free();
+    } finally {
+        generate_btn.disabled = false;
+    }
+});
@@ -0,0 +1,95 @@
+// Web Worker that owns the wallets created from `AsyncMnemonicWallet`.
+// The derived keys never leave this worker, the main thread receives only the addresses, the
+// public keys and the signatures. The mnemonic of a random wallet is sent to the main thread
+// only when explicitly requested with an `exportMnemonic` message.
+
+const wallets = new Map();
+// Mnemonics of the wallets created from `random`, kept only until they are freed.
+const mnemonics = new Map();
+let nextWalletId = 1;
+
+// The wasm module must be imported asynchronously, the requests received before it's ready
+// wait for the same promise.
+const walletModule = import("crw-wallet");
+
+function getWallet(walletId) {
+    const wallet = wallets.get(walletId);
+    if (wallet === undefined) {
+        throw new Error("wallet already freed");
+    }
+    return wallet;
+}
+
+function addWallet(wallet) {
+    const walletId = nextWalletId++;
+    wallets.set(walletId, wallet);
+    return walletId;
+}
+
+const handlers = {
+    create({MnemonicWallet}, _, [mnemonic, derivationPath]) {
+        return addWallet(new MnemonicWallet(mnemonic, derivationPath));
+    },
+    random({MnemonicWallet, randomMnemonic}, _, [derivationPath]) {
+        const mnemonic = randomMnemonic();
+        const walletId = addWallet(new MnemonicWallet(mnemonic, derivationPath));
+        mnemonics.set(walletId, mnemonic);
+        return walletId;
+    },
+    exportMnemonic(_, walletId) {
+        getWallet(walletId);
+        const mnemonic = mnemonics.get(walletId);
+        if (mnemonic === undefined) {
+            throw new Error("the wallet has been imported from a mnemonic");
+        }
+        return mnemonic;
+    },
+    setDerivationPath(_, walletId, [derivationPath]) {
+        getWallet(walletId).setDerivationPath(derivationPath);
+    },
+    getBech32Address(_, walletId, [hrp]) {
+        return getWallet(walletId).getBech32Address(hrp);
+    },
+    getPubKey(_, walletId, [compressed]) {
+        return getWallet(walletId).getPubKey(compressed);
+    },
+    sign(_, walletId, [data]) {
+        return getWallet(walletId).sign(data);
+    },
+    signBatch(_, walletId, [payloads]) {
+        return getWallet(walletId).signBatch(payloads);
+    },
+    deriveRange(_, walletId, [basePath, start, count, hrp]) {
+        return getWallet(walletId).deriveRange(basePath, start, count, hrp);
+    },
+    free(_, walletId) {
+        const wallet = wallets.get(walletId);
+        if (wallet !== undefined) {
+            wallets.delete(walletId);
+            mnemonics.delete(walletId);
+            wallet.free();
+        }
+    },
+};
+
+// Collects the buffers of the typed arrays inside `value` so that they are transferred to the
+// main thread instead of being copied.
+function transferables(value, buffers = []) {
+    if (ArrayBuffer.isView(value)) {
+        buffers.push(value.buffer);
+    } else if (Array.isArray(value)) {
+        value.forEach(item => transferables(item, buffers));
+    } else if (value !== null && typeof value === "object") {
+        Object.values(value).forEach(item => transferables(item, buffers));
+    }
+    return buffers;
+}
+
+self.addEventListener("message", async ({data: {id, method, walletId, args}}) => {
+    try {
+        const result = handlers[method](await walletModule, walletId, args);
+        self.postMessage({id, result}, transferables(result));
+    } catch (e) {
+        self.postMessage({id, error: e instanceof Error ? e.message : String(e)});
+    }
+});
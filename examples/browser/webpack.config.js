@@ -2,13 +2,18 @@ const CopyWebpackPlugin = require("copy-webpack-plugin");
 const path = require('path');
 
 module.exports = {
-  entry: "./bootstrap.js",
+  entry: {
+    bootstrap: "./bootstrap.js",
+    bench: "./bench-bootstrap.js",
+  },
   output: {
     path: path.resolve(__dirname, "dist"),
-    filename: "bootstrap.js",
+    filename: "[name].js",
+    // Required to load the wallet worker bundle.
+    globalObject: "this",
   },
   mode: "development",
   plugins: [
-    new CopyWebpackPlugin(['index.html'])
+    new CopyWebpackPlugin(['index.html', 'bench.html'])
   ],
 };
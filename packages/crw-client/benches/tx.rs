@@ -0,0 +1,95 @@
+use cosmos_sdk_proto::cosmos::bank::v1beta1::MsgSend;
+use cosmos_sdk_proto::cosmos::base::v1beta1::Coin;
+use cosmos_sdk_proto::cosmos::tx::v1beta1::{Tx, TxRaw};
+use criterion::{black_box, criterion_group, criterion_main, BatchSize, Criterion};
+use crw_client::tx::TxBuilder;
+use crw_wallet::crypto::MnemonicWallet;
+
+static COSMOS_DERIVATION_PATH: &str = "m/44'/118'/0'/0/0";
+static TEST_MNEMONIC: &str = "battle call once stool three mammal hybrid list sign field athlete amateur cinnamon eagle shell erupt voyage hero assist maple matrix maximum able barrel";
+
+/// Builds a send transaction with `messages` messages.
+fn tx_builder(wallet: &MnemonicWallet, messages: usize) -> TxBuilder {
+    let from_address = wallet.get_bech32_address("cosmos").unwrap();
+    let mut builder = TxBuilder::new("testchain")
+        .memo("Bench memo")
+        .account_info(1, 5)
+        .fee("stake", "10", 300_000)
+        .timeout_height(1000);
+
+    for _ in 0..messages {
+        let msg_snd = MsgSend {
+            from_address: from_address.clone(),
+            to_address: "cosmos18ek6mnlxj8sysrtvu60k5zj0re7s5n42yncner".to_string(),
+            amount: vec![Coin {
+                denom: "stake".to_string(),
+                amount: "10".to_string(),
+            }],
+        };
+        builder = builder
+            .add_message("/cosmos.bank.v1beta1.MsgSend", msg_snd)
+            .unwrap();
+    }
+
+    builder
+}
+
+fn bench_sign(c: &mut Criterion) {
+    let wallet = MnemonicWallet::new(TEST_MNEMONIC, COSMOS_DERIVATION_PATH).unwrap();
+
+    let mut group = c.benchmark_group("TxBuilder::sign");
+    for messages in [1, 100].iter() {
+        let builder = tx_builder(&wallet, *messages);
+        group.bench_function(format!("{} messages", messages), |b| {
+            b.iter_batched(
+                || builder.clone(),
+                |builder| builder.sign(&wallet).unwrap(),
+                BatchSize::SmallInput,
+            )
+        });
+    }
+    group.finish();
+}
+
+/// Serializes a [Tx] as [CosmosClient::broadcast_tx](crw_client::client::CosmosClient::broadcast_tx)
+/// does before sending it.
+fn encode_tx(tx: &Tx) -> Vec<u8> {
+    let mut tx_raw = TxRaw {
+        body_bytes: Vec::new(),
+        auth_info_bytes: Vec::new(),
+        signatures: tx.signatures.clone(),
+    };
+    if let Some(body) = &tx.body {
+        prost::Message::encode(body, &mut tx_raw.body_bytes).unwrap();
+    }
+    if let Some(auth_info) = &tx.auth_info {
+        prost::Message::encode(auth_info, &mut tx_raw.auth_info_bytes).unwrap();
+    }
+
+    encode_tx_raw(&tx_raw)
+}
+
+/// Serializes a [TxRaw] as
+/// [CosmosClient::broadcast_tx_raw](crw_client::client::CosmosClient::broadcast_tx_raw) does
+/// before sending it.
+fn encode_tx_raw(tx_raw: &TxRaw) -> Vec<u8> {
+    let mut serialized = Vec::with_capacity(prost::Message::encoded_len(tx_raw));
+    prost::Message::encode(tx_raw, &mut serialized).unwrap();
+    serialized
+}
+
+fn bench_broadcast_encode(c: &mut Criterion) {
+    let wallet = MnemonicWallet::new(TEST_MNEMONIC, COSMOS_DERIVATION_PATH).unwrap();
+    let tx = tx_builder(&wallet, 100).sign(&wallet).unwrap();
+    let tx_raw = tx_builder(&wallet, 100).sign_raw(&wallet).unwrap();
+
+    let mut group = c.benchmark_group("broadcast encode");
+    group.bench_function("broadcast_tx", |b| b.iter(|| encode_tx(black_box(&tx))));
+    group.bench_function("broadcast_tx_raw", |b| {
+        b.iter(|| encode_tx_raw(black_box(&tx_raw)))
+    });
+    group.finish();
+}
+
+criterion_group!(benches, bench_sign, bench_broadcast_encode);
+criterion_main!(benches);
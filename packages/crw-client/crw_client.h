@@ -0,0 +1,154 @@
+#ifndef CRW_CLIENT_H
+#define CRW_CLIENT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief This C header file exposes the FFI defined inside the crw-client crate.
+ * The requests are performed asynchronously inside a multi-threaded runtime shared from
+ * all the clients: each function submits the request and returns immediately, the result
+ * is then delivered to a callback invoked from one of the runtime threads.
+ */
+
+typedef struct cosmos_client cosmos_client_t;
+
+/**
+ * @brief Struct that represents the data of an account.
+ */
+typedef struct {
+  /**
+   * @brief The account bech32 address.
+   */
+  const char *address;
+  /**
+   * @brief The account number.
+   */
+  uint64_t account_number;
+  /**
+   * @brief The account sequence.
+   */
+  uint64_t sequence;
+} account_data_t;
+
+/**
+ * @brief Struct that represents the response of a tx broadcast.
+ */
+typedef struct {
+  /**
+   * @brief The response code, 0 if the tx has been accepted.
+   */
+  uint32_t code;
+  /**
+   * @brief The block height, 0 if the tx has not been included into a block yet.
+   */
+  int64_t height;
+  /**
+   * @brief The tx gas limit.
+   */
+  int64_t gas_wanted;
+  /**
+   * @brief The gas used executing the tx.
+   */
+  int64_t gas_used;
+  /**
+   * @brief The tx hash as hex string.
+   */
+  const char *txhash;
+  /**
+   * @brief The namespace of the response code.
+   */
+  const char *codespace;
+  /**
+   * @brief The log of the tx execution.
+   */
+  const char *raw_log;
+} broadcast_response_t;
+
+/**
+ * @brief Callback that receives the result of cosmos_client_get_account_data.
+ * @param user_data: The user_data passed to cosmos_client_get_account_data.
+ * @param account: The account data on success or NULL on error.
+ * @param error: NULL on success or the error cause on error.
+ * Both account and error are valid only until the callback returns.
+ */
+typedef void (*account_data_callback_t)(void *user_data, const account_data_t *account,
+                                        const char *error);
+
+/**
+ * @brief Callback that receives the result of cosmos_client_broadcast_tx.
+ * @param user_data: The user_data passed to cosmos_client_broadcast_tx.
+ * @param response: The broadcast response on success or NULL on error.
+ * @param error: NULL on success or the error cause on error.
+ * Both response and error are valid only until the callback returns.
+ */
+typedef void (*broadcast_callback_t)(void *user_data, const broadcast_response_t *response,
+                                     const char *error);
+
+/**
+ * @brief Creates a client that communicates with a full node.
+ * @param lcd_addr: The address used for the legacy LCD requests.
+ * @param grpc_addr: The address used for the gRPC requests.
+ * @return Returns a valid pointer on success or NULL on error.
+ * The caller must take care of releasing the returned client with the
+ * cosmos_client_free function.
+ * In case of error the error cause can be obtained using the error_message_utf8
+ * function.
+ */
+cosmos_client_t *cosmos_client_new(const char *lcd_addr, const char *grpc_addr);
+
+/**
+ * @brief Release all the resources owned by a client instance.
+ * The requests already submitted with the client are completed anyway.
+ * @param client: Pointer to the client instance to free.
+ */
+void cosmos_client_free(cosmos_client_t *client);
+
+/**
+ * @brief Submits a request to get the data of an account.
+ * This function doesn't block, the result is delivered to callback.
+ * @param client: Pointer to the client instance.
+ * @param address: The account bech32 address.
+ * @param callback: The callback that receives the result.
+ * @param user_data: Pointer passed back to callback.
+ * @return Returns 0 if the request has been submitted or -1 if one of the provided
+ * arguments is invalid, in this case callback is never invoked.
+ */
+int cosmos_client_get_account_data(const cosmos_client_t *client, const char *address,
+                                   account_data_callback_t callback, void *user_data);
+
+/**
+ * @brief Submits a request to broadcast a signed tx.
+ * This function doesn't block, the result is delivered to callback.
+ * @param client: Pointer to the client instance.
+ * @param tx_raw: The protobuf serialized cosmos.tx.v1beta1.TxRaw, the bytes are copied
+ * so the buffer can be released as soon as this function returns.
+ * @param len: The length of tx_raw.
+ * @param mode: The broadcast mode, 1 for block, 2 for sync or 3 for async.
+ * @param callback: The callback that receives the result.
+ * @param user_data: Pointer passed back to callback.
+ * @return Returns 0 if the request has been submitted or -1 if one of the provided
+ * arguments is invalid, in this case callback is never invoked.
+ */
+int cosmos_client_broadcast_tx(const cosmos_client_t *client, const uint8_t *tx_raw, size_t len,
+                               int mode, broadcast_callback_t callback, void *user_data);
+
+/**
+ * @brief Clears the last error.
+ */
+void clear_last_error();
+
+/**
+ * @brief Gets the last error message length.
+ */
+int last_error_length();
+
+/**
+ * @brief Gets the last error message as UTF-8 encoded string.
+ * @param out_buf: Pointer where will be stored the error message.
+ * @param buf_size: Size of out_buf.
+ * @return Returns the number of bytes wrote into out_buf or -1 on error.
+ */
+int error_message_utf8(char *out_buf, int buf_size);
+
+#endif /* CRW_CLIENT_H */
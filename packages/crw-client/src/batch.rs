@@ -0,0 +1,444 @@
+//! Module to pack many messages into as few transactions as possible.
+//!
+//! This module provides a [`MessageBatcher`] that collects the messages to send and splits them
+//! in chunks that respect a maximum gas and a maximum size per transaction, then signs and
+//! broadcasts each chunk as a single multi-message transaction.
+
+use crate::broadcaster::Broadcaster;
+use crate::error::{CosmosError, TxBuildError};
+use cosmos_sdk_proto::cosmos::base::abci::v1beta1::TxResponse;
+use prost::encoding::encoded_len_varint;
+use prost_types::Any;
+use std::collections::VecDeque;
+
+/// Default gas consumed by a transaction regardless of its messages, mostly spent to verify
+/// the signature.
+const DEFAULT_BASE_GAS: u64 = 80_000;
+/// Gas consumed for each byte of the transaction, the cosmos sdk `TxSizeCostPerByte` default.
+const DEFAULT_GAS_PER_BYTE: u64 = 10;
+/// Upper bound of the transaction bytes that don't depend on the messages: the auth info with
+/// the signer public key and the fee, the signature, the memo and the envelopes framing.
+const TX_OVERHEAD_BYTES: usize = 512;
+
+/// A queued message with its estimated gas and encoded size.
+struct QueuedMessage {
+    msg: Any,
+    gas: u64,
+    size: usize,
+}
+
+/// Batcher that packs the queued messages into multi-message transactions.
+///
+/// The messages are sent in the same order in which they are pushed, each transaction contains
+/// as many consecutive messages as possible without exceeding the maximum gas and size.
+/// The transaction gas limit is estimated adding the gas of the messages to the base gas of the
+/// transaction and the gas consumed for its size, the fee is then computed from the gas price.
+pub struct MessageBatcher {
+    queue: VecDeque<QueuedMessage>,
+    max_gas_per_tx: u64,
+    max_tx_bytes: usize,
+    base_gas: u64,
+    gas_per_byte: u64,
+    gas_price: Option<(String, f64)>,
+}
+
+impl MessageBatcher {
+    /// Creates a new batcher that produces transactions with at most `max_gas_per_tx` gas and
+    /// `max_tx_bytes` bytes.
+    pub fn new(max_gas_per_tx: u64, max_tx_bytes: usize) -> MessageBatcher {
+        MessageBatcher {
+            queue: VecDeque::new(),
+            max_gas_per_tx,
+            max_tx_bytes,
+            base_gas: DEFAULT_BASE_GAS,
+            gas_per_byte: DEFAULT_GAS_PER_BYTE,
+            gas_price: None,
+        }
+    }
+
+    /// Sets the gas consumed by each transaction regardless of its messages.
+    pub fn base_gas(mut self, base_gas: u64) -> Self {
+        self.base_gas = base_gas;
+        self
+    }
+
+    /// Sets the gas consumed for each byte of the transaction.
+    pub fn gas_per_byte(mut self, gas_per_byte: u64) -> Self {
+        self.gas_per_byte = gas_per_byte;
+        self
+    }
+
+    /// Sets the price paid for each unit of gas, the fee of each transaction is its gas limit
+    /// multiplied by `price` rounded up.
+    pub fn gas_price(mut self, denom: &str, price: f64) -> Self {
+        self.gas_price = Some((denom.to_owned(), price));
+        self
+    }
+
+    /// Appends a message to the queue.
+    ///
+    /// * `msg_type` - the message type url.
+    /// * `msg` - the message.
+    /// * `gas` - the gas consumed executing the message.
+    ///
+    /// # Errors
+    /// Returns a [`CosmosError::Encode`] if the message can't be serialized or if a transaction
+    /// containing only this message would exceed the maximum gas or size.
+    pub fn push<M: prost::Message>(
+        &mut self,
+        msg_type: &str,
+        msg: M,
+        gas: u64,
+    ) -> Result<(), CosmosError> {
+        let mut value = Vec::with_capacity(msg.encoded_len());
+        msg.encode(&mut value)?;
+
+        self.push_any(
+            Any {
+                type_url: msg_type.to_owned(),
+                value,
+            },
+            gas,
+        )
+    }
+
+    /// Appends an already serialized message to the queue.
+    ///
+    /// # Errors
+    /// Returns a [`CosmosError::Encode`] if a transaction containing only this message would
+    /// exceed the maximum gas or size.
+    pub fn push_any(&mut self, msg: Any, gas: u64) -> Result<(), CosmosError> {
+        let len = prost::Message::encoded_len(&msg);
+        // The message is encoded into the tx body as a length delimited field with a 1 byte tag
+        let size = 1 + encoded_len_varint(len as u64) + len;
+
+        if size + TX_OVERHEAD_BYTES > self.max_tx_bytes
+            || self.tx_gas(gas, size) > self.max_gas_per_tx
+        {
+            return Err(CosmosError::Encode(format!(
+                "message {} exceeds the transaction limits",
+                msg.type_url
+            )));
+        }
+
+        self.queue.push_back(QueuedMessage { msg, gas, size });
+        Ok(())
+    }
+
+    /// Returns the number of queued messages.
+    pub fn len(&self) -> usize {
+        self.queue.len()
+    }
+
+    /// Tells if there are no queued messages.
+    pub fn is_empty(&self) -> bool {
+        self.queue.is_empty()
+    }
+
+    /// Estimates the gas limit of a transaction with messages consuming `messages_gas`
+    /// and occupying `messages_size` bytes.
+    /// The estimation saturates at [u64::MAX] so that an oversized chunk exceeds any gas limit
+    /// instead of wrapping around.
+    fn tx_gas(&self, messages_gas: u64, messages_size: usize) -> u64 {
+        let tx_size = messages_size.saturating_add(TX_OVERHEAD_BYTES) as u64;
+        self.base_gas
+            .saturating_add(self.gas_per_byte.saturating_mul(tx_size))
+            .saturating_add(messages_gas)
+    }
+
+    /// Removes from the queue the messages of the next transaction.
+    /// Returns the messages together with the transaction gas limit.
+    fn next_chunk(&mut self) -> Option<(Vec<Any>, u64)> {
+        if self.queue.is_empty() {
+            return None;
+        }
+
+        let mut gas = 0;
+        let mut size = 0;
+        let mut count = 0;
+        for queued in self.queue.iter() {
+            let chunk_gas = gas.saturating_add(queued.gas);
+            let chunk_size = size.saturating_add(queued.size);
+            if count > 0
+                && (chunk_size.saturating_add(TX_OVERHEAD_BYTES) > self.max_tx_bytes
+                    || self.tx_gas(chunk_gas, chunk_size) > self.max_gas_per_tx)
+            {
+                break;
+            }
+            gas = chunk_gas;
+            size = chunk_size;
+            count += 1;
+        }
+
+        let messages = self.queue.drain(..count).map(|queued| queued.msg).collect();
+        Some((messages, self.tx_gas(gas, size)))
+    }
+
+    /// Puts back at the head of the queue the messages of a chunk that has not been sent.
+    fn restore_chunk(&mut self, messages: Vec<Any>, gas_limit: u64) {
+        let sizes: Vec<usize> = messages
+            .iter()
+            .map(|msg| {
+                let len = prost::Message::encoded_len(msg);
+                1 + encoded_len_varint(len as u64) + len
+            })
+            .collect();
+        // The gas of the single messages is lost, so the whole messages gas is assigned to
+        // the first message so that the chunk is rebuilt identical.
+        let messages_gas = gas_limit - self.tx_gas(0, sizes.iter().sum());
+
+        for (i, (msg, size)) in messages.into_iter().zip(sizes).enumerate().rev() {
+            let gas = if i == 0 { messages_gas } else { 0 };
+            self.queue.push_front(QueuedMessage { msg, gas, size });
+        }
+    }
+
+    /// Computes the `(denom, amount)` fee of a transaction with `gas_limit`, from the gas price
+    /// of the batcher if set, otherwise from the price of the `fallback` fee, that is its amount
+    /// divided by its gas limit.
+    ///
+    /// # Errors
+    /// Returns a [`CosmosError::Sign`] if there is neither a gas price nor a valid fallback fee.
+    fn chunk_fee(
+        &self,
+        fallback: Option<&(String, String, u64)>,
+        gas_limit: u64,
+    ) -> Result<(String, String), CosmosError> {
+        let (denom, price) = match (&self.gas_price, fallback) {
+            (Some((denom, price)), _) => (denom, *price),
+            (None, Some((denom, amount, fee_gas_limit))) => {
+                let amount: f64 = amount
+                    .parse()
+                    .map_err(|_| CosmosError::Sign(format!("invalid fee amount {}", amount)))?;
+                (denom, amount / (*fee_gas_limit).max(1) as f64)
+            }
+            (None, None) => return Err(CosmosError::from(TxBuildError::NoFee)),
+        };
+
+        Ok((
+            denom.to_owned(),
+            ((gas_limit as f64) * price).ceil().to_string(),
+        ))
+    }
+
+    /// Signs and broadcasts all the queued messages using `broadcaster`, packed into as few
+    /// transactions as possible.
+    /// Each transaction pays its estimated gas limit at the price set with
+    /// [`MessageBatcher::gas_price`], or at the price of the [`Broadcaster::fee`] if not set.
+    /// Returns the broadcast response of each transaction.
+    /// The messages of the transactions rejected from the node mempool check are removed from
+    /// the queue too, their responses have a non-zero `code`.
+    ///
+    /// # Errors
+    /// Returns an [`Err`] if there is no fee to pay or a transaction can't be signed or
+    /// broadcast, in this case the messages that have not been sent remain into the queue.
+    pub async fn flush(
+        &mut self,
+        broadcaster: &Broadcaster,
+    ) -> Result<Vec<TxResponse>, CosmosError> {
+        let mut responses = Vec::new();
+
+        while let Some((messages, gas_limit)) = self.next_chunk() {
+            let result = match self.chunk_fee(broadcaster.default_fee(), gas_limit) {
+                Ok((denom, amount)) => {
+                    broadcaster
+                        .broadcast_with_fee(
+                            &messages,
+                            Some((denom.as_str(), amount.as_str(), gas_limit)),
+                        )
+                        .await
+                }
+                Err(e) => Err(e),
+            };
+
+            match result {
+                Ok(response) => responses.push(response),
+                Err(e) => {
+                    self.restore_chunk(messages, gas_limit);
+                    return Err(e);
+                }
+            }
+        }
+
+        Ok(responses)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use cosmos_sdk_proto::cosmos::{bank::v1beta1::MsgSend, base::v1beta1::Coin};
+
+    fn msg_send(amount: u64) -> MsgSend {
+        MsgSend {
+            from_address: "desmos1dzczdka6wpzwvmawpps7tf8047gkft0e5cupun".to_string(),
+            to_address: "desmos18ek6mnlxj8sysrtvu60k5zj0re7s5n42yncner".to_string(),
+            amount: vec![Coin {
+                denom: "stake".to_string(),
+                amount: amount.to_string(),
+            }],
+        }
+    }
+
+    fn chunk_sizes(batcher: &mut MessageBatcher) -> Vec<usize> {
+        let mut sizes = Vec::new();
+        while let Some((messages, gas_limit)) = batcher.next_chunk() {
+            assert!(gas_limit <= batcher.max_gas_per_tx);
+            sizes.push(messages.len());
+        }
+        sizes
+    }
+
+    #[test]
+    fn chunks_by_gas() {
+        let mut batcher = MessageBatcher::new(200_000, 1_000_000)
+            .base_gas(50_000)
+            .gas_per_byte(0);
+        for i in 0..10 {
+            batcher
+                .push("/cosmos.bank.v1beta1.MsgSend", msg_send(i), 40_000)
+                .unwrap();
+        }
+
+        // 50_000 + 3 * 40_000 <= 200_000
+        assert_eq!(vec![3, 3, 3, 1], chunk_sizes(&mut batcher));
+        assert!(batcher.is_empty());
+    }
+
+    #[test]
+    fn chunk_fee() {
+        let broadcaster_fee = ("stake".to_owned(), "5000".to_owned(), 200_000);
+
+        // Without a gas price the broadcaster fee price is used
+        let batcher = MessageBatcher::new(200_000, 1_000_000);
+        assert_eq!(
+            Ok(("stake".to_owned(), "2500".to_owned())),
+            batcher.chunk_fee(Some(&broadcaster_fee), 100_000)
+        );
+        assert_eq!(
+            Err(CosmosError::from(TxBuildError::NoFee)),
+            batcher.chunk_fee(None, 100_000)
+        );
+
+        let batcher = batcher.gas_price("udsm", 0.01);
+        assert_eq!(
+            Ok(("udsm".to_owned(), "1000".to_owned())),
+            batcher.chunk_fee(Some(&broadcaster_fee), 100_000)
+        );
+    }
+
+    #[actix_rt::test]
+    async fn flush_without_fee() {
+        let wallet = crw_wallet::crypto::MnemonicWallet::new(
+            "elephant luggage finger obscure nest smooth flag clay recycle unfair capital category organ bicycle gallery sight canyon hotel dutch skull today pink scale aisle",
+            "m/44'/852'/0'/0/0",
+        )
+        .unwrap();
+        let client =
+            crate::client::CosmosClient::new("http://localhost:1317", "http://localhost:9090")
+                .unwrap();
+        let broadcaster = Broadcaster::new(client, wallet, "testchain", "desmos").unwrap();
+
+        let mut batcher = MessageBatcher::new(200_000, 1_000_000);
+        batcher
+            .push("/cosmos.bank.v1beta1.MsgSend", msg_send(1), 40_000)
+            .unwrap();
+
+        // The messages are kept when there is no fee to pay
+        assert_eq!(
+            Err(CosmosError::from(TxBuildError::NoFee)),
+            batcher.flush(&broadcaster).await
+        );
+        assert_eq!(1, batcher.len());
+    }
+
+    #[test]
+    fn gas_estimation_saturates() {
+        let mut batcher = MessageBatcher::new(u64::MAX, 1_000_000).gas_per_byte(u64::MAX);
+        assert_eq!(u64::MAX, batcher.tx_gas(1, 1));
+
+        // The sum of the messages gas would overflow, so they are sent in distinct transactions
+        let mut batcher = MessageBatcher::new(u64::MAX, 1_000_000)
+            .base_gas(0)
+            .gas_per_byte(0);
+        for i in 0..2 {
+            batcher
+                .push(
+                    "/cosmos.bank.v1beta1.MsgSend",
+                    msg_send(i),
+                    u64::MAX / 2 + 1,
+                )
+                .unwrap();
+        }
+        assert_eq!(vec![1, 1], chunk_sizes(&mut batcher));
+    }
+
+    #[test]
+    fn chunks_by_size() {
+        let msg = msg_send(1);
+        let len = prost::Message::encoded_len(&Any {
+            type_url: "/cosmos.bank.v1beta1.MsgSend".to_owned(),
+            value: vec![0; prost::Message::encoded_len(&msg)],
+        });
+        let msg_size = 1 + encoded_len_varint(len as u64) + len;
+
+        let mut batcher =
+            MessageBatcher::new(u64::MAX, TX_OVERHEAD_BYTES + msg_size * 4).gas_per_byte(0);
+        for _ in 0..10 {
+            batcher
+                .push("/cosmos.bank.v1beta1.MsgSend", msg.clone(), 0)
+                .unwrap();
+        }
+
+        assert_eq!(vec![4, 4, 2], chunk_sizes(&mut batcher));
+    }
+
+    #[test]
+    fn chunks_preserve_order() {
+        let mut batcher = MessageBatcher::new(200_000, 1_000_000)
+            .base_gas(0)
+            .gas_per_byte(0);
+        for i in 0..5 {
+            batcher
+                .push("/cosmos.bank.v1beta1.MsgSend", msg_send(i), 100_000)
+                .unwrap();
+        }
+
+        let mut amounts = Vec::new();
+        while let Some((messages, _)) = batcher.next_chunk() {
+            for msg in messages {
+                let msg: MsgSend = prost::Message::decode(msg.value.as_ref()).unwrap();
+                amounts.push(msg.amount[0].amount.clone());
+            }
+        }
+        assert_eq!(vec!["0", "1", "2", "3", "4"], amounts);
+    }
+
+    #[test]
+    fn restore_chunk() {
+        let mut batcher = MessageBatcher::new(200_000, 1_000_000);
+        for i in 0..4 {
+            batcher
+                .push("/cosmos.bank.v1beta1.MsgSend", msg_send(i), 20_000)
+                .unwrap();
+        }
+
+        let (messages, gas_limit) = batcher.next_chunk().unwrap();
+        batcher.restore_chunk(messages.clone(), gas_limit);
+
+        assert_eq!(4, batcher.len());
+        assert_eq!(Some((messages, gas_limit)), batcher.next_chunk());
+    }
+
+    #[test]
+    fn message_too_large() {
+        let mut batcher = MessageBatcher::new(100_000, 1_000_000);
+
+        assert!(batcher
+            .push("/cosmos.bank.v1beta1.MsgSend", msg_send(1), 100_000)
+            .is_err());
+        assert!(MessageBatcher::new(u64::MAX, TX_OVERHEAD_BYTES)
+            .push("/cosmos.bank.v1beta1.MsgSend", msg_send(1), 0)
+            .is_err());
+    }
+}
@@ -0,0 +1,384 @@
+//! Module to broadcast many transactions from the same account.
+//!
+//! This module provides a [`Broadcaster`] that keeps track of the account sequence locally, so
+//! that the transactions can be signed and sent one after the other without querying the account
+//! data or waiting for them to be included in a block.
+
+use crate::client::CosmosClient;
+use crate::error::CosmosError;
+use crate::tx::TxBuilder;
+use cosmos_sdk_proto::cosmos::{
+    base::abci::v1beta1::TxResponse,
+    tx::v1beta1::{BroadcastMode, TxRaw},
+};
+use crw_wallet::crypto::MnemonicWallet;
+use prost_types::Any;
+use tokio::sync::{Mutex, Semaphore};
+
+/// Default maximum number of transactions waiting for the broadcast response.
+const DEFAULT_MAX_IN_FLIGHT: usize = 16;
+/// Default number of times a transaction is signed again after a sequence mismatch.
+const DEFAULT_MAX_RETRIES: usize = 3;
+/// Codespace of the errors raised from the cosmos sdk.
+const SDK_CODESPACE: &str = "sdk";
+/// Code of the cosmos sdk `ErrWrongSequence` error.
+const WRONG_SEQUENCE_CODE: u32 = 32;
+
+/// Account sequence tracked locally.
+struct SequenceState {
+    account_number: u64,
+    sequence: u64,
+    /// Tells if `account_number` and `sequence` have been fetched from the chain.
+    synced: bool,
+    /// Incremented at each resync, used to resync only once for all the transactions
+    /// signed with the same stale sequence.
+    generation: u64,
+}
+
+/// Broadcaster that signs and sends the transactions of a single account.
+///
+/// The account data are fetched only once and then the sequence is incremented locally for each
+/// transaction. The transactions are broadcast in [`BroadcastMode::Sync`], so each broadcast only
+/// waits for the node mempool check, and up to a configurable number of broadcasts can be in
+/// flight at the same time.
+/// If the node rejects a transaction because of a sequence mismatch the local sequence is
+/// resynchronized and the transaction is signed and sent again, if it's rejected for other
+/// reasons its sequence is reused from the next transaction.
+pub struct Broadcaster {
+    client: CosmosClient,
+    wallet: MnemonicWallet,
+    address: String,
+    chain_id: String,
+    memo: String,
+    fee: Option<(String, String, u64)>,
+    max_retries: usize,
+    in_flight: Semaphore,
+    state: Mutex<SequenceState>,
+}
+
+impl Broadcaster {
+    /// Creates a new broadcaster that sends the transactions signed with `wallet` to the chain
+    /// with the provided `chain_id` through `client`.
+    ///
+    /// * `hrp` - the human readable part of the chain addresses.
+    ///
+    /// # Errors
+    /// Returns a [`CosmosError::Sign`] if the wallet address can't be derived with `hrp`.
+    pub fn new(
+        client: CosmosClient,
+        wallet: MnemonicWallet,
+        chain_id: &str,
+        hrp: &str,
+    ) -> Result<Broadcaster, CosmosError> {
+        let address = wallet
+            .get_bech32_address(hrp)
+            .map_err(|e| CosmosError::Sign(e.to_string()))?;
+
+        Ok(Broadcaster {
+            client,
+            wallet,
+            address,
+            chain_id: chain_id.to_owned(),
+            memo: String::new(),
+            fee: None,
+            max_retries: DEFAULT_MAX_RETRIES,
+            in_flight: Semaphore::new(DEFAULT_MAX_IN_FLIGHT),
+            state: Mutex::new(SequenceState {
+                account_number: 0,
+                sequence: 0,
+                synced: false,
+                generation: 0,
+            }),
+        })
+    }
+
+    /// Sets the fee paid by each transaction.
+    pub fn fee(mut self, denom: &str, amount: &str, gas_limit: u64) -> Self {
+        self.fee = Some((denom.to_owned(), amount.to_owned(), gas_limit));
+        self
+    }
+
+    /// Sets the memo of each transaction.
+    pub fn memo(mut self, memo: &str) -> Self {
+        self.memo = memo.to_owned();
+        self
+    }
+
+    /// Sets the maximum number of transactions waiting for the broadcast response, the
+    /// exceeding transactions wait until one of the previous completes.
+    /// A `max_in_flight` of 0 is clamped to 1, otherwise no transaction could ever be sent.
+    pub fn max_in_flight(mut self, max_in_flight: usize) -> Self {
+        self.in_flight = Semaphore::new(max_in_flight.max(1));
+        self
+    }
+
+    /// Sets the number of times a transaction is signed and sent again after being rejected
+    /// because of a sequence mismatch.
+    pub fn max_retries(mut self, max_retries: usize) -> Self {
+        self.max_retries = max_retries;
+        self
+    }
+
+    /// Gets the `(denom, amount, gas_limit)` fee set with [`Broadcaster::fee`].
+    pub(crate) fn default_fee(&self) -> Option<&(String, String, u64)> {
+        self.fee.as_ref()
+    }
+
+    /// Gets the address of the account that signs the transactions.
+    pub fn address(&self) -> &str {
+        &self.address
+    }
+
+    /// Signs a transaction containing `messages` with the next account sequence and
+    /// broadcasts it.
+    /// Returns the response of the node mempool check, the transaction has been accepted if
+    /// its `code` is 0.
+    ///
+    /// # Errors
+    /// Returns an [`Err`] if the account data can't be fetched, the transaction can't be signed
+    /// or the broadcast fails.
+    pub async fn broadcast(&self, messages: &[Any]) -> Result<TxResponse, CosmosError> {
+        let fee = self
+            .fee
+            .as_ref()
+            .map(|(denom, amount, gas_limit)| (denom.as_str(), amount.as_str(), *gas_limit));
+
+        self.broadcast_with_fee(messages, fee).await
+    }
+
+    /// Same as [`Broadcaster::broadcast`] but the transaction pays the provided
+    /// `(denom, amount, gas_limit)` fee instead of the one configured with [`Broadcaster::fee`].
+    ///
+    /// # Errors
+    /// Returns an [`Err`] if the account data can't be fetched, the transaction can't be signed
+    /// or the broadcast fails.
+    pub async fn broadcast_with_fee(
+        &self,
+        messages: &[Any],
+        fee: Option<(&str, &str, u64)>,
+    ) -> Result<TxResponse, CosmosError> {
+        let _permit = self
+            .in_flight
+            .acquire()
+            .await
+            .map_err(|e| CosmosError::Grpc(e.to_string()))?;
+
+        let mut retries = 0;
+        loop {
+            let (tx_raw, sequence, generation) = self.sign_next(messages, fee).await?;
+
+            let response = match self
+                .client
+                .broadcast_tx_raw(&tx_raw, BroadcastMode::Sync)
+                .await
+            {
+                Ok(Some(response)) => response,
+                Ok(None) => {
+                    return Err(CosmosError::Grpc("empty broadcast response".to_owned()));
+                }
+                Err(e) => {
+                    // The tx may or may not have reached the mempool, so the local
+                    // sequence can't be trusted anymore.
+                    self.resync(generation, None).await;
+                    return Err(e);
+                }
+            };
+
+            if response.code == 0 {
+                return Ok(response);
+            }
+            if !is_sequence_mismatch(&response) {
+                self.on_rejected(generation, sequence).await;
+                return Ok(response);
+            }
+            if retries >= self.max_retries {
+                return Ok(response);
+            }
+
+            self.resync(generation, expected_sequence(&response.raw_log))
+                .await;
+            retries += 1;
+        }
+    }
+
+    /// Builds and signs a transaction containing `messages` with the next account sequence.
+    /// Returns the signed tx together with the sequence used to sign it and its generation.
+    async fn sign_next(
+        &self,
+        messages: &[Any],
+        fee: Option<(&str, &str, u64)>,
+    ) -> Result<(TxRaw, u64, u64), CosmosError> {
+        let mut state = self.state.lock().await;
+
+        if !state.synced {
+            let account = self.client.get_account_data(&self.address).await?;
+            state.account_number = account.account_number;
+            state.sequence = account.sequence;
+            state.synced = true;
+        }
+
+        let mut builder = TxBuilder::new(&self.chain_id)
+            .memo(&self.memo)
+            .account_info(state.sequence, state.account_number);
+        if let Some((denom, amount, gas_limit)) = fee {
+            builder = builder.fee(denom, amount, gas_limit);
+        }
+        let tx_raw = messages
+            .iter()
+            .cloned()
+            .fold(builder, TxBuilder::add_any_message)
+            .sign_raw(&self.wallet)?;
+
+        // Increment the sequence only once the tx has been signed successfully
+        let sequence = state.sequence;
+        state.sequence += 1;
+        Ok((tx_raw, sequence, state.generation))
+    }
+
+    /// Rolls back the local sequence after the mempool check rejected the tx signed with
+    /// `sequence` for a reason other than a sequence mismatch, since the chain has not consumed
+    /// it. The txs signed after it are rejected with a sequence mismatch and signed again.
+    async fn on_rejected(&self, generation: u64, sequence: u64) {
+        self.resync(generation, Some(sequence)).await;
+    }
+
+    /// Resynchronizes the local sequence if it has not already been done since `generation`.
+    /// If the node reported the `expected` sequence it is used directly, otherwise the account
+    /// data will be fetched again before signing the next tx.
+    async fn resync(&self, generation: u64, expected: Option<u64>) {
+        let mut state = self.state.lock().await;
+        if state.generation != generation {
+            return;
+        }
+
+        state.generation += 1;
+        match expected {
+            Some(sequence) => state.sequence = sequence,
+            None => state.synced = false,
+        }
+    }
+}
+
+/// Tells if the tx has been rejected because it was signed with a wrong sequence.
+pub(crate) fn is_sequence_mismatch(response: &TxResponse) -> bool {
+    response.code == WRONG_SEQUENCE_CODE && response.codespace == SDK_CODESPACE
+}
+
+/// Extracts the expected sequence from the raw log of a sequence mismatch error,
+/// e.g. `account sequence mismatch, expected 5, got 6: incorrect account sequence`.
+fn expected_sequence(raw_log: &str) -> Option<u64> {
+    let start = raw_log.find("expected ")? + "expected ".len();
+    let digits = raw_log[start..]
+        .find(|c: char| !c.is_ascii_digit())
+        .map_or(&raw_log[start..], |end| &raw_log[start..start + end]);
+
+    digits.parse().ok()
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use cosmos_sdk_proto::cosmos::{bank::v1beta1::MsgSend, base::v1beta1::Coin};
+
+    static TEST_MNEMONIC: &str = "elephant luggage finger obscure nest smooth flag clay recycle unfair capital category organ bicycle gallery sight canyon hotel dutch skull today pink scale aisle";
+    static DESMOS_DERIVATION_PATH: &str = "m/44'/852'/0'/0/0";
+
+    #[test]
+    fn parse_expected_sequence() {
+        assert_eq!(
+            Some(5),
+            expected_sequence(
+                "account sequence mismatch, expected 5, got 6: incorrect account sequence"
+            )
+        );
+        assert_eq!(Some(42), expected_sequence("expected 42"));
+        assert_eq!(None, expected_sequence("insufficient fees"));
+        assert_eq!(None, expected_sequence("expected , got 6"));
+    }
+
+    #[test]
+    fn sequence_mismatch() {
+        let mut response = TxResponse {
+            code: WRONG_SEQUENCE_CODE,
+            codespace: SDK_CODESPACE.to_owned(),
+            ..Default::default()
+        };
+        assert!(is_sequence_mismatch(&response));
+
+        response.codespace = "bank".to_owned();
+        assert!(!is_sequence_mismatch(&response));
+    }
+
+    #[test]
+    fn zero_max_in_flight_clamped() {
+        let wallet = MnemonicWallet::new(TEST_MNEMONIC, DESMOS_DERIVATION_PATH).unwrap();
+        let cosmos_client =
+            CosmosClient::new("http://localhost:1317", "http://localhost:9090").unwrap();
+
+        let broadcaster = Broadcaster::new(cosmos_client, wallet, "testchain", "desmos")
+            .unwrap()
+            .max_in_flight(0);
+        assert_eq!(1, broadcaster.in_flight.available_permits());
+    }
+
+    #[actix_rt::test]
+    async fn rejected_tx_sequence_reused() {
+        let wallet = MnemonicWallet::new(TEST_MNEMONIC, DESMOS_DERIVATION_PATH).unwrap();
+        let cosmos_client =
+            CosmosClient::new("http://localhost:1317", "http://localhost:9090").unwrap();
+        let broadcaster = Broadcaster::new(cosmos_client, wallet, "testchain", "desmos").unwrap();
+        let fee = Some(("stake", "5000", 300_000));
+        {
+            let mut state = broadcaster.state.lock().await;
+            state.account_number = 5;
+            state.sequence = 7;
+            state.synced = true;
+        }
+
+        let (_, rejected, generation) = broadcaster.sign_next(&[], fee).await.unwrap();
+        let (_, in_flight, _) = broadcaster.sign_next(&[], fee).await.unwrap();
+        assert_eq!((7, 8), (rejected, in_flight));
+
+        // The rejected sequence is used again from the next tx
+        broadcaster.on_rejected(generation, rejected).await;
+        let (_, next, _) = broadcaster.sign_next(&[], fee).await.unwrap();
+        assert_eq!(7, next);
+
+        // The tx in flight rejected for the same stale generation don't roll back again
+        broadcaster.on_rejected(generation, in_flight).await;
+        assert_eq!(8, broadcaster.state.lock().await.sequence);
+    }
+
+    #[actix_rt::test]
+    async fn broadcast() {
+        let wallet = MnemonicWallet::new(TEST_MNEMONIC, DESMOS_DERIVATION_PATH).unwrap();
+        let cosmos_client =
+            CosmosClient::new("http://localhost:1317", "http://localhost:9090").unwrap();
+
+        let broadcaster = Broadcaster::new(cosmos_client, wallet, "testchain", "desmos")
+            .unwrap()
+            .memo("Test memo")
+            .fee("stake", "5000", 300_000);
+
+        let msg_snd = MsgSend {
+            from_address: broadcaster.address().to_owned(),
+            to_address: "desmos18ek6mnlxj8sysrtvu60k5zj0re7s5n42yncner".to_string(),
+            amount: vec![Coin {
+                denom: "stake".to_string(),
+                amount: "10".to_string(),
+            }],
+        };
+        let mut value = Vec::new();
+        prost::Message::encode(&msg_snd, &mut value).unwrap();
+        let messages = vec![Any {
+            type_url: "/cosmos.bank.v1beta1.Msg/Send".to_owned(),
+            value,
+        }];
+
+        // Multiple txs in the same block from the same account
+        for _ in 0..3 {
+            let response = broadcaster.broadcast(&messages).await.unwrap();
+            assert_eq!(0, response.code);
+        }
+    }
+}
@@ -0,0 +1,269 @@
+//! Module that provides the cache of the accounts data used from [`CosmosClient`].
+//!
+//! [`CosmosClient`]: crate::client::CosmosClient
+
+use crate::broadcaster::is_sequence_mismatch;
+use bech32::FromBase32;
+use cosmos_sdk_proto::cosmos::{
+    auth::v1beta1::BaseAccount, base::abci::v1beta1::TxResponse, tx::v1beta1::AuthInfo,
+};
+use crw_wallet::crypto::{account_hash, ACCOUNT_HASH_SIZE};
+use std::collections::HashMap;
+use std::convert::TryFrom;
+use std::sync::Mutex;
+use std::time::{Duration, Instant};
+
+/// Account hash encoded into the bech32 addresses, used as cache key so that the accounts can
+/// be found both from their address and from the public key of the tx signers.
+type AccountHash = [u8; ACCOUNT_HASH_SIZE];
+
+/// A cached account.
+struct CachedAccount {
+    account: BaseAccount,
+    /// Last time the account sequence has been fetched from the chain or updated locally.
+    updated_at: Instant,
+}
+
+/// Cache of the accounts data.
+///
+/// The accounts are cached for `ttl` since their sequence has been fetched or updated after
+/// a broadcast, after that they are fetched again, so a sequence changed from a tx not
+/// broadcast through the cache owner is eventually picked up.
+pub(crate) struct AccountCache {
+    ttl: Duration,
+    accounts: Mutex<HashMap<AccountHash, CachedAccount>>,
+}
+
+impl AccountCache {
+    pub(crate) fn new(ttl: Duration) -> AccountCache {
+        AccountCache {
+            ttl,
+            accounts: Mutex::new(HashMap::new()),
+        }
+    }
+
+    /// Gets the cached data of the account with the provided `address`.
+    pub(crate) fn get(&self, address: &str) -> Option<BaseAccount> {
+        let hash = address_hash(address)?;
+        let accounts = self.accounts.lock().unwrap();
+
+        accounts
+            .get(&hash)
+            .filter(|cached| cached.updated_at.elapsed() < self.ttl)
+            .map(|cached| cached.account.clone())
+    }
+
+    /// Stores the data of the account with the provided `address` fetched from the chain,
+    /// returning the cached data.
+    /// If the sequence has been advanced from a broadcast while the account was being fetched
+    /// the newer sequence is kept, since the fetched one may not include that tx yet.
+    pub(crate) fn insert(&self, address: &str, mut account: BaseAccount) -> BaseAccount {
+        let hash = match address_hash(address) {
+            Some(hash) => hash,
+            None => return account,
+        };
+
+        let mut accounts = self.accounts.lock().unwrap();
+        if let Some(cached) = accounts.get(&hash) {
+            if cached.updated_at.elapsed() < self.ttl
+                && cached.account.account_number == account.account_number
+            {
+                account.sequence = account.sequence.max(cached.account.sequence);
+            }
+        }
+        accounts.insert(
+            hash,
+            CachedAccount {
+                account: account.clone(),
+                updated_at: Instant::now(),
+            },
+        );
+        account
+    }
+
+    /// Updates the cached sequence of the tx signer after a broadcast.
+    ///
+    /// * `auth_info_bytes` - the serialized auth info of the broadcast tx.
+    /// * `response` - the broadcast response, [`None`] if the broadcast failed.
+    pub(crate) fn on_broadcast(&self, auth_info_bytes: &[u8], response: Option<&TxResponse>) {
+        let (hash, sequence) = match signer(auth_info_bytes) {
+            Some(signer) => signer,
+            None => return,
+        };
+
+        let mut accounts = self.accounts.lock().unwrap();
+        match response {
+            // The tx has been accepted, or included into a block even if its execution failed,
+            // so the next one must use the following sequence
+            Some(response)
+                if response.code == 0
+                    || (response.height > 0 && !is_sequence_mismatch(response)) =>
+            {
+                if let Some(cached) = accounts.get_mut(&hash) {
+                    if sequence >= cached.account.sequence {
+                        cached.account.sequence = sequence + 1;
+                        cached.updated_at = Instant::now();
+                    }
+                }
+            }
+            // The tx has been rejected by the CheckTx for other reasons, the sequence is not
+            // consumed
+            Some(response) if !is_sequence_mismatch(response) => {}
+            // The cached sequence is wrong or it's unknown if the tx reached the mempool
+            _ => {
+                accounts.remove(&hash);
+            }
+        }
+    }
+}
+
+/// Decodes the account hash from a bech32 address.
+fn address_hash(address: &str) -> Option<AccountHash> {
+    let (_, data, _) = bech32::decode(address).ok()?;
+    let bytes = Vec::<u8>::from_base32(&data).ok()?;
+
+    AccountHash::try_from(bytes.as_slice()).ok()
+}
+
+/// Extracts the account hash and the sequence of the first signer of a tx from its
+/// serialized auth info.
+fn signer(auth_info_bytes: &[u8]) -> Option<(AccountHash, u64)> {
+    let auth_info: AuthInfo = prost::Message::decode(auth_info_bytes).ok()?;
+    let signer_info = auth_info.signer_infos.first()?;
+    // The secp256k1 PubKey message contains only the key bytes field
+    let pub_key: Vec<u8> =
+        prost::Message::decode(signer_info.public_key.as_ref()?.value.as_ref()).ok()?;
+
+    Some((account_hash(&pub_key), signer_info.sequence))
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::tx::TxBuilder;
+    use cosmos_sdk_proto::cosmos::{bank::v1beta1::MsgSend, base::v1beta1::Coin};
+    use crw_wallet::crypto::MnemonicWallet;
+
+    static TEST_MNEMONIC: &str = "elephant luggage finger obscure nest smooth flag clay recycle unfair capital category organ bicycle gallery sight canyon hotel dutch skull today pink scale aisle";
+    static DESMOS_DERIVATION_PATH: &str = "m/44'/852'/0'/0/0";
+
+    fn signed_auth_info(wallet: &MnemonicWallet, sequence: u64) -> Vec<u8> {
+        let msg_snd = MsgSend {
+            from_address: wallet.get_bech32_address("desmos").unwrap(),
+            to_address: "desmos18ek6mnlxj8sysrtvu60k5zj0re7s5n42yncner".to_string(),
+            amount: vec![Coin {
+                denom: "stake".to_string(),
+                amount: "10".to_string(),
+            }],
+        };
+
+        TxBuilder::new("testchain")
+            .account_info(sequence, 5)
+            .fee("stake", "10", 300_000)
+            .add_message("/cosmos.bank.v1beta1.Msg/Send", msg_snd)
+            .unwrap()
+            .sign_raw(wallet)
+            .unwrap()
+            .auth_info_bytes
+    }
+
+    fn account(sequence: u64) -> BaseAccount {
+        BaseAccount {
+            account_number: 5,
+            sequence,
+            ..Default::default()
+        }
+    }
+
+    #[test]
+    fn cached_account() {
+        let wallet = MnemonicWallet::new(TEST_MNEMONIC, DESMOS_DERIVATION_PATH).unwrap();
+        let address = wallet.get_bech32_address("desmos").unwrap();
+        let cache = AccountCache::new(Duration::from_secs(60));
+
+        assert_eq!(None, cache.get(&address));
+        cache.insert(&address, account(1));
+        assert_eq!(Some(account(1)), cache.get(&address));
+
+        // The same account hash with a different hrp
+        let cosmos_address = wallet.get_bech32_address("cosmos").unwrap();
+        assert_eq!(Some(account(1)), cache.get(&cosmos_address));
+    }
+
+    #[test]
+    fn expired_account() {
+        let wallet = MnemonicWallet::new(TEST_MNEMONIC, DESMOS_DERIVATION_PATH).unwrap();
+        let address = wallet.get_bech32_address("desmos").unwrap();
+        let cache = AccountCache::new(Duration::from_secs(0));
+
+        cache.insert(&address, account(1));
+        assert_eq!(None, cache.get(&address));
+    }
+
+    #[test]
+    fn sequence_update_on_broadcast() {
+        let wallet = MnemonicWallet::new(TEST_MNEMONIC, DESMOS_DERIVATION_PATH).unwrap();
+        let address = wallet.get_bech32_address("desmos").unwrap();
+        let cache = AccountCache::new(Duration::from_secs(60));
+        cache.insert(&address, account(1));
+
+        // Accepted tx
+        let accepted = TxResponse::default();
+        cache.on_broadcast(&signed_auth_info(&wallet, 1), Some(&accepted));
+        assert_eq!(2, cache.get(&address).unwrap().sequence);
+
+        // Rejected tx that don't consume the sequence
+        let rejected = TxResponse {
+            code: 5,
+            codespace: "sdk".to_owned(),
+            ..Default::default()
+        };
+        cache.on_broadcast(&signed_auth_info(&wallet, 2), Some(&rejected));
+        assert_eq!(2, cache.get(&address).unwrap().sequence);
+
+        // Tx included into a block whose execution failed
+        let failed = TxResponse {
+            code: 11,
+            codespace: "sdk".to_owned(),
+            height: 10,
+            ..Default::default()
+        };
+        cache.on_broadcast(&signed_auth_info(&wallet, 2), Some(&failed));
+        assert_eq!(3, cache.get(&address).unwrap().sequence);
+
+        // Sequence mismatch
+        let mismatch = TxResponse {
+            code: 32,
+            codespace: "sdk".to_owned(),
+            ..Default::default()
+        };
+        cache.on_broadcast(&signed_auth_info(&wallet, 3), Some(&mismatch));
+        assert_eq!(None, cache.get(&address));
+    }
+
+    #[test]
+    fn insert_keeps_newer_sequence() {
+        let wallet = MnemonicWallet::new(TEST_MNEMONIC, DESMOS_DERIVATION_PATH).unwrap();
+        let address = wallet.get_bech32_address("desmos").unwrap();
+        let cache = AccountCache::new(Duration::from_secs(60));
+        cache.insert(&address, account(1));
+
+        // A broadcast completed while the account was being fetched again
+        cache.on_broadcast(&signed_auth_info(&wallet, 1), Some(&TxResponse::default()));
+        assert_eq!(account(2), cache.insert(&address, account(1)));
+        assert_eq!(2, cache.get(&address).unwrap().sequence);
+
+        assert_eq!(account(3), cache.insert(&address, account(3)));
+    }
+
+    #[test]
+    fn invalidation_on_failed_broadcast() {
+        let wallet = MnemonicWallet::new(TEST_MNEMONIC, DESMOS_DERIVATION_PATH).unwrap();
+        let address = wallet.get_bech32_address("desmos").unwrap();
+        let cache = AccountCache::new(Duration::from_secs(60));
+        cache.insert(&address, account(1));
+
+        cache.on_broadcast(&signed_auth_info(&wallet, 1), None);
+        assert_eq!(None, cache.get(&address));
+    }
+}
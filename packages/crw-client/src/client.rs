@@ -2,23 +2,109 @@
 //!
 //! This module provide a client that can be used to perform requests to a cosmos based blockchain.
 
+use crate::cache::AccountCache;
 use crate::error::CosmosError;
 use crate::json::{NodeInfo, NodeInfoResponse};
 use cosmos_sdk_proto::cosmos::{
     auth::v1beta1::{query_client::QueryClient, BaseAccount, QueryAccountRequest},
+    base::abci::v1beta1::GasInfo,
     base::abci::v1beta1::TxResponse,
-    tx::v1beta1::{service_client::ServiceClient, BroadcastMode, BroadcastTxRequest, Tx, TxRaw},
+    tx::v1beta1::{
+        service_client::ServiceClient, BroadcastMode, BroadcastTxRequest, SimulateRequest, Tx,
+        TxRaw,
+    },
 };
-use reqwest::{get, StatusCode};
-use tonic::codegen::http::uri::InvalidUri;
+use once_cell::sync::OnceCell;
+use reqwest::{Client, StatusCode};
+use serde::de::DeserializeOwned;
+use std::collections::HashMap;
+use std::error::Error;
+use std::sync::{Arc, Mutex};
+use std::time::Duration;
 use tonic::transport::Endpoint;
-use tonic::{codegen::http::Uri, transport::Channel, Request};
+use tonic::{codegen::http::Uri, transport::Channel, Code, Request, Status};
+
+/// LCD response statuses returned from the proxies in front of a node that is down or overloaded.
+const LCD_UNAVAILABLE_STATUSES: [StatusCode; 3] = [
+    StatusCode::BAD_GATEWAY,
+    StatusCode::SERVICE_UNAVAILABLE,
+    StatusCode::GATEWAY_TIMEOUT,
+];
+
+/// Converts a gRPC `status` into a [`CosmosError`].
+/// The statuses telling that the node can't be reached or didn't answer in time become
+/// [`CosmosError::Unavailable`], the others are the node answer and become [`CosmosError::Grpc`].
+pub(crate) fn grpc_error(status: Status) -> CosmosError {
+    match status.code() {
+        Code::Unavailable | Code::DeadlineExceeded => CosmosError::Unavailable(status.to_string()),
+        // The connection failures, e.g. a refused connection, are reported as unknown statuses.
+        Code::Unknown if is_transport_failure(&status) => {
+            CosmosError::Unavailable(status.to_string())
+        }
+        _ => CosmosError::Grpc(status.to_string()),
+    }
+}
+
+/// Tells if `status` has been caused from a failure of the connection to the node.
+fn is_transport_failure(status: &Status) -> bool {
+    let mut source = status.source();
+    while let Some(err) = source {
+        if err.is::<tonic::transport::Error>() {
+            return true;
+        }
+        if let Some(err) = err.downcast_ref::<hyper::Error>() {
+            if err.is_connect() || err.is_closed() {
+                return true;
+            }
+        }
+        source = err.source();
+    }
+
+    // Fallback for the statuses without a source, the message is the one of the transport
+    // errors as of tonic 0.4.1.
+    status.message().starts_with("transport error")
+}
+
+/// Converts an error occurred while performing a LCD request into a [`CosmosError`].
+/// The connection errors and the timeouts become [`CosmosError::Unavailable`].
+fn lcd_error(err: reqwest::Error) -> CosmosError {
+    if err.is_connect() || err.is_timeout() {
+        CosmosError::Unavailable(err.to_string())
+    } else {
+        CosmosError::Lcd(err.to_string())
+    }
+}
+
+/// Default interval between the HTTP/2 keep-alive pings sent to the gRPC server.
+const GRPC_KEEP_ALIVE_INTERVAL: Duration = Duration::from_secs(30);
+/// Default time waited for an HTTP/2 keep-alive ping acknowledgement before closing the connection.
+const GRPC_KEEP_ALIVE_TIMEOUT: Duration = Duration::from_secs(10);
+/// Default TCP keep-alive interval of the gRPC connection.
+const GRPC_TCP_KEEP_ALIVE: Duration = Duration::from_secs(60);
+/// Default timeout of the LCD requests, including the connection phase.
+const LCD_TIMEOUT: Duration = Duration::from_secs(30);
+/// Default timeout of the LCD connection phase.
+const LCD_CONNECT_TIMEOUT: Duration = Duration::from_secs(10);
+/// Time after which an idle LCD connection is removed from the pool.
+const LCD_POOL_IDLE_TIMEOUT: Duration = Duration::from_secs(90);
+/// Maximum number of idle LCD connections kept in the pool.
+const LCD_POOL_MAX_IDLE: usize = 8;
 
 /// Client to communicate with a full node.
+///
+/// All the gRPC requests are multiplexed over a single HTTP/2 connection that is opened
+/// the first time it's needed and automatically reopened if it drops.
+/// The LCD requests are performed through a pooled HTTP client that keeps the connections
+/// alive between the requests.
+/// Cloned clients share the same connections.
 #[derive(Clone)]
 pub struct CosmosClient {
-    grpc_channel: Endpoint,
+    grpc_endpoint: Endpoint,
+    grpc_channel: Arc<OnceCell<Channel>>,
+    lcd_client: Client,
     lcd_addr: String,
+    gas_cache: Arc<Mutex<HashMap<String, u64>>>,
+    account_cache: Option<Arc<AccountCache>>,
 }
 
 impl CosmosClient {
@@ -27,7 +113,8 @@ impl CosmosClient {
     /// and `grpc_addr` for the new gRPC request.
     ///
     /// # Errors
-    /// Returns an [`Err`] if `grpc_addr` is an invalid URI.
+    /// Returns a [`CosmosError::Grpc`] if `grpc_addr` is an invalid URI or a
+    /// [`CosmosError::Lcd`] if the LCD HTTP client can't be initialized.
     ///
     ///# Examples
     ///
@@ -36,46 +123,133 @@ impl CosmosClient {
     ///
     ///  let client = CosmosClient::new("http://localhost:1317", "http://localhost:9090").unwrap();
     /// ```
-    pub fn new(lcd_addr: &str, grpc_addr: &str) -> Result<CosmosClient, InvalidUri> {
-        let grpc_uri = grpc_addr.parse::<Uri>()?;
-        let grpc_channel = Channel::builder(grpc_uri);
+    pub fn new(lcd_addr: &str, grpc_addr: &str) -> Result<CosmosClient, CosmosError> {
+        let grpc_uri = grpc_addr
+            .parse::<Uri>()
+            .map_err(|err| CosmosError::Grpc(err.to_string()))?;
+        let grpc_endpoint = Channel::builder(grpc_uri)
+            .tcp_nodelay(true)
+            .tcp_keepalive(Some(GRPC_TCP_KEEP_ALIVE))
+            .http2_keep_alive_interval(GRPC_KEEP_ALIVE_INTERVAL)
+            .keep_alive_timeout(GRPC_KEEP_ALIVE_TIMEOUT)
+            .keep_alive_while_idle(true);
+
+        let lcd_client = Client::builder()
+            .timeout(LCD_TIMEOUT)
+            .connect_timeout(LCD_CONNECT_TIMEOUT)
+            .pool_idle_timeout(LCD_POOL_IDLE_TIMEOUT)
+            .pool_max_idle_per_host(LCD_POOL_MAX_IDLE)
+            .tcp_nodelay(true)
+            .gzip(true)
+            .build()
+            .map_err(|err| CosmosError::Lcd(err.to_string()))?;
 
         Ok(CosmosClient {
-            grpc_channel,
+            grpc_endpoint,
+            grpc_channel: Arc::new(OnceCell::new()),
+            lcd_client,
             lcd_addr: lcd_addr.to_string(),
+            gas_cache: Arc::new(Mutex::new(HashMap::new())),
+            account_cache: None,
         })
     }
 
-    /// Gets the information of a full node.
-    pub async fn node_info(&self) -> Result<NodeInfo, CosmosError> {
-        let endpoint = format!("{}{}", self.lcd_addr, "/node_info");
-        let response = get(&endpoint)
+    /// Sets the interval between the HTTP/2 keep-alive pings and the time waited for
+    /// their acknowledgement before considering the gRPC connection dead.
+    pub fn grpc_keep_alive(mut self, interval: Duration, timeout: Duration) -> Self {
+        self.grpc_endpoint = self
+            .grpc_endpoint
+            .http2_keep_alive_interval(interval)
+            .keep_alive_timeout(timeout);
+        self.reset_grpc_channel();
+        self
+    }
+
+    /// Sets the maximum number of in flight gRPC requests, the exceeding requests
+    /// wait until one of the previous completes.
+    pub fn grpc_concurrency_limit(mut self, limit: usize) -> Self {
+        self.grpc_endpoint = self.grpc_endpoint.concurrency_limit(limit);
+        self.reset_grpc_channel();
+        self
+    }
+
+    /// Sets the timeout applied to each gRPC request.
+    pub fn grpc_timeout(mut self, timeout: Duration) -> Self {
+        self.grpc_endpoint = self.grpc_endpoint.timeout(timeout);
+        self.reset_grpc_channel();
+        self
+    }
+
+    /// Enables the cache of the accounts data returned from [`CosmosClient::get_account_data`].
+    ///
+    /// The cached accounts are returned without querying the full node for `ttl` since they
+    /// have been fetched. When a tx is accepted from the full node the signer sequence is
+    /// incremented locally, while if the tx is rejected due to a sequence mismatch or the
+    /// broadcast fails the signer account is removed from the cache.
+    /// The cache is shared between the cloned clients.
+    pub fn account_cache(mut self, ttl: Duration) -> Self {
+        self.account_cache = Some(Arc::new(AccountCache::new(ttl)));
+        self
+    }
+
+    /// Detaches this client from the shared gRPC connection so that the next request opens
+    /// a new one with the current endpoint configuration.
+    fn reset_grpc_channel(&mut self) {
+        self.grpc_channel = Arc::new(OnceCell::new());
+    }
+
+    /// Gets the gRPC channel shared by this client, creating it on the first call.
+    /// The channel connects lazily and reconnects on failure, so this never waits for the
+    /// network; it must however be called from inside a Tokio runtime.
+    fn grpc_channel(&self) -> Result<Channel, CosmosError> {
+        self.grpc_channel
+            .get_or_try_init(|| self.grpc_endpoint.connect_lazy())
+            .map(Channel::clone)
+            .map_err(|err| CosmosError::Grpc(err.to_string()))
+    }
+
+    /// Performs a GET request to the LCD `path` and deserializes the json response body.
+    async fn lcd_get<T: DeserializeOwned>(&self, path: &str) -> Result<T, CosmosError> {
+        let endpoint = format!("{}{}", self.lcd_addr, path);
+        let response = self
+            .lcd_client
+            .get(&endpoint)
+            .send()
             .await
-            .map_err(|err| CosmosError::Lcd(err.to_string()))?;
+            .map_err(lcd_error)?;
 
-        let node_info_response: NodeInfoResponse;
         match response.status() {
-            StatusCode::OK => {
-                // Unwrap here is safe since we already knew that the response is good
-                node_info_response = response.json::<NodeInfoResponse>().await.unwrap()
+            StatusCode::OK => response
+                .json::<T>()
+                .await
+                .map_err(|err| CosmosError::Decode(err.to_string())),
+            status_code if LCD_UNAVAILABLE_STATUSES.contains(&status_code) => {
+                Err(CosmosError::Unavailable(status_code.to_string()))
             }
-            status_code => return Err(CosmosError::Lcd(status_code.to_string())),
+            status_code => Err(CosmosError::Lcd(status_code.to_string())),
         }
+    }
+
+    /// Gets the information of a full node.
+    pub async fn node_info(&self) -> Result<NodeInfo, CosmosError> {
+        let node_info_response = self.lcd_get::<NodeInfoResponse>("/node_info").await?;
 
         Ok(node_info_response.node_info)
     }
 
     /// Returns the account data associated to the given address.
     pub async fn get_account_data(&self, address: &str) -> Result<BaseAccount, CosmosError> {
-        // Create channel connection to the gRPC server
-        let channel = self
-            .grpc_channel
-            .connect()
-            .await
-            .map_err(|err| CosmosError::Grpc(err.to_string()))?;
+        timed_future!("client.get_account_data", self.query_account_data(address)).await
+    }
 
-        // Create gRPC query auth client from channel
-        let mut client = QueryClient::new(channel);
+    /// Returns the account data associated to the given address, from the cache if enabled.
+    async fn query_account_data(&self, address: &str) -> Result<BaseAccount, CosmosError> {
+        if let Some(account) = self.account_cache.as_ref().and_then(|c| c.get(address)) {
+            return Ok(account);
+        }
+
+        // Create gRPC query auth client from the shared channel
+        let mut client = QueryClient::new(self.grpc_channel()?);
 
         // Build a new request
         let request = Request::new(QueryAccountRequest {
@@ -86,17 +260,24 @@ impl CosmosClient {
         let response = client
             .account(request)
             .await
-            .map_err(|err| CosmosError::Grpc(err.to_string()))?
+            .map_err(grpc_error)?
             .into_inner();
 
         // Decode response body into BaseAccount
         let base_account: BaseAccount =
             prost::Message::decode(response.account.unwrap().value.as_ref())?;
 
-        Ok(base_account)
+        match &self.account_cache {
+            Some(cache) => Ok(cache.insert(address, base_account)),
+            None => Ok(base_account),
+        }
     }
 
     /// Broadcast a tx using the gRPC interface.
+    ///
+    /// The tx body and auth info are serialized again before being sent, prefer
+    /// [`TxBuilder::sign_raw`](crate::tx::TxBuilder::sign_raw) and
+    /// [`CosmosClient::broadcast_tx_raw`] to broadcast the exact signed bytes.
     pub async fn broadcast_tx(
         &self,
         tx: &Tx,
@@ -105,7 +286,6 @@ impl CosmosClient {
         // Some buffers used to serialize the objects
         let mut serialized_body: Vec<u8> = Vec::new();
         let mut serialized_auth: Vec<u8> = Vec::new();
-        let mut serialized_tx: Vec<u8> = Vec::new();
 
         // Serialize the tx body and auth_info
         if let Some(body) = &tx.body {
@@ -115,34 +295,94 @@ impl CosmosClient {
             prost::Message::encode(auth_info, &mut serialized_auth)?;
         }
 
-        // Prepare and serialize the TxRaw
+        // Prepare the TxRaw
         let tx_raw = TxRaw {
             body_bytes: serialized_body,
             auth_info_bytes: serialized_auth,
             signatures: tx.signatures.clone(),
         };
-        prost::Message::encode(&tx_raw, &mut serialized_tx)?;
 
-        // Open the channel and perform the actual gRPC BroadcastTxRequest
-        let channel = self
-            .grpc_channel
-            .connect()
-            .await
-            .map_err(|err| CosmosError::Grpc(err.to_string()))?;
-        let mut service = ServiceClient::new(channel);
+        self.broadcast_tx_raw(&tx_raw, mode).await
+    }
+
+    /// Broadcast a raw tx using the gRPC interface.
+    /// The tx body and auth info bytes are sent as they are, so they must be the exact bytes
+    /// that have been signed.
+    pub async fn broadcast_tx_raw(
+        &self,
+        tx_raw: &TxRaw,
+        mode: BroadcastMode,
+    ) -> Result<Option<TxResponse>, CosmosError> {
+        timed_future!("client.broadcast", self.send_tx_raw(tx_raw, mode)).await
+    }
+
+    /// Sends a raw tx to the gRPC broadcast service, updating the accounts cache.
+    async fn send_tx_raw(
+        &self,
+        tx_raw: &TxRaw,
+        mode: BroadcastMode,
+    ) -> Result<Option<TxResponse>, CosmosError> {
+        // Serialize the TxRaw
+        let mut serialized_tx = Vec::with_capacity(prost::Message::encoded_len(tx_raw));
+        prost::Message::encode(tx_raw, &mut serialized_tx)?;
+
+        // Perform the actual gRPC BroadcastTxRequest over the shared channel
+        let mut service = ServiceClient::new(self.grpc_channel()?);
 
         let request = Request::new(BroadcastTxRequest {
             tx_bytes: serialized_tx,
             mode: mode as i32,
         });
 
-        let response = service
+        let result = service
             .broadcast_tx(request)
             .await
-            .map_err(|e| CosmosError::Grpc(e.to_string()))?
+            .map_err(grpc_error)
+            .map(|response| response.into_inner().tx_response);
+
+        if let Some(cache) = &self.account_cache {
+            let response = result.as_ref().ok().and_then(Option::as_ref);
+            cache.on_broadcast(&tx_raw.auth_info_bytes, response);
+        }
+
+        result
+    }
+
+    /// Simulates the execution of a tx using the gRPC interface, without broadcasting it.
+    /// Returns the gas used to execute the tx.
+    pub async fn simulate(&self, tx: &Tx) -> Result<GasInfo, CosmosError> {
+        let mut service = ServiceClient::new(self.grpc_channel()?);
+
+        let request = Request::new(SimulateRequest {
+            tx: Some(tx.clone()),
+            ..Default::default()
+        });
+
+        let response = service
+            .simulate(request)
+            .await
+            .map_err(grpc_error)?
             .into_inner();
 
-        Ok(response.tx_response)
+        response
+            .gas_info
+            .ok_or_else(|| CosmosError::Grpc("missing simulation gas info".to_owned()))
+    }
+
+    /// Gets the gas used from a previous simulation of a tx with messages of the given `shape`.
+    pub(crate) fn cached_gas(&self, shape: &str) -> Option<u64> {
+        self.gas_cache.lock().unwrap().get(shape).copied()
+    }
+
+    /// Stores the gas used from the simulation of a tx with messages of the given `shape`.
+    pub(crate) fn cache_gas(&self, shape: String, gas_used: u64) {
+        self.gas_cache.lock().unwrap().insert(shape, gas_used);
+    }
+
+    /// Clears the gas estimations cached by [`TxBuilder::auto_fee`](crate::tx::TxBuilder::auto_fee),
+    /// to use after a chain upgrade that changes the gas consumption of the messages.
+    pub fn clear_gas_cache(&self) {
+        self.gas_cache.lock().unwrap().clear();
     }
 }
 
@@ -156,6 +396,24 @@ mod tests {
     static TEST_MNEMONIC: &str = "elephant luggage finger obscure nest smooth flag clay recycle unfair capital category organ bicycle gallery sight canyon hotel dutch skull today pink scale aisle";
     static DESMOS_DERIVATION_PATH: &str = "m/44'/852'/0'/0/0";
 
+    #[test]
+    fn grpc_error_classification() {
+        assert_eq!(
+            CosmosError::Unavailable(Status::unavailable("down").to_string()),
+            grpc_error(Status::unavailable("down"))
+        );
+        let transport = Status::unknown("transport error");
+        assert_eq!(
+            CosmosError::Unavailable(transport.to_string()),
+            grpc_error(transport)
+        );
+        let not_found = Status::not_found("account not found");
+        assert_eq!(
+            CosmosError::Grpc(not_found.to_string()),
+            grpc_error(not_found)
+        );
+    }
+
     #[actix_rt::test]
     async fn node_info() {
         let cosmos_client =
@@ -167,6 +425,58 @@ mod tests {
         assert_eq!("testchain", info.unwrap().network);
     }
 
+    #[actix_rt::test]
+    async fn shared_grpc_channel() {
+        let cosmos_client =
+            CosmosClient::new("http://localhost:1317", "http://localhost:9090").unwrap();
+        let cloned_client = cosmos_client.clone();
+
+        // The channel is created lazily without connecting to the server
+        assert!(cosmos_client.grpc_channel.get().is_none());
+        assert!(cloned_client.grpc_channel().is_ok());
+        assert!(cosmos_client.grpc_channel.get().is_some());
+        assert!(Arc::ptr_eq(
+            &cosmos_client.grpc_channel,
+            &cloned_client.grpc_channel
+        ));
+
+        // Changing the configuration detaches the client from the shared channel
+        let limited_client = cloned_client.grpc_concurrency_limit(16);
+        assert!(limited_client.grpc_channel.get().is_none());
+        assert!(cosmos_client.grpc_channel.get().is_some());
+    }
+
+    #[actix_rt::test]
+    async fn simulate() {
+        let wallet = MnemonicWallet::new(TEST_MNEMONIC, DESMOS_DERIVATION_PATH).unwrap();
+
+        let cosmos_client =
+            CosmosClient::new("http://localhost:1317", "http://localhost:9090").unwrap();
+
+        let address = wallet.get_bech32_address("desmos").unwrap();
+        let account_data = cosmos_client.get_account_data(&address).await.unwrap();
+
+        let msg_snd = MsgSend {
+            from_address: address,
+            to_address: "desmos18ek6mnlxj8sysrtvu60k5zj0re7s5n42yncner".to_string(),
+            amount: vec![Coin {
+                denom: "stake".to_string(),
+                amount: "10".to_string(),
+            }],
+        };
+
+        let tx = TxBuilder::new("testchain")
+            .account_info(account_data.sequence, account_data.account_number)
+            .fee("stake", "0", 0)
+            .add_message("/cosmos.bank.v1beta1.Msg/Send", msg_snd)
+            .unwrap()
+            .sign(&wallet)
+            .unwrap();
+
+        let gas_info = cosmos_client.simulate(&tx).await.unwrap();
+        assert!(gas_info.gas_used > 0);
+    }
+
     #[actix_rt::test]
     async fn broadcast_tx() {
         let wallet = MnemonicWallet::new(TEST_MNEMONIC, DESMOS_DERIVATION_PATH).unwrap();
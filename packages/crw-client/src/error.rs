@@ -18,6 +18,16 @@ pub enum CosmosError {
 
     #[error("LCD error: {0}")]
     Lcd(String),
+
+    /// The node can't be reached or didn't answer in time.
+    #[error("Node unavailable: {0}")]
+    Unavailable(String),
+
+    #[error("No endpoints available")]
+    NoEndpoints,
+
+    #[error("Websocket error: {0}")]
+    Websocket(String),
 }
 
 /// The various error that can be raised from [`super::tx::TxBuilder`].
@@ -47,3 +57,12 @@ impl From<DecodeError> for CosmosError {
         CosmosError::Decode(e.to_string())
     }
 }
+
+impl From<TxBuildError> for CosmosError {
+    fn from(e: TxBuildError) -> Self {
+        match e {
+            TxBuildError::Encode(e) => CosmosError::Encode(e),
+            e => CosmosError::Sign(e.to_string()),
+        }
+    }
+}
@@ -0,0 +1,328 @@
+//! Provides the FFI to interact with [`CosmosClient`] from other programming languages.
+//!
+//! The requests are performed asynchronously inside a multi-threaded Tokio runtime shared from
+//! all the clients: each function submits the request and returns immediately, the result is
+//! then delivered to a callback invoked from one of the runtime threads.
+use crate::client::CosmosClient;
+use crate::error::CosmosError;
+use cosmos_sdk_proto::cosmos::{
+    auth::v1beta1::BaseAccount,
+    base::abci::v1beta1::TxResponse,
+    tx::v1beta1::{BroadcastMode, TxRaw},
+};
+use libc::{c_char, c_int, c_uchar, c_void, size_t};
+use once_cell::sync::Lazy;
+use std::ffi::{CStr, CString};
+use std::ptr::{null, null_mut};
+use std::slice;
+use tokio::runtime::{Builder, Runtime};
+
+// The latency metrics of this library are exported together with its FFI, see crw_metrics.h.
+#[cfg(feature = "metrics")]
+pub use crw_metrics::ffi::{crw_metrics_reset, crw_metrics_snapshot, crw_metrics_string_free};
+
+// Macro to export the ffi_helpers's functions used to access the error message from other programming languages.
+export_error_handling_functions!();
+
+/// Runtime where are performed the requests submitted from the FFI.
+static RUNTIME: Lazy<Runtime> = Lazy::new(|| {
+    Builder::new_multi_thread()
+        .thread_name("crw-client")
+        .enable_all()
+        .build()
+        .expect("unable to create the crw-client runtime")
+});
+
+/// Account data passed to the [`AccountDataCallback`].
+#[repr(C)]
+pub struct AccountData {
+    address: *const c_char,
+    account_number: u64,
+    sequence: u64,
+}
+
+/// Broadcast response passed to the [`BroadcastCallback`].
+#[repr(C)]
+pub struct BroadcastResponse {
+    code: u32,
+    height: i64,
+    gas_wanted: i64,
+    gas_used: i64,
+    txhash: *const c_char,
+    codespace: *const c_char,
+    raw_log: *const c_char,
+}
+
+/// Callback that receives the result of [`cosmos_client_get_account_data`].
+/// On success `account` is a valid pointer and `error` is null, on failure `account` is null
+/// and `error` contains the error cause.
+/// Both pointers are valid only until the callback returns.
+pub type AccountDataCallback =
+    extern "C" fn(user_data: *mut c_void, account: *const AccountData, error: *const c_char);
+
+/// Callback that receives the result of [`cosmos_client_broadcast_tx`].
+/// On success `response` is a valid pointer and `error` is null, on failure `response` is null
+/// and `error` contains the error cause.
+/// Both pointers are valid only until the callback returns.
+pub type BroadcastCallback =
+    extern "C" fn(user_data: *mut c_void, response: *const BroadcastResponse, error: *const c_char);
+
+/// Opaque pointer provided from the caller that is passed back to the callbacks.
+struct UserData(*mut c_void);
+
+// The pointer is never dereferenced from rust, it's only passed back to the caller's callback
+// that is responsible of its thread safety.
+unsafe impl Send for UserData {}
+
+/// Converts a string to a C string, dropping it at the first null char.
+fn to_cstring(s: &str) -> CString {
+    let s = s.split('\0').next().unwrap_or_default();
+    // Safe since the string don't contain null chars
+    CString::new(s).unwrap()
+}
+
+/// Creates a new [`CosmosClient`] that communicates with the full node using `lcd_addr` for the
+/// legacy LCD requests and `grpc_addr` for the gRPC requests.
+/// The returned pointer must be freed using the [`cosmos_client_free`] function to avoid memory
+/// leaks.
+///
+/// # Errors
+/// This function returns a nullptr in case of error and store the error cause in a local thread
+/// global variable that can be accessed using the [error_message_utf8](ffi_helpers::error_handling::error_message_utf8) function.
+#[no_mangle]
+pub extern "C" fn cosmos_client_new(
+    lcd_addr: *const c_char,
+    grpc_addr: *const c_char,
+) -> *mut CosmosClient {
+    if lcd_addr.is_null() {
+        ffi_helpers::update_last_error(CosmosError::Lcd("null lcd address ptr".to_owned()));
+        return null_mut();
+    }
+    if grpc_addr.is_null() {
+        ffi_helpers::update_last_error(CosmosError::Grpc("null grpc address ptr".to_owned()));
+        return null_mut();
+    }
+
+    let lcd_addr = unsafe { CStr::from_ptr(lcd_addr).to_string_lossy() };
+    let grpc_addr = unsafe { CStr::from_ptr(grpc_addr).to_string_lossy() };
+
+    match CosmosClient::new(lcd_addr.as_ref(), grpc_addr.as_ref()) {
+        Ok(client) => Box::into_raw(Box::new(client)),
+        Err(e) => {
+            ffi_helpers::update_last_error(e);
+            null_mut()
+        }
+    }
+}
+
+/// Deallocate a [`CosmosClient`] instance.
+/// The requests already submitted with the client are completed anyway.
+#[no_mangle]
+pub extern "C" fn cosmos_client_free(ptr: *mut CosmosClient) {
+    if ptr.is_null() {
+        return;
+    }
+    unsafe {
+        Box::from_raw(ptr);
+    }
+}
+
+/// Submits a request to get the account data associated to `address`.
+/// This function don't block, the result is delivered to `callback` together with `user_data`
+/// from one of the client runtime threads.
+///
+/// Returns 0 if the request has been submitted or -1 if one of the provided arguments is
+/// invalid, in this case `callback` is never invoked.
+#[no_mangle]
+pub extern "C" fn cosmos_client_get_account_data(
+    ptr: *const CosmosClient,
+    address: *const c_char,
+    callback: Option<AccountDataCallback>,
+    user_data: *mut c_void,
+) -> c_int {
+    if ptr.is_null() || address.is_null() {
+        return -1;
+    }
+    let callback = match callback {
+        Some(callback) => callback,
+        None => return -1,
+    };
+
+    // Clone the client so that the request don't depend on the caller pointer lifetime
+    let client = unsafe { ptr.as_ref().unwrap().clone() };
+    let address_str = unsafe { CStr::from_ptr(address).to_string_lossy().into_owned() };
+    let user_data = UserData(user_data);
+
+    RUNTIME.spawn(async move {
+        match client.get_account_data(&address_str).await {
+            Ok(account) => notify_account(callback, user_data, &account),
+            Err(e) => {
+                let error = to_cstring(&e.to_string());
+                callback(user_data.0, null(), error.as_ptr());
+            }
+        }
+    });
+
+    0
+}
+
+fn notify_account(callback: AccountDataCallback, user_data: UserData, account: &BaseAccount) {
+    let address = to_cstring(&account.address);
+    let data = AccountData {
+        address: address.as_ptr(),
+        account_number: account.account_number,
+        sequence: account.sequence,
+    };
+
+    callback(user_data.0, &data, null());
+}
+
+/// Submits a request to broadcast a signed tx.
+/// This function don't block, the result is delivered to `callback` together with `user_data`
+/// from one of the client runtime threads.
+///
+/// * `tx_raw` - a protobuf serialized `cosmos.tx.v1beta1.TxRaw`, the bytes are copied so the
+/// buffer can be released as soon as this function returns.
+/// * `len` - the length of `tx_raw`.
+/// * `mode` - the broadcast mode, 1 for block, 2 for sync or 3 for async.
+///
+/// Returns 0 if the request has been submitted or -1 if one of the provided arguments is
+/// invalid, in this case `callback` is never invoked.
+#[no_mangle]
+pub extern "C" fn cosmos_client_broadcast_tx(
+    ptr: *const CosmosClient,
+    tx_raw: *const c_uchar,
+    len: size_t,
+    mode: c_int,
+    callback: Option<BroadcastCallback>,
+    user_data: *mut c_void,
+) -> c_int {
+    if ptr.is_null() || tx_raw.is_null() {
+        return -1;
+    }
+    let callback = match callback {
+        Some(callback) => callback,
+        None => return -1,
+    };
+    let mode = match BroadcastMode::from_i32(mode) {
+        Some(BroadcastMode::Unspecified) | None => return -1,
+        Some(mode) => mode,
+    };
+
+    let tx_raw: TxRaw = match prost::Message::decode(unsafe { slice::from_raw_parts(tx_raw, len) })
+    {
+        Ok(tx_raw) => tx_raw,
+        Err(_) => return -1,
+    };
+    let client = unsafe { ptr.as_ref().unwrap().clone() };
+    let user_data = UserData(user_data);
+
+    RUNTIME.spawn(async move {
+        match client.broadcast_tx_raw(&tx_raw, mode).await {
+            Ok(Some(response)) => notify_broadcast(callback, user_data, &response),
+            Ok(None) => {
+                let error = to_cstring("empty broadcast response");
+                callback(user_data.0, null(), error.as_ptr());
+            }
+            Err(e) => {
+                let error = to_cstring(&e.to_string());
+                callback(user_data.0, null(), error.as_ptr());
+            }
+        }
+    });
+
+    0
+}
+
+fn notify_broadcast(callback: BroadcastCallback, user_data: UserData, response: &TxResponse) {
+    let txhash = to_cstring(&response.txhash);
+    let codespace = to_cstring(&response.codespace);
+    let raw_log = to_cstring(&response.raw_log);
+    let data = BroadcastResponse {
+        code: response.code,
+        height: response.height,
+        gas_wanted: response.gas_wanted,
+        gas_used: response.gas_used,
+        txhash: txhash.as_ptr(),
+        codespace: codespace.as_ptr(),
+        raw_log: raw_log.as_ptr(),
+    };
+
+    callback(user_data.0, &data, null());
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use ffi_helpers::error_handling::error_message;
+    use std::sync::mpsc::{channel, Sender};
+
+    extern "C" fn account_callback(
+        user_data: *mut c_void,
+        account: *const AccountData,
+        error: *const c_char,
+    ) {
+        let sender = unsafe { &*(user_data as *const Sender<Result<u64, String>>) };
+        let result = if account.is_null() {
+            Err(unsafe { CStr::from_ptr(error).to_string_lossy().into_owned() })
+        } else {
+            Ok(unsafe { (*account).sequence })
+        };
+        sender.send(result).unwrap();
+    }
+
+    #[test]
+    fn client_new_and_free() {
+        let lcd = CString::new("http://localhost:1317").unwrap();
+        let grpc = CString::new("http://localhost:9090").unwrap();
+
+        let client = cosmos_client_new(lcd.as_ptr(), grpc.as_ptr());
+        assert!(!client.is_null());
+        cosmos_client_free(client);
+
+        let invalid = CString::new("not a uri").unwrap();
+        let client = cosmos_client_new(lcd.as_ptr(), invalid.as_ptr());
+        assert!(client.is_null());
+        assert!(error_message().is_some());
+    }
+
+    #[test]
+    fn invalid_arguments() {
+        let lcd = CString::new("http://localhost:1317").unwrap();
+        let grpc = CString::new("http://localhost:9090").unwrap();
+        let client = cosmos_client_new(lcd.as_ptr(), grpc.as_ptr());
+        let tx = [0u8; 4];
+
+        assert_eq!(
+            -1,
+            cosmos_client_get_account_data(client, null(), Some(account_callback), null_mut())
+        );
+        assert_eq!(
+            -1,
+            cosmos_client_broadcast_tx(client, tx.as_ptr(), tx.len(), 0, None, null_mut())
+        );
+
+        cosmos_client_free(client);
+    }
+
+    #[test]
+    fn get_account_data() {
+        let lcd = CString::new("http://localhost:1317").unwrap();
+        let grpc = CString::new("http://localhost:9090").unwrap();
+        let address = CString::new("desmos1dzczdka6wpzwvmawpps7tf8047gkft0e5cupun").unwrap();
+        let client = cosmos_client_new(lcd.as_ptr(), grpc.as_ptr());
+
+        let (sender, receiver) = channel::<Result<u64, String>>();
+        let result = cosmos_client_get_account_data(
+            client,
+            address.as_ptr(),
+            Some(account_callback),
+            &sender as *const _ as *mut c_void,
+        );
+        assert_eq!(0, result);
+        // The client can be released while the request is pending
+        cosmos_client_free(client);
+
+        assert!(receiver.recv().unwrap().is_ok());
+    }
+}
@@ -1,5 +1,6 @@
 //! Module that contains the json types binding used to communicate with a cosmos based blockchain node.
 use serde::{Deserialize, Serialize};
+use std::collections::HashMap;
 
 /// NodeInfoResponse contains the response of the LCD request `/node_info`.
 #[derive(Clone, Serialize, Deserialize)]
@@ -16,3 +17,64 @@ pub struct NodeInfo {
     pub version: String,
     pub moniker: String,
 }
+
+/// RpcEvent contains a message received from the Tendermint RPC websocket after a `subscribe`
+/// request.
+#[derive(Clone, Serialize, Deserialize)]
+pub struct RpcEvent {
+    pub result: Option<RpcEventResult>,
+    pub error: Option<RpcError>,
+}
+
+/// RpcError contains the error returned from the Tendermint RPC when a request fails.
+#[derive(Clone, Serialize, Deserialize)]
+pub struct RpcError {
+    pub code: i64,
+    pub message: String,
+    #[serde(default)]
+    pub data: String,
+}
+
+/// RpcEventResult contains an event published from the Tendermint RPC.
+#[derive(Clone, Serialize, Deserialize)]
+pub struct RpcEventResult {
+    pub data: Option<RpcEventData>,
+    #[serde(default)]
+    pub events: HashMap<String, Vec<String>>,
+}
+
+/// RpcEventData contains the data of an event published from the Tendermint RPC.
+#[derive(Clone, Serialize, Deserialize)]
+pub struct RpcEventData {
+    pub value: RpcEventValue,
+}
+
+/// RpcEventValue contains the value of an event published from the Tendermint RPC,
+/// `tx_result` is present only for the `Tx` events.
+#[derive(Clone, Serialize, Deserialize)]
+pub struct RpcEventValue {
+    #[serde(rename = "TxResult")]
+    pub tx_result: Option<TxResultJson>,
+}
+
+/// TxResultJson contains the result of a tx included into a block.
+#[derive(Clone, Serialize, Deserialize)]
+pub struct TxResultJson {
+    pub height: String,
+    pub result: ExecTxResult,
+}
+
+/// ExecTxResult contains the result of a tx execution.
+#[derive(Clone, Serialize, Deserialize)]
+pub struct ExecTxResult {
+    #[serde(default)]
+    pub code: u32,
+    #[serde(default)]
+    pub codespace: String,
+    #[serde(default)]
+    pub log: String,
+    #[serde(default)]
+    pub gas_wanted: String,
+    #[serde(default)]
+    pub gas_used: String,
+}
@@ -1,6 +1,22 @@
+#[cfg(feature = "ffi")]
+#[macro_use]
+extern crate ffi_helpers;
+
+// The timed! macros record the measures only when built with the `metrics` feature.
+#[macro_use]
+extern crate crw_metrics;
+
+pub mod batch;
+pub mod broadcaster;
+mod cache;
 pub mod client;
 mod error;
 pub mod json;
+pub mod pool;
+pub mod subscriber;
 pub mod tx;
 
 pub use crate::error::{CosmosError, TxBuildError};
+
+#[cfg(feature = "ffi")]
+pub mod ffi;
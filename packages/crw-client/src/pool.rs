@@ -0,0 +1,377 @@
+//! Module to interact with a cosmos based blockchain through multiple full nodes.
+//!
+//! This module provide a pool of [`CosmosClient`] that routes each request to the fastest healthy
+//! full node and transparently fails over to the other nodes when a request fails.
+
+use crate::client::CosmosClient;
+use crate::error::CosmosError;
+use crate::json::NodeInfo;
+use cosmos_sdk_proto::cosmos::{
+    auth::v1beta1::BaseAccount,
+    base::abci::v1beta1::TxResponse,
+    tx::v1beta1::{BroadcastMode, Tx, TxRaw},
+};
+use std::future::Future;
+use std::sync::Mutex;
+use std::time::{Duration, Instant};
+
+/// Weight given to the last sample when updating the nodes latency and error rate.
+const EWMA_ALPHA: f64 = 0.3;
+/// Error rate above which a node is considered unhealthy.
+const UNHEALTHY_ERROR_RATE: f64 = 0.5;
+/// Time after which an unhealthy node is probed again with the next request.
+const UNHEALTHY_RETRY_INTERVAL: Duration = Duration::from_secs(30);
+
+/// Statistics of the requests performed to a full node, tracked as exponentially weighted
+/// moving averages.
+#[derive(Clone, Copy, Debug, Default, PartialEq)]
+struct NodeStats {
+    /// Request latency in milliseconds.
+    latency_ms: f64,
+    /// Fraction of failed requests.
+    error_rate: f64,
+    /// When the last request has been performed to the node, [None] if never.
+    sampled_at: Option<Instant>,
+}
+
+impl NodeStats {
+    fn record(&mut self, latency_ms: f64, failed: bool) {
+        let error = if failed { 1.0 } else { 0.0 };
+        if self.sampled_at.is_some() {
+            self.latency_ms += EWMA_ALPHA * (latency_ms - self.latency_ms);
+            self.error_rate += EWMA_ALPHA * (error - self.error_rate);
+        } else {
+            self.latency_ms = latency_ms;
+            self.error_rate = error * EWMA_ALPHA;
+        }
+        self.sampled_at = Some(Instant::now());
+    }
+
+    fn is_healthy(&self) -> bool {
+        self.error_rate < UNHEALTHY_ERROR_RATE
+    }
+
+    /// Tells if the node should serve the next request to sample it: the nodes never queried
+    /// and the unhealthy nodes not queried since [UNHEALTHY_RETRY_INTERVAL], so that a node
+    /// that came back is used again.
+    fn needs_probe(&self, now: Instant) -> bool {
+        match self.sampled_at {
+            None => true,
+            Some(sampled_at) => {
+                !self.is_healthy() && now.duration_since(sampled_at) >= UNHEALTHY_RETRY_INTERVAL
+            }
+        }
+    }
+}
+
+/// A full node of the pool.
+struct Node {
+    client: CosmosClient,
+    stats: Mutex<NodeStats>,
+}
+
+/// Pool of clients to communicate with multiple full nodes of the same chain.
+///
+/// Queries are sent to the healthy node with the lowest latency, falling back to the next ones
+/// if the request fails. Broadcasts stick to the last node that accepted a transaction, so that
+/// subsequent transactions of the same account reach the mempool that already knows the
+/// previous sequence.
+pub struct CosmosClientPool {
+    nodes: Vec<Node>,
+    broadcast_node: Mutex<Option<usize>>,
+}
+
+impl CosmosClientPool {
+    /// Creates a new pool from a list of `(lcd_addr, grpc_addr)` pairs, one for each full node.
+    ///
+    /// # Errors
+    /// Returns [`CosmosError::NoEndpoints`] if `endpoints` is empty or the error returned from
+    /// [`CosmosClient::new`] if an address is invalid.
+    ///
+    ///# Examples
+    ///
+    /// ```
+    ///  use crw_client::pool::CosmosClientPool;
+    ///
+    ///  let pool = CosmosClientPool::new(&[
+    ///      ("http://node1:1317", "http://node1:9090"),
+    ///      ("http://node2:1317", "http://node2:9090"),
+    ///  ]).unwrap();
+    /// ```
+    pub fn new(endpoints: &[(&str, &str)]) -> Result<CosmosClientPool, CosmosError> {
+        let clients = endpoints
+            .iter()
+            .map(|(lcd_addr, grpc_addr)| CosmosClient::new(lcd_addr, grpc_addr))
+            .collect::<Result<Vec<_>, _>>()?;
+
+        CosmosClientPool::from_clients(clients)
+    }
+
+    /// Creates a new pool from a list of already configured clients, one for each full node.
+    ///
+    /// # Errors
+    /// Returns [`CosmosError::NoEndpoints`] if `clients` is empty.
+    pub fn from_clients(clients: Vec<CosmosClient>) -> Result<CosmosClientPool, CosmosError> {
+        if clients.is_empty() {
+            return Err(CosmosError::NoEndpoints);
+        }
+
+        Ok(CosmosClientPool {
+            nodes: clients
+                .into_iter()
+                .map(|client| Node {
+                    client,
+                    stats: Mutex::new(NodeStats::default()),
+                })
+                .collect(),
+            broadcast_node: Mutex::new(None),
+        })
+    }
+
+    /// Gets the information of the fastest healthy full node.
+    pub async fn node_info(&self) -> Result<NodeInfo, CosmosError> {
+        self.execute(self.ranked_nodes(), |client| async move {
+            client.node_info().await
+        })
+        .await
+        .map(|(_, info)| info)
+    }
+
+    /// Returns the account data associated to the given address.
+    pub async fn get_account_data(&self, address: &str) -> Result<BaseAccount, CosmosError> {
+        self.execute(self.ranked_nodes(), |client| async move {
+            client.get_account_data(address).await
+        })
+        .await
+        .map(|(_, account)| account)
+    }
+
+    /// Broadcast a tx using the gRPC interface.
+    /// The tx is sent to the node that accepted the last tx, if any, otherwise to the fastest
+    /// healthy node.
+    pub async fn broadcast_tx(
+        &self,
+        tx: &Tx,
+        mode: BroadcastMode,
+    ) -> Result<Option<TxResponse>, CosmosError> {
+        self.broadcast(|client| async move { client.broadcast_tx(tx, mode).await })
+            .await
+    }
+
+    /// Broadcast a raw tx using the gRPC interface.
+    /// The tx is sent to the node that accepted the last tx, if any, otherwise to the fastest
+    /// healthy node.
+    pub async fn broadcast_tx_raw(
+        &self,
+        tx_raw: &TxRaw,
+        mode: BroadcastMode,
+    ) -> Result<Option<TxResponse>, CosmosError> {
+        self.broadcast(|client| async move { client.broadcast_tx_raw(tx_raw, mode).await })
+            .await
+    }
+
+    /// Performs a broadcast `request` starting from the node that accepted the last tx and
+    /// updates the sticky node depending on the result.
+    async fn broadcast<'a, F, Fut>(&'a self, request: F) -> Result<Option<TxResponse>, CosmosError>
+    where
+        F: Fn(&'a CosmosClient) -> Fut,
+        Fut: Future<Output = Result<Option<TxResponse>, CosmosError>>,
+    {
+        let mut order = self.ranked_nodes();
+        if let Some(sticky) = *self.broadcast_node.lock().unwrap() {
+            order.retain(|&index| index != sticky);
+            order.insert(0, sticky);
+        }
+
+        let result = self.execute(order, request).await;
+
+        let mut broadcast_node = self.broadcast_node.lock().unwrap();
+        match &result {
+            Ok((index, Some(response))) if response.code == 0 => *broadcast_node = Some(*index),
+            _ => *broadcast_node = None,
+        }
+
+        result.map(|(_, response)| response)
+    }
+
+    /// Returns the indexes of the nodes sorted from the preferred one: the nodes that need to be
+    /// probed come first, then the healthy nodes and finally the unhealthy ones, each group
+    /// sorted by latency.
+    fn ranked_nodes(&self) -> Vec<usize> {
+        let now = Instant::now();
+        let stats: Vec<NodeStats> = self
+            .nodes
+            .iter()
+            .map(|node| *node.stats.lock().unwrap())
+            .collect();
+
+        let mut order: Vec<usize> = (0..self.nodes.len()).collect();
+        order.sort_by(|&a, &b| {
+            let (a, b) = (&stats[a], &stats[b]);
+            b.needs_probe(now)
+                .cmp(&a.needs_probe(now))
+                .then(b.is_healthy().cmp(&a.is_healthy()))
+                .then(a.latency_ms.partial_cmp(&b.latency_ms).unwrap())
+        });
+        order
+    }
+
+    /// Performs `request` on the nodes following `order` until one succeeds, updating the nodes
+    /// statistics.
+    /// Only the [`CosmosError::Unavailable`] errors trigger a failover and lower the node health:
+    /// the other errors are the node answer, e.g. an account not found or an invalid tx, so
+    /// they are returned immediately.
+    /// Returns the index of the node that served the request together with its result.
+    async fn execute<'a, T, F, Fut>(
+        &'a self,
+        order: Vec<usize>,
+        request: F,
+    ) -> Result<(usize, T), CosmosError>
+    where
+        F: Fn(&'a CosmosClient) -> Fut,
+        Fut: Future<Output = Result<T, CosmosError>>,
+    {
+        let mut last_error = CosmosError::NoEndpoints;
+
+        for index in order {
+            let node = &self.nodes[index];
+            let start = Instant::now();
+            let result = request(&node.client).await;
+            let latency_ms = start.elapsed().as_secs_f64() * 1000.0;
+
+            match result {
+                Ok(value) => {
+                    node.stats.lock().unwrap().record(latency_ms, false);
+                    return Ok((index, value));
+                }
+                Err(e @ CosmosError::Unavailable(_)) => {
+                    node.stats.lock().unwrap().record(latency_ms, true);
+                    last_error = e;
+                }
+                Err(e) => {
+                    node.stats.lock().unwrap().record(latency_ms, false);
+                    return Err(e);
+                }
+            }
+        }
+
+        Err(last_error)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn test_pool(nodes: usize) -> CosmosClientPool {
+        let clients = (0..nodes)
+            .map(|i| {
+                CosmosClient::new(
+                    &format!("http://localhost:{}", 1317 + i),
+                    &format!("http://localhost:{}", 9090 + i),
+                )
+                .unwrap()
+            })
+            .collect();
+
+        CosmosClientPool::from_clients(clients).unwrap()
+    }
+
+    #[test]
+    fn empty_pool() {
+        assert_eq!(
+            CosmosError::NoEndpoints,
+            CosmosClientPool::new(&[]).err().unwrap()
+        );
+    }
+
+    #[test]
+    fn node_stats_ewma() {
+        let mut stats = NodeStats::default();
+
+        stats.record(100.0, false);
+        assert!((stats.latency_ms - 100.0).abs() < f64::EPSILON);
+        assert!(stats.error_rate.abs() < f64::EPSILON);
+        assert!(stats.is_healthy());
+
+        stats.record(200.0, true);
+        assert!((stats.latency_ms - 130.0).abs() < f64::EPSILON);
+        assert!((stats.error_rate - 0.3).abs() < f64::EPSILON);
+        assert!(stats.is_healthy());
+
+        stats.record(100.0, true);
+        stats.record(100.0, true);
+        assert!(!stats.is_healthy());
+    }
+
+    #[test]
+    fn ranked_nodes() {
+        let pool = test_pool(3);
+        pool.nodes[0].stats.lock().unwrap().record(80.0, false);
+        pool.nodes[1].stats.lock().unwrap().record(20.0, false);
+        pool.nodes[2].stats.lock().unwrap().record(40.0, false);
+        assert_eq!(vec![1, 2, 0], pool.ranked_nodes());
+
+        // Make the fastest node unhealthy
+        for _ in 0..3 {
+            pool.nodes[1].stats.lock().unwrap().record(20.0, true);
+        }
+        assert_eq!(vec![2, 0, 1], pool.ranked_nodes());
+    }
+
+    #[test]
+    fn unsampled_nodes_first() {
+        let pool = test_pool(2);
+        pool.nodes[0].stats.lock().unwrap().record(10.0, false);
+
+        assert_eq!(vec![1, 0], pool.ranked_nodes());
+    }
+
+    #[actix_rt::test]
+    async fn failover() {
+        let pool = test_pool(2);
+        let first = &pool.nodes[0].client;
+
+        // The first node fails with a transport error
+        let result = pool
+            .execute(vec![0, 1], |client| async move {
+                if std::ptr::eq(client, first) {
+                    Err(CosmosError::Unavailable("unavailable".to_owned()))
+                } else {
+                    Ok(42)
+                }
+            })
+            .await;
+        assert_eq!(Ok((1, 42)), result);
+        assert!(pool.nodes[0].stats.lock().unwrap().error_rate > 0.0);
+        assert!(pool.nodes[1].stats.lock().unwrap().error_rate.abs() < f64::EPSILON);
+
+        // The node answers are not retried on the other nodes and don't lower their health
+        let result: Result<(usize, ()), _> = pool
+            .execute(vec![1, 0], |_| async move {
+                Err(CosmosError::Grpc("account not found".to_owned()))
+            })
+            .await;
+        assert_eq!(
+            Err(CosmosError::Grpc("account not found".to_owned())),
+            result
+        );
+        assert!(pool.nodes[1].stats.lock().unwrap().error_rate.abs() < f64::EPSILON);
+    }
+
+    #[test]
+    fn unhealthy_nodes_probed_again() {
+        let pool = test_pool(2);
+        pool.nodes[0].stats.lock().unwrap().record(10.0, false);
+        for _ in 0..3 {
+            pool.nodes[1].stats.lock().unwrap().record(10.0, true);
+        }
+        assert_eq!(vec![0, 1], pool.ranked_nodes());
+
+        // After the retry interval the unhealthy node serves the next request
+        let mut stats = pool.nodes[1].stats.lock().unwrap();
+        stats.sampled_at = Instant::now().checked_sub(UNHEALTHY_RETRY_INTERVAL);
+        drop(stats);
+        assert_eq!(vec![1, 0], pool.ranked_nodes());
+    }
+}
@@ -0,0 +1,310 @@
+//! Module to be notified when the transactions are included into a block.
+//!
+//! This module provides a [`TxSubscriber`] that opens a single websocket to the Tendermint RPC
+//! of a full node, subscribes to the `Tx` events and resolves the subscriptions of all the
+//! pending transactions from that stream, so there is no need to hold a
+//! [`BroadcastMode::Block`](cosmos_sdk_proto::cosmos::tx::v1beta1::BroadcastMode::Block)
+//! request open for each transaction.
+
+use crate::error::CosmosError;
+use crate::json::{RpcEvent, TxResultJson};
+use futures_util::{SinkExt, StreamExt};
+use std::collections::{HashMap, VecDeque};
+use std::sync::{Arc, Mutex};
+use tokio::sync::oneshot;
+use tokio::task::JoinHandle;
+use tokio_tungstenite::{connect_async, tungstenite::Message};
+
+/// Request sent to subscribe to the events of the transactions included into a block.
+const SUBSCRIBE_TX_REQUEST: &str =
+    r#"{"jsonrpc":"2.0","method":"subscribe","id":0,"params":{"query":"tm.event='Tx'"}}"#;
+/// Maximum number of results kept for the transactions included before being subscribed.
+const RECENT_RESULTS_SIZE: usize = 1024;
+
+/// The result of a transaction included into a block.
+#[derive(Clone, Debug, Eq, PartialEq)]
+pub struct TxResult {
+    /// The tx hash as uppercase hex string.
+    pub hash: String,
+    pub height: i64,
+    pub code: u32,
+    pub codespace: String,
+    pub log: String,
+    pub gas_wanted: i64,
+    pub gas_used: i64,
+}
+
+impl TxResult {
+    fn from_json(hash: String, json: TxResultJson) -> TxResult {
+        TxResult {
+            hash,
+            height: json.height.parse().unwrap_or_default(),
+            code: json.result.code,
+            codespace: json.result.codespace,
+            log: json.result.log,
+            gas_wanted: json.result.gas_wanted.parse().unwrap_or_default(),
+            gas_used: json.result.gas_used.parse().unwrap_or_default(),
+        }
+    }
+}
+
+/// State shared between the subscriber and the task that reads the websocket.
+#[derive(Default)]
+struct Subscriptions {
+    pending: HashMap<String, oneshot::Sender<Result<TxResult, CosmosError>>>,
+    /// Results of the transactions that have been included before being subscribed, they
+    /// are kept since a tx can be included before its broadcast response is received.
+    recent: HashMap<String, TxResult>,
+    recent_order: VecDeque<String>,
+    /// The cause of the websocket closure, if closed.
+    closed: Option<String>,
+}
+
+impl Subscriptions {
+    /// Delivers the result of a tx to its subscription or keeps it for a later subscription.
+    fn resolve(&mut self, result: TxResult) {
+        if let Some(sender) = self.pending.remove(&result.hash) {
+            // The subscription may have been dropped, ignore the error.
+            let _ = sender.send(Ok(result));
+            return;
+        }
+
+        if self.recent_order.len() == RECENT_RESULTS_SIZE {
+            if let Some(oldest) = self.recent_order.pop_front() {
+                self.recent.remove(&oldest);
+            }
+        }
+        self.recent_order.push_back(result.hash.clone());
+        self.recent.insert(result.hash.clone(), result);
+    }
+
+    /// Fails all the pending subscriptions since the websocket has been closed.
+    fn close(&mut self, cause: String) {
+        for (_, sender) in self.pending.drain() {
+            let _ = sender.send(Err(CosmosError::Websocket(cause.clone())));
+        }
+        self.closed = Some(cause);
+    }
+}
+
+/// A pending subscription to the inclusion of a tx into a block.
+pub struct TxSubscription {
+    receiver: oneshot::Receiver<Result<TxResult, CosmosError>>,
+}
+
+impl TxSubscription {
+    /// Waits until the tx is included into a block.
+    /// Can be combined with a timeout to give up waiting for txs that are never included.
+    ///
+    /// # Errors
+    /// Returns a [`CosmosError::Websocket`] if the websocket is closed before the tx inclusion.
+    pub async fn wait(self) -> Result<TxResult, CosmosError> {
+        self.receiver
+            .await
+            .map_err(|_| CosmosError::Websocket("subscriber dropped".to_owned()))?
+    }
+}
+
+/// Subscriber that is notified of the transactions included into a block through a single
+/// websocket connection to the Tendermint RPC.
+pub struct TxSubscriber {
+    subscriptions: Arc<Mutex<Subscriptions>>,
+    reader: JoinHandle<()>,
+}
+
+impl TxSubscriber {
+    /// Connects to the Tendermint RPC websocket at `rpc_addr` and subscribes to the `Tx` events.
+    /// Must be called from inside a Tokio runtime.
+    ///
+    /// * `rpc_addr` - the websocket endpoint, e.g. `ws://localhost:26657/websocket`.
+    ///
+    /// # Errors
+    /// Returns a [`CosmosError::Websocket`] if the connection fails or the node refuses the
+    /// subscription.
+    pub async fn connect(rpc_addr: &str) -> Result<TxSubscriber, CosmosError> {
+        let (mut ws, _) = connect_async(rpc_addr)
+            .await
+            .map_err(|e| CosmosError::Websocket(e.to_string()))?;
+
+        ws.send(Message::Text(SUBSCRIBE_TX_REQUEST.to_owned()))
+            .await
+            .map_err(|e| CosmosError::Websocket(e.to_string()))?;
+
+        // The node replies to the subscribe request before sending any event
+        let reply = loop {
+            match ws.next().await {
+                Some(Ok(Message::Text(text))) => break text,
+                Some(Ok(Message::Close(_))) | None => {
+                    return Err(CosmosError::Websocket("connection closed".to_owned()))
+                }
+                Some(Ok(_)) => continue,
+                Some(Err(e)) => return Err(CosmosError::Websocket(e.to_string())),
+            }
+        };
+        check_subscribe_reply(&reply)?;
+
+        let subscriptions = Arc::new(Mutex::new(Subscriptions::default()));
+        let reader_subscriptions = subscriptions.clone();
+
+        let reader = tokio::spawn(async move {
+            let cause = loop {
+                let text = match ws.next().await {
+                    Some(Ok(Message::Text(text))) => text,
+                    Some(Ok(Message::Close(_))) | None => break "connection closed".to_owned(),
+                    Some(Ok(_)) => continue,
+                    Some(Err(e)) => break e.to_string(),
+                };
+
+                if let Some(result) = parse_tx_result(&text) {
+                    reader_subscriptions.lock().unwrap().resolve(result);
+                }
+            };
+
+            reader_subscriptions.lock().unwrap().close(cause);
+        });
+
+        Ok(TxSubscriber {
+            subscriptions,
+            reader,
+        })
+    }
+
+    /// Subscribes to the inclusion into a block of the tx with the provided `hash`, as returned
+    /// from the broadcast response.
+    /// If the tx has already been included the returned subscription resolves immediately.
+    pub fn subscribe(&self, hash: &str) -> TxSubscription {
+        let hash = hash.to_uppercase();
+        let (sender, receiver) = oneshot::channel();
+        let mut subscriptions = self.subscriptions.lock().unwrap();
+
+        if let Some(result) = subscriptions.recent.remove(&hash) {
+            subscriptions.recent_order.retain(|h| h != &hash);
+            let _ = sender.send(Ok(result));
+        } else if let Some(cause) = &subscriptions.closed {
+            let _ = sender.send(Err(CosmosError::Websocket(cause.clone())));
+        } else {
+            subscriptions.pending.insert(hash, sender);
+        }
+
+        TxSubscription { receiver }
+    }
+
+    /// Returns the number of subscriptions waiting for their tx inclusion.
+    pub fn pending(&self) -> usize {
+        self.subscriptions.lock().unwrap().pending.len()
+    }
+}
+
+impl Drop for TxSubscriber {
+    fn drop(&mut self) {
+        self.reader.abort();
+    }
+}
+
+/// Checks the reply to the subscribe request, returning the error sent from the node if the
+/// subscription has been refused.
+fn check_subscribe_reply(text: &str) -> Result<(), CosmosError> {
+    let reply: RpcEvent = serde_json::from_str(text)
+        .map_err(|e| CosmosError::Websocket(format!("invalid subscribe reply: {}", e)))?;
+
+    match reply.error {
+        Some(error) => Err(CosmosError::Websocket(format!(
+            "subscribe failed: {} ({}) {}",
+            error.message, error.code, error.data
+        ))),
+        None => Ok(()),
+    }
+}
+
+/// Extracts the tx result from a message received from the websocket, returns [`None`] if the
+/// message is not a `Tx` event.
+fn parse_tx_result(text: &str) -> Option<TxResult> {
+    let event: RpcEvent = serde_json::from_str(text).ok()?;
+    let mut result = event.result?;
+    let tx_result = result.data?.value.tx_result?;
+    let hash = result.events.remove("tx.hash")?.into_iter().next()?;
+
+    Some(TxResult::from_json(hash.to_uppercase(), tx_result))
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    static TX_EVENT: &str = r#"{"jsonrpc":"2.0","id":0,"result":{"query":"tm.event='Tx'","data":{"type":"tendermint/event/Tx","value":{"TxResult":{"height":"42","index":0,"tx":"CpIBCo8BChwvY29zbW9z","result":{"data":"CgYKBHNlbmQ=","log":"[]","gas_wanted":"200000","gas_used":"61024","events":[]}}}},"events":{"tx.hash":["0A1B2C"],"tx.height":["42"],"tm.event":["Tx"]}}}"#;
+
+    fn tx_result(hash: &str) -> TxResult {
+        TxResult {
+            hash: hash.to_owned(),
+            height: 42,
+            code: 0,
+            codespace: "".to_owned(),
+            log: "[]".to_owned(),
+            gas_wanted: 200_000,
+            gas_used: 61_024,
+        }
+    }
+
+    #[test]
+    fn parse_tx_event() {
+        assert_eq!(Some(tx_result("0A1B2C")), parse_tx_result(TX_EVENT));
+
+        // Subscription confirmation
+        assert_eq!(
+            None,
+            parse_tx_result(r#"{"jsonrpc":"2.0","id":0,"result":{}}"#)
+        );
+        assert_eq!(None, parse_tx_result("not json"));
+    }
+
+    #[test]
+    fn subscribe_reply() {
+        assert_eq!(
+            Ok(()),
+            check_subscribe_reply(r#"{"jsonrpc":"2.0","id":0,"result":{}}"#)
+        );
+        assert_eq!(
+            Err(CosmosError::Websocket(
+                "subscribe failed: Internal error (-32603) max_subscriptions_per_client 5 reached"
+                    .to_owned()
+            )),
+            check_subscribe_reply(
+                r#"{"jsonrpc":"2.0","id":0,"error":{"code":-32603,"message":"Internal error","data":"max_subscriptions_per_client 5 reached"}}"#
+            )
+        );
+        assert!(check_subscribe_reply("not json").is_err());
+    }
+
+    #[actix_rt::test]
+    async fn resolve_subscriptions() {
+        let (sender, receiver) = oneshot::channel();
+        let mut subscriptions = Subscriptions::default();
+        subscriptions.pending.insert("0A1B2C".to_owned(), sender);
+
+        subscriptions.resolve(tx_result("0A1B2C"));
+        assert_eq!(Ok(tx_result("0A1B2C")), receiver.await.unwrap());
+
+        // Not subscribed results are kept for a later subscription
+        subscriptions.resolve(tx_result("3D4E5F"));
+        assert!(subscriptions.recent.contains_key("3D4E5F"));
+
+        let (sender, receiver) = oneshot::channel();
+        subscriptions.pending.insert("6A7B8C".to_owned(), sender);
+        subscriptions.close("connection closed".to_owned());
+        assert_eq!(
+            Err(CosmosError::Websocket("connection closed".to_owned())),
+            receiver.await.unwrap()
+        );
+    }
+
+    #[test]
+    fn recent_results_bounded() {
+        let mut subscriptions = Subscriptions::default();
+        for i in 0..RECENT_RESULTS_SIZE + 1 {
+            subscriptions.resolve(tx_result(&i.to_string()));
+        }
+
+        assert_eq!(RECENT_RESULTS_SIZE, subscriptions.recent.len());
+        assert!(!subscriptions.recent.contains_key("0"));
+    }
+}
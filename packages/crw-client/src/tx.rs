@@ -2,12 +2,13 @@
 //!
 //! This module provides a facility to build and sign transactions for cosmos based blockchains.
 
-use crate::error::TxBuildError;
+use crate::client::CosmosClient;
+use crate::error::{CosmosError, TxBuildError};
 use cosmos_sdk_proto::cosmos::{
     base::v1beta1::Coin,
     tx::v1beta1::{
         mode_info::{Single, Sum},
-        AuthInfo, Fee, ModeInfo, SignDoc, SignerInfo, Tx, TxBody,
+        AuthInfo, Fee, ModeInfo, SignDoc, SignerInfo, Tx, TxBody, TxRaw,
     },
 };
 use crw_wallet::crypto::MnemonicWallet;
@@ -16,12 +17,31 @@ use prost_types::Any;
 
 /// AccountInfo is a private structure which represents the information of the account
 /// that is performing the transaction.
+#[derive(Clone)]
 struct AccountInfo {
     pub sequence: u64,
     pub number: u64,
 }
 
+/// GasPrice represents the price paid for each unit of gas consumed by a transaction.
+#[derive(Clone, Debug, PartialEq)]
+pub struct GasPrice {
+    pub denom: String,
+    pub amount: f64,
+}
+
+impl GasPrice {
+    /// Creates a new gas price of `amount` `denom` for each unit of gas.
+    pub fn new(denom: &str, amount: f64) -> GasPrice {
+        GasPrice {
+            denom: denom.to_owned(),
+            amount,
+        }
+    }
+}
+
 /// TxBuilder represents the single signer transaction builder.
+#[derive(Clone)]
 pub struct TxBuilder {
     chain_id: String,
     account_info: Option<AccountInfo>,
@@ -98,13 +118,16 @@ impl TxBuilder {
         Ok(self.add_message_raw(msg_type, serialized))
     }
 
-    fn add_message_raw(mut self, msg_type: &str, binary: Vec<u8>) -> Self {
-        let data = Any {
+    fn add_message_raw(self, msg_type: &str, binary: Vec<u8>) -> Self {
+        self.add_any_message(Any {
             type_url: msg_type.to_owned(),
             value: binary,
-        };
+        })
+    }
 
-        self.tx_body.messages.push(data);
+    /// Append an already serialized message to the transaction messages.
+    pub fn add_any_message(mut self, msg: Any) -> Self {
+        self.tx_body.messages.push(msg);
         self
     }
 
@@ -137,6 +160,56 @@ impl TxBuilder {
         self
     }
 
+    /// Sets the transaction fee estimating the gas limit with a simulation of the transaction.
+    ///
+    /// The gas used by the simulation is multiplied by `multiplier` to obtain the gas limit and
+    /// the fee amount is the gas limit multiplied by `gas_price`, both rounded up.
+    /// The simulated gas is cached inside `client` for each sequence of message types, so the
+    /// following transactions with the same message types reuse the estimation without
+    /// performing the simulation again.
+    ///
+    /// The account information must be set before calling this function.
+    ///
+    /// # Errors
+    /// Returns an [`Err`] if the transaction used for the simulation can't be signed
+    /// or if the simulation fails.
+    pub async fn auto_fee(
+        self,
+        client: &CosmosClient,
+        wallet: &MnemonicWallet,
+        gas_price: &GasPrice,
+        multiplier: f64,
+    ) -> Result<Self, CosmosError> {
+        let shape = self.messages_shape();
+
+        let gas_used = match client.cached_gas(&shape) {
+            Some(gas_used) => gas_used,
+            None => {
+                // The simulation don't check the fee, so a zero fee is enough.
+                let tx = self.clone().fee(&gas_price.denom, "0", 0).sign(wallet)?;
+                let gas_used = client.simulate(&tx).await?.gas_used;
+                client.cache_gas(shape, gas_used);
+                gas_used
+            }
+        };
+
+        let gas_limit = (gas_used as f64 * multiplier).ceil() as u64;
+        let amount = (gas_limit as f64 * gas_price.amount).ceil() as u64;
+
+        Ok(self.fee(&gas_price.denom, &amount.to_string(), gas_limit))
+    }
+
+    /// Gets the sequence of message types of the transaction, that are the key under which the
+    /// simulated gas is cached.
+    fn messages_shape(&self) -> String {
+        self.tx_body
+            .messages
+            .iter()
+            .map(|msg| msg.type_url.as_str())
+            .collect::<Vec<_>>()
+            .join(",")
+    }
+
     /// Generate the signed transaction using the provided wallet.
     ///
     /// The transaction will be signed following the `SIGN_MODE_DIRECT` specification.
@@ -148,6 +221,43 @@ impl TxBuilder {
     /// * If an error occur during the transaction serialization to protobuf
     /// * If an error occur during the transaction signature.
     pub fn sign(self, wallet: &MnemonicWallet) -> Result<Tx, TxBuildError> {
+        let (tx_body, auth_info, _, signature) = self.sign_doc(wallet)?;
+
+        // compose the tx
+        Result::Ok(Tx {
+            body: Some(tx_body),
+            auth_info: Some(auth_info),
+            signatures: vec![signature],
+        })
+    }
+
+    /// Generate the signed transaction in its raw form using the provided wallet.
+    ///
+    /// Unlike [`TxBuilder::sign`] the returned [`TxRaw`] holds the exact body and auth info bytes
+    /// that have been signed, so it can be broadcast with
+    /// [`CosmosClient::broadcast_tx_raw`](crate::client::CosmosClient::broadcast_tx_raw)
+    /// without serializing the transaction again.
+    ///
+    /// # Errors
+    /// Returns an ['Err`] if one of the following cases:
+    /// * If an error occur during the transaction serialization to protobuf
+    /// * If an error occur during the transaction signature.
+    pub fn sign_raw(self, wallet: &MnemonicWallet) -> Result<TxRaw, TxBuildError> {
+        let (_, _, sign_doc, signature) = self.sign_doc(wallet)?;
+
+        Result::Ok(TxRaw {
+            body_bytes: sign_doc.body_bytes,
+            auth_info_bytes: sign_doc.auth_info_bytes,
+            signatures: vec![signature],
+        })
+    }
+
+    /// Builds and signs the transaction `SignDoc`, returning it together with the decoded
+    /// transaction body and auth info and the signature.
+    fn sign_doc(
+        self,
+        wallet: &MnemonicWallet,
+    ) -> Result<(TxBody, AuthInfo, SignDoc, Vec<u8>), TxBuildError> {
         if self.account_info.is_none() {
             return Result::Err(TxBuildError::NoAccountInfo);
         }
@@ -157,7 +267,7 @@ impl TxBuilder {
         }
 
         // Protobuf tx_body serialization
-        let mut tx_body_buffer = Vec::new();
+        let mut tx_body_buffer = Vec::with_capacity(prost::Message::encoded_len(&self.tx_body));
         prost::Message::encode(&self.tx_body, &mut tx_body_buffer)?;
 
         let mut serialized_key: Vec<u8> = Vec::new();
@@ -189,7 +299,7 @@ impl TxBuilder {
         };
 
         // Protobuf auth_info serialization
-        let mut auth_buffer = Vec::new();
+        let mut auth_buffer = Vec::with_capacity(prost::Message::encoded_len(&auth_info));
         prost::Message::encode(&auth_info, &mut auth_buffer)?;
         let sign_doc = SignDoc {
             body_bytes: tx_body_buffer,
@@ -199,7 +309,7 @@ impl TxBuilder {
         };
 
         // Protobuf sign_doc serialization
-        let mut sign_doc_buffer = Vec::new();
+        let mut sign_doc_buffer = Vec::with_capacity(prost::Message::encoded_len(&sign_doc));
         prost::Message::encode(&sign_doc, &mut sign_doc_buffer)?;
 
         // sign the doc buffer
@@ -207,12 +317,7 @@ impl TxBuilder {
             .sign(&sign_doc_buffer)
             .map_err(|err| TxBuildError::Sign(err.to_string()))?;
 
-        // compose the raw tx
-        Result::Ok(Tx {
-            body: Some(self.tx_body),
-            auth_info: Some(auth_info),
-            signatures: vec![signature],
-        })
+        Result::Ok((self.tx_body, auth_info, sign_doc, signature))
     }
 }
 
@@ -224,7 +329,8 @@ impl From<EncodeError> for TxBuildError {
 
 #[cfg(test)]
 mod tests {
-    use crate::tx::{TxBuildError, TxBuilder};
+    use crate::client::CosmosClient;
+    use crate::tx::{GasPrice, TxBuildError, TxBuilder};
     use cosmos_sdk_proto::cosmos::bank::v1beta1::MsgSend;
     use cosmos_sdk_proto::cosmos::base::v1beta1::Coin;
     use crw_wallet::crypto::MnemonicWallet;
@@ -322,4 +428,82 @@ mod tests {
         // Check that the sequence is the same passed to account_info
         assert_eq!(1, auth_info.signer_infos[0].sequence);
     }
+
+    #[test]
+    fn test_sign_raw() {
+        let wallet = MnemonicWallet::new(TEST_MNEMONIC, DESMOS_DERIVATION_PATH).unwrap();
+
+        let amount = Coin {
+            denom: "stake".to_string(),
+            amount: "10".to_string(),
+        };
+        let msg_snd = MsgSend {
+            from_address: wallet.get_bech32_address("desmos").unwrap(),
+            to_address: "desmos18ek6mnlxj8sysrtvu60k5zj0re7s5n42yncner".to_string(),
+            amount: vec![amount],
+        };
+
+        let builder = || {
+            TxBuilder::new("testchain")
+                .memo("Test memo")
+                .account_info(1, 5)
+                .fee("stake", "10", 300_000)
+                .timeout_height(1000)
+                .add_message("/cosmos.bank.v1beta1.Msg/Send", msg_snd.clone())
+                .unwrap()
+        };
+
+        let tx = builder().sign(&wallet).unwrap();
+        let tx_raw = builder().sign_raw(&wallet).unwrap();
+
+        // The raw tx must contain the same bytes of the decoded one
+        let mut body_bytes = Vec::new();
+        prost::Message::encode(tx.body.as_ref().unwrap(), &mut body_bytes).unwrap();
+        let mut auth_info_bytes = Vec::new();
+        prost::Message::encode(tx.auth_info.as_ref().unwrap(), &mut auth_info_bytes).unwrap();
+
+        assert_eq!(body_bytes, tx_raw.body_bytes);
+        assert_eq!(auth_info_bytes, tx_raw.auth_info_bytes);
+        assert_eq!(tx.signatures, tx_raw.signatures);
+    }
+
+    #[actix_rt::test]
+    async fn test_auto_fee_cached() {
+        let wallet = MnemonicWallet::new(TEST_MNEMONIC, DESMOS_DERIVATION_PATH).unwrap();
+        let client = CosmosClient::new("http://localhost:1317", "http://localhost:9090").unwrap();
+
+        let amount = Coin {
+            denom: "stake".to_string(),
+            amount: "10".to_string(),
+        };
+        let msg_snd = MsgSend {
+            from_address: wallet.get_bech32_address("desmos").unwrap(),
+            to_address: "desmos18ek6mnlxj8sysrtvu60k5zj0re7s5n42yncner".to_string(),
+            amount: vec![amount],
+        };
+
+        let builder = TxBuilder::new("testchain")
+            .account_info(1, 5)
+            .add_message("/cosmos.bank.v1beta1.Msg/Send", msg_snd.clone())
+            .unwrap()
+            .add_message("/cosmos.bank.v1beta1.Msg/Send", msg_snd)
+            .unwrap();
+
+        // With a cached estimation the simulation is not performed
+        assert_eq!(
+            "/cosmos.bank.v1beta1.Msg/Send,/cosmos.bank.v1beta1.Msg/Send",
+            builder.messages_shape()
+        );
+        client.cache_gas(builder.messages_shape(), 100_000);
+
+        let builder = builder
+            .auto_fee(&client, &wallet, &GasPrice::new("stake", 0.5), 1.5)
+            .await
+            .unwrap();
+        let fee = builder.fee.as_ref().unwrap();
+
+        assert_eq!(150_000, fee.gas_limit);
+        assert_eq!("stake", fee.amount[0].denom);
+        assert_eq!("75000", fee.amount[0].amount);
+    }
 }
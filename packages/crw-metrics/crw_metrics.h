@@ -0,0 +1,34 @@
+#ifndef CRW_METRICS_H
+#define CRW_METRICS_H
+
+/**
+ * @brief Functions to read the latency metrics of the libraries built with the metrics feature.
+ * Each library contains its own metrics registry, the functions report the metrics of the
+ * library from which they are called.
+ */
+
+/**
+ * @brief Gets a snapshot of the measured operations.
+ * @return Returns a json object with an entry for each measured operation, each entry
+ * contains the count of the measures, their sum, minimum, maximum and the 50th, 90th and
+ * 99th percentiles in nanoseconds, e.g.
+ * {"wallet.sign":{"count":10,"sum_ns":100,"min_ns":8,"max_ns":12,"p50_ns":10,"p90_ns":11,"p99_ns":12}}
+ * or NULL in case of error.
+ * The caller must take care of releasing the returned string with the
+ * crw_metrics_string_free function.
+ */
+char *crw_metrics_snapshot(void);
+
+/**
+ * @brief Release a string returned from crw_metrics_snapshot.
+ * @param str: Pointer to the string to free.
+ */
+void crw_metrics_string_free(char *str);
+
+/**
+ * @brief Removes all the recorded values, so the next snapshot contains only the
+ * following measures.
+ */
+void crw_metrics_reset(void);
+
+#endif /* CRW_METRICS_H */
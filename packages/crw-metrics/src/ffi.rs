@@ -0,0 +1,83 @@
+//! Provides the FFI to read the metrics from other programming languages.
+//!
+//! Each library built with the `metrics` feature contains its own registry, so a snapshot contains
+//! the metrics of the library that exported the called function.
+
+use crate::registry;
+use std::ffi::CString;
+use std::fmt::Write;
+use std::os::raw::c_char;
+use std::ptr::null_mut;
+
+/// Returns a json object with an entry for each measured operation, e.g.
+/// `{"wallet.sign":{"count":10,"sum_ns":100,"min_ns":8,"max_ns":12,"p50_ns":10,"p90_ns":11,"p99_ns":12}}`.
+/// The returned string must be freed using the [`crw_metrics_string_free`] function to avoid
+/// memory leaks.
+#[no_mangle]
+pub extern "C" fn crw_metrics_snapshot() -> *mut c_char {
+    let mut json = String::from("{");
+    for (i, snapshot) in registry::snapshot().iter().enumerate() {
+        if i > 0 {
+            json.push(',');
+        }
+        // The names are static identifiers, they never require to be escaped.
+        let _ = write!(
+            json,
+            "\"{}\":{{\"count\":{},\"sum_ns\":{},\"min_ns\":{},\"max_ns\":{},\"p50_ns\":{},\"p90_ns\":{},\"p99_ns\":{}}}",
+            snapshot.name,
+            snapshot.count,
+            snapshot.sum_ns,
+            snapshot.min_ns,
+            snapshot.max_ns,
+            snapshot.p50_ns,
+            snapshot.p90_ns,
+            snapshot.p99_ns
+        );
+    }
+    json.push('}');
+
+    CString::new(json)
+        .map(CString::into_raw)
+        .unwrap_or(null_mut())
+}
+
+/// Release a string returned from [`crw_metrics_snapshot`].
+#[no_mangle]
+pub extern "C" fn crw_metrics_string_free(s: *mut c_char) {
+    if s.is_null() {
+        return;
+    }
+    unsafe {
+        CString::from_raw(s);
+    }
+}
+
+/// Removes all the recorded values, so the next snapshot contains only the following
+/// measures.
+#[no_mangle]
+pub extern "C" fn crw_metrics_reset() {
+    registry::reset();
+}
+
+#[cfg(test)]
+mod test {
+    use crate::ffi::{crw_metrics_snapshot, crw_metrics_string_free};
+    use std::ffi::CStr;
+
+    #[test]
+    pub fn test_snapshot() {
+        {
+            let _timer = crate::timer!("ffi.snapshot");
+        }
+
+        let snapshot = crw_metrics_snapshot();
+        let json = unsafe { CStr::from_ptr(snapshot) }
+            .to_str()
+            .unwrap()
+            .to_owned();
+        crw_metrics_string_free(snapshot);
+
+        assert!(json.starts_with('{') && json.ends_with('}'));
+        assert!(json.contains("\"ffi.snapshot\":{\"count\":1,"));
+    }
+}
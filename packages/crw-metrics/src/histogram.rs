@@ -0,0 +1,179 @@
+//! Module that provides a lock free latency histogram.
+
+use std::sync::atomic::{AtomicU64, Ordering};
+
+/// Number of sub buckets for each power of two, the recorded values are approximated with an
+/// error of at most 1/8.
+const SUB_BUCKETS: usize = 8;
+const SUB_BUCKET_BITS: u32 = 3;
+/// Number of buckets required to cover all the u64 values.
+const BUCKETS: usize = (64 - SUB_BUCKET_BITS as usize + 1) * SUB_BUCKETS;
+
+/// Histogram of durations expressed in nanoseconds.
+///
+/// The values are counted into buckets whose width grows exponentially, so the histogram has a
+/// fixed size and recording a value don't require any lock or allocation.
+pub struct Histogram {
+    buckets: Box<[AtomicU64]>,
+    count: AtomicU64,
+    sum: AtomicU64,
+    min: AtomicU64,
+    max: AtomicU64,
+}
+
+/// Summary of the values recorded into a [Histogram].
+#[derive(Clone, Debug, PartialEq)]
+pub struct HistogramSnapshot {
+    /// Name of the measured operation.
+    pub name: &'static str,
+    /// Number of recorded values.
+    pub count: u64,
+    /// Sum of the recorded values.
+    pub sum_ns: u64,
+    pub min_ns: u64,
+    pub max_ns: u64,
+    pub p50_ns: u64,
+    pub p90_ns: u64,
+    pub p99_ns: u64,
+}
+
+/// Returns the index of the bucket where is counted `value`.
+fn bucket_index(value: u64) -> usize {
+    if value < SUB_BUCKETS as u64 {
+        return value as usize;
+    }
+    let msb = 63 - value.leading_zeros();
+    let group = (msb - SUB_BUCKET_BITS + 1) as usize;
+    let sub_bucket = ((value >> (msb - SUB_BUCKET_BITS)) as usize) & (SUB_BUCKETS - 1);
+
+    group * SUB_BUCKETS + sub_bucket
+}
+
+/// Returns the greatest value counted into the bucket with the provided `index`.
+fn bucket_upper_bound(index: usize) -> u64 {
+    if index < SUB_BUCKETS {
+        return index as u64;
+    }
+    let group = index / SUB_BUCKETS;
+    let sub_bucket = (index % SUB_BUCKETS) as u64;
+    let lower = (SUB_BUCKETS as u64 + sub_bucket) << (group - 1);
+
+    lower + ((1u64 << (group - 1)) - 1)
+}
+
+impl Histogram {
+    pub fn new() -> Histogram {
+        Histogram {
+            buckets: (0..BUCKETS).map(|_| AtomicU64::new(0)).collect(),
+            count: AtomicU64::new(0),
+            sum: AtomicU64::new(0),
+            min: AtomicU64::new(u64::MAX),
+            max: AtomicU64::new(0),
+        }
+    }
+
+    /// Records a duration of `value` nanoseconds.
+    pub fn record(&self, value: u64) {
+        self.buckets[bucket_index(value)].fetch_add(1, Ordering::Relaxed);
+        self.count.fetch_add(1, Ordering::Relaxed);
+        self.sum.fetch_add(value, Ordering::Relaxed);
+        self.min.fetch_min(value, Ordering::Relaxed);
+        self.max.fetch_max(value, Ordering::Relaxed);
+    }
+
+    /// Removes all the recorded values.
+    pub fn reset(&self) {
+        for bucket in self.buckets.iter() {
+            bucket.store(0, Ordering::Relaxed);
+        }
+        self.count.store(0, Ordering::Relaxed);
+        self.sum.store(0, Ordering::Relaxed);
+        self.min.store(u64::MAX, Ordering::Relaxed);
+        self.max.store(0, Ordering::Relaxed);
+    }
+
+    /// Summarizes the recorded values.
+    /// The values recorded while the snapshot is taken may be partially included.
+    ///
+    /// * `name` - the name of the measured operation.
+    pub fn snapshot(&self, name: &'static str) -> HistogramSnapshot {
+        let buckets: Vec<u64> = self
+            .buckets
+            .iter()
+            .map(|bucket| bucket.load(Ordering::Relaxed))
+            .collect();
+        let count: u64 = buckets.iter().sum();
+        let min = self.min.load(Ordering::Relaxed);
+        let max = self.max.load(Ordering::Relaxed);
+
+        // Returns the upper bound of the bucket that contains the requested percentile.
+        let percentile = |percentile: u64| {
+            let rank = (count * percentile + 99) / 100;
+            let mut seen = 0;
+            for (index, bucket) in buckets.iter().enumerate() {
+                seen += bucket;
+                if seen >= rank && seen > 0 {
+                    return bucket_upper_bound(index).min(max);
+                }
+            }
+            0
+        };
+
+        HistogramSnapshot {
+            name,
+            count,
+            sum_ns: self.sum.load(Ordering::Relaxed),
+            min_ns: if count == 0 { 0 } else { min },
+            max_ns: max,
+            p50_ns: percentile(50),
+            p90_ns: percentile(90),
+            p99_ns: percentile(99),
+        }
+    }
+}
+
+impl Default for Histogram {
+    fn default() -> Self {
+        Histogram::new()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use crate::histogram::{bucket_index, bucket_upper_bound, Histogram, BUCKETS};
+
+    #[test]
+    pub fn test_bucket_bounds() {
+        for value in (0..10_000).chain(vec![u64::MAX / 2, u64::MAX]) {
+            let index = bucket_index(value);
+            assert!(index < BUCKETS);
+            assert!(value <= bucket_upper_bound(index));
+            if index > 0 {
+                assert!(value > bucket_upper_bound(index - 1));
+            }
+        }
+        assert_eq!(u64::MAX, bucket_upper_bound(BUCKETS - 1));
+    }
+
+    #[test]
+    pub fn test_percentiles() {
+        let histogram = Histogram::new();
+        for value in 1..=1000 {
+            histogram.record(value);
+        }
+
+        let snapshot = histogram.snapshot("test");
+        assert_eq!(1000, snapshot.count);
+        assert_eq!(500_500, snapshot.sum_ns);
+        assert_eq!(1, snapshot.min_ns);
+        assert_eq!(1000, snapshot.max_ns);
+        // The percentiles are approximated by at most 1/8
+        assert!(snapshot.p50_ns >= 500 && snapshot.p50_ns <= 500 + 500 / 8);
+        assert!(snapshot.p90_ns >= 900 && snapshot.p90_ns <= 900 + 900 / 8);
+        assert!(snapshot.p99_ns >= 990 && snapshot.p99_ns <= 1000);
+
+        histogram.reset();
+        assert_eq!(0, histogram.snapshot("test").count);
+        assert_eq!(0, histogram.snapshot("test").min_ns);
+    }
+}
@@ -0,0 +1,100 @@
+//! Crate that provides the latency histograms and the `tracing` spans used to instrument the
+//! hot paths of the other cosmos-rust-wallet crates.
+//!
+//! Each measured operation is identified by a static name, the time spent inside the operation is
+//! recorded into the histogram with that name and the operation is wrapped into a `tracing` span
+//! with the same name.
+//!
+//! ```
+//! fn sign() {
+//!     let _timer = crw_metrics::timer!("wallet.sign");
+//!     // ... the time spent until the end of the scope is recorded
+//! }
+//!
+//! sign();
+//! let snapshot = crw_metrics::snapshot();
+//! ```
+//!
+//! The other crates instrument their code with the [timed] and [timed_future] macros, that
+//! expand to nothing unless this crate is built with the `enabled` feature, so the default
+//! builds don't pay anything.
+
+pub mod histogram;
+mod registry;
+
+#[cfg(feature = "ffi")]
+pub mod ffi;
+
+pub use crate::histogram::{Histogram, HistogramSnapshot};
+pub use crate::registry::{histogram, reset, snapshot, SpanTimer, Timer};
+
+// Used from the timer! macro expansion.
+#[doc(hidden)]
+pub use once_cell;
+#[doc(hidden)]
+pub use tracing;
+
+/// Measures the time spent from this call to the end of the current scope, recording it into the
+/// histogram with the provided name and entering a `tracing` span with the same name.
+///
+/// The histogram is resolved only once for each call site, so after the first call a measure
+/// costs only two clock reads and a few atomic increments.
+/// The returned guard keeps the span entered, so it must not be held across an `.await`, use
+/// [timed_future] for the futures instead.
+#[macro_export]
+macro_rules! timer {
+    ($name:literal) => {{
+        static HISTOGRAM: $crate::once_cell::sync::Lazy<std::sync::Arc<$crate::Histogram>> =
+            $crate::once_cell::sync::Lazy::new(|| $crate::histogram($name));
+        $crate::Timer::new(&HISTOGRAM).in_span($crate::tracing::info_span!($name))
+    }};
+}
+
+/// Measures the time spent from this call to the end of the current scope with [timer] when
+/// the `enabled` feature is on, otherwise it expands to nothing.
+#[cfg(feature = "enabled")]
+#[macro_export]
+macro_rules! timed {
+    ($name:literal) => {
+        let _timer = $crate::timer!($name);
+    };
+}
+
+/// Measures the time spent from this call to the end of the current scope with [timer] when
+/// the `enabled` feature is on, otherwise it expands to nothing.
+#[cfg(not(feature = "enabled"))]
+#[macro_export]
+macro_rules! timed {
+    ($name:literal) => {};
+}
+
+/// Measures the time spent from the first poll of `$future` to its completion, recording it into
+/// the histogram with the provided name and instrumenting the future with a `tracing` span with
+/// the same name, when the `enabled` feature is on. Otherwise it expands to `$future`.
+#[cfg(feature = "enabled")]
+#[macro_export]
+macro_rules! timed_future {
+    ($name:literal, $future:expr) => {{
+        static HISTOGRAM: $crate::once_cell::sync::Lazy<std::sync::Arc<$crate::Histogram>> =
+            $crate::once_cell::sync::Lazy::new(|| $crate::histogram($name));
+        let future = $future;
+        $crate::tracing::Instrument::instrument(
+            async move {
+                let _timer = $crate::Timer::new(&HISTOGRAM);
+                future.await
+            },
+            $crate::tracing::info_span!($name),
+        )
+    }};
+}
+
+/// Measures the time spent from the first poll of `$future` to its completion, recording it into
+/// the histogram with the provided name and instrumenting the future with a `tracing` span with
+/// the same name, when the `enabled` feature is on. Otherwise it expands to `$future`.
+#[cfg(not(feature = "enabled"))]
+#[macro_export]
+macro_rules! timed_future {
+    ($name:literal, $future:expr) => {
+        $future
+    };
+}
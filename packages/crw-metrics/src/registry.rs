@@ -0,0 +1,133 @@
+//! Module that provides the global registry of the histograms and the [Timer] used to fill them.
+
+use crate::histogram::{Histogram, HistogramSnapshot};
+use once_cell::sync::Lazy;
+#[cfg(not(target_arch = "wasm32"))]
+use std::convert::TryFrom;
+use std::sync::{Arc, Mutex};
+#[cfg(not(target_arch = "wasm32"))]
+use std::time::Instant;
+use tracing::span::EnteredSpan;
+use tracing::Span;
+
+/// Histograms registered so far, in registration order.
+static REGISTRY: Lazy<Mutex<Vec<(&'static str, Arc<Histogram>)>>> =
+    Lazy::new(|| Mutex::new(Vec::new()));
+
+/// Gets the histogram with the provided `name`, registering it if don't exist.
+pub fn histogram(name: &'static str) -> Arc<Histogram> {
+    let mut registry = REGISTRY.lock().unwrap();
+    if let Some((_, histogram)) = registry.iter().find(|(n, _)| *n == name) {
+        return histogram.clone();
+    }
+
+    let histogram = Arc::new(Histogram::new());
+    registry.push((name, histogram.clone()));
+    histogram
+}
+
+/// Summarizes all the registered histograms.
+pub fn snapshot() -> Vec<HistogramSnapshot> {
+    REGISTRY
+        .lock()
+        .unwrap()
+        .iter()
+        .map(|(name, histogram)| histogram.snapshot(name))
+        .collect()
+}
+
+/// Removes the values recorded into all the registered histograms.
+pub fn reset() {
+    for (_, histogram) in REGISTRY.lock().unwrap().iter() {
+        histogram.reset();
+    }
+}
+
+/// Guard that records the time elapsed from its creation into a histogram when dropped.
+/// Use the [timer](crate::timer) macro to create it together with its span.
+///
+/// On wasm the system clock is not available, so nothing is recorded.
+pub struct Timer {
+    #[cfg_attr(target_arch = "wasm32", allow(dead_code))]
+    histogram: &'static Histogram,
+    #[cfg(not(target_arch = "wasm32"))]
+    start: Instant,
+}
+
+impl Timer {
+    pub fn new(histogram: &'static Histogram) -> Timer {
+        Timer {
+            histogram,
+            #[cfg(not(target_arch = "wasm32"))]
+            start: Instant::now(),
+        }
+    }
+
+    /// Enters `span` until the timer is dropped.
+    pub fn in_span(self, span: Span) -> SpanTimer {
+        SpanTimer {
+            _timer: self,
+            _span: span.entered(),
+        }
+    }
+}
+
+/// A [Timer] that keeps a `tracing` span entered, the measure is recorded before exiting
+/// the span.
+pub struct SpanTimer {
+    _timer: Timer,
+    _span: EnteredSpan,
+}
+
+impl Drop for Timer {
+    fn drop(&mut self) {
+        #[cfg(not(target_arch = "wasm32"))]
+        {
+            let elapsed = self.start.elapsed().as_nanos();
+            self.histogram
+                .record(u64::try_from(elapsed).unwrap_or(u64::MAX));
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use crate::registry::{histogram, snapshot};
+    use std::sync::Arc;
+
+    #[test]
+    pub fn test_timer() {
+        for _ in 0..10 {
+            let _timer = crate::timer!("registry.timer");
+        }
+
+        let snapshot = snapshot()
+            .into_iter()
+            .find(|s| s.name == "registry.timer")
+            .unwrap();
+        assert_eq!(10, snapshot.count);
+        assert!(snapshot.max_ns >= snapshot.min_ns);
+    }
+
+    #[cfg(feature = "enabled")]
+    #[test]
+    pub fn test_timed() {
+        {
+            crate::timed!("registry.timed");
+        }
+
+        let snapshot = snapshot()
+            .into_iter()
+            .find(|s| s.name == "registry.timed")
+            .unwrap();
+        assert_eq!(1, snapshot.count);
+    }
+
+    #[test]
+    pub fn test_same_name() {
+        let first = histogram("registry.same");
+        let second = histogram("registry.same");
+
+        assert!(Arc::ptr_eq(&first, &second));
+    }
+}
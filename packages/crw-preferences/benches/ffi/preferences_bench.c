@@ -0,0 +1,98 @@
+/***
+ * @brief Benchmarks of the preferences FFI defined inside crw_preferences.h.
+ * Build and run it with `make bench-ffi`.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "crw_preferences.h"
+
+#define PASSWORD "bench-password"
+#define ENTRIES 1000
+
+static double now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void report(const char *name, double start, int iterations) {
+  printf("%-40s %12.0f ns/iter\n", name, (now_ns() - start) / iterations);
+}
+
+static void check(int condition, const char *what) {
+  if (!condition) {
+    fprintf(stderr, "%s failed\n", what);
+    exit(1);
+  }
+}
+
+int main() {
+  char key[32];
+  char value[32];
+  unsigned char out[64];
+  int32_t out_i32;
+
+  check(set_preferences_app_dir("crw-preferences-bench") == 0, "set_preferences_app_dir");
+
+  void *prefs = encrypted_preferences("bench-ffi", PASSWORD);
+  check(prefs != NULL, "encrypted_preferences");
+
+  double start = now_ns();
+  for (int i = 0; i < ENTRIES; i++) {
+    snprintf(key, sizeof(key), "key-%d", i);
+    snprintf(value, sizeof(value), "value-%d", i);
+    check(preferences_put_string(prefs, key, value) == 0, "preferences_put_string");
+  }
+  report("preferences_put_string", start, ENTRIES);
+
+  start = now_ns();
+  for (int i = 0; i < ENTRIES; i++) {
+    snprintf(key, sizeof(key), "key-%d", i);
+    check(preferences_get_string(prefs, key, out, sizeof(out)) > 0, "preferences_get_string");
+  }
+  report("preferences_get_string", start, ENTRIES);
+
+  check(preferences_put_i32(prefs, "i32", 42) == 0, "preferences_put_i32");
+  start = now_ns();
+  for (int i = 0; i < ENTRIES; i++) {
+    check(preferences_get_i32(prefs, "i32", &out_i32) == 0, "preferences_get_i32");
+  }
+  report("preferences_get_i32", start, ENTRIES);
+
+  preference_entry_t entries[ENTRIES];
+  static char keys[ENTRIES][32];
+  static uint8_t arena[ENTRIES * 32];
+  for (int i = 0; i < ENTRIES; i++) {
+    snprintf(keys[i], sizeof(keys[i]), "key-%d", i);
+    memset(&entries[i], 0, sizeof(entries[i]));
+    entries[i].key = keys[i];
+    entries[i].key_len = strlen(keys[i]);
+    entries[i].value_type = PREFERENCE_STRING;
+  }
+  start = now_ns();
+  check(preferences_get_many(prefs, entries, ENTRIES, arena, sizeof(arena)) >= 0,
+        "preferences_get_many");
+  report("preferences_get_many (per entry)", start, ENTRIES);
+
+  start = now_ns();
+  for (int i = 0; i < 10; i++) {
+    check(preferences_save(prefs) == 0, "preferences_save");
+  }
+  report("preferences_save (1k entries)", start, 10);
+
+  start = now_ns();
+  for (int i = 0; i < 10; i++) {
+    void *loaded = encrypted_preferences("bench-ffi", PASSWORD);
+    check(loaded != NULL, "encrypted_preferences");
+    preferences_free(loaded);
+  }
+  report("encrypted_preferences load (1k entries)", start, 10);
+
+  preferences_erase(prefs);
+  preferences_free(prefs);
+  return 0;
+}
@@ -0,0 +1,42 @@
+use criterion::{criterion_group, criterion_main, BenchmarkId, Criterion};
+use crw_preferences::encrypted::EncryptedPreferences;
+use crw_preferences::preferences::{self, Preferences};
+
+static PASSWORD: &str = "bench-password";
+static ENTRIES: [usize; 3] = [10, 1_000, 10_000];
+
+/// Creates and saves an encrypted preferences set with `entries` values.
+fn create_set(name: &str, entries: usize) -> EncryptedPreferences {
+    let mut preferences = EncryptedPreferences::new(PASSWORD, name).unwrap();
+    for i in 0..entries {
+        preferences
+            .put_str(&format!("key-{}", i), format!("value-{}", i))
+            .unwrap();
+    }
+    preferences.save().unwrap();
+    preferences
+}
+
+fn bench_encrypted(c: &mut Criterion) {
+    // The benches are not test builds, so the preferences need a real app directory.
+    preferences::set_preferences_app_dir("crw-preferences-bench").unwrap();
+
+    let mut group = c.benchmark_group("EncryptedPreferences");
+    for entries in ENTRIES.iter() {
+        let name = format!("bench-encrypted-{}", entries);
+        let mut set = create_set(&name, *entries);
+
+        group.bench_with_input(BenchmarkId::new("load", entries), &name, |b, name| {
+            b.iter(|| EncryptedPreferences::new(PASSWORD, name).unwrap())
+        });
+        group.bench_with_input(BenchmarkId::new("save", entries), &set, |b, set| {
+            b.iter(|| set.save().unwrap())
+        });
+
+        set.erase();
+    }
+    group.finish();
+}
+
+criterion_group!(benches, bench_encrypted);
+criterion_main!(benches);
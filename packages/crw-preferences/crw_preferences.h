@@ -13,6 +13,8 @@
  * be created inside the current user configurations directory.
  * On Android instead since is not possible to obtain the `appData` directory at runtime
  * must be an absolute path to a directory where the application can read and write.
+ * The directory is resolved only once, so this function must be called before accessing
+ * any preferences and can't change the directory already set.
  * @return Returns 0 on success -1 on error.
  * In case of error, the error cause can be obtained using the error_message_utf8
  * function.
@@ -54,6 +56,75 @@ void *preferences(const char *name);
 void *encrypted_preferences(const char *name,
                             const char *password);
 
+/**
+ * @brief Creates a new preferences stored into an append-only log with the provided name
+ * or loads a previously created one with the same name.
+ * Each save appends only the values changed after the previous save.
+ * @param name The preferences name, can contains only ascii alphanumeric chars or -, _.
+ * @return Returns a valid pointer on success or nullptr if an error occurred.
+ * In case of error, the error cause can be obtained using the error_message_utf8
+ * function.
+ */
+void *journal_preferences(const char *name);
+
+/**
+ * @brief Creates a new encrypted preferences stored into an append-only log with the
+ * provided name or loads a previously created one with the same name.
+ * Each save appends only the values changed after the previous save.
+ * @param name The preferences name, can contains only ascii alphanumeric chars or -, _.
+ * @param password The password used to secure the preferences.
+ * @return Returns a valid pointer on success or nullptr if an error occurred.
+ * In case of error, the error cause can be obtained using the error_message_utf8
+ * function.
+ */
+void *encrypted_journal_preferences(const char *name,
+                                    const char *password);
+
+/**
+ * @brief Opens the preferences stored into a not encrypted append-only log with the
+ * provided name building only the index of its keys, the values are loaded from the
+ * device storage only when requested.
+ * The log can be created with this function or with journal_preferences.
+ * @param name The preferences name, can contains only ascii alphanumeric chars or -, _.
+ * @return Returns a valid pointer on success or nullptr if an error occurred.
+ * In case of error, the error cause can be obtained using the error_message_utf8
+ * function.
+ */
+void *lazy_preferences(const char *name);
+
+/**
+ * @brief Opens a thread safe handle to the preferences with the provided name.
+ * All the handles opened with the same name share a single in-memory preferences set
+ * that is loaded from the device storage only the first time, the reads are performed
+ * concurrently while the writes are serialized.
+ * A handle must not be used concurrently from multiple threads, instead each thread
+ * should open its own handle.
+ * Fails if the preferences set is already opened with shared_encrypted_preferences.
+ * @param name The preferences name, can contains only ascii alphanumeric chars or -, _.
+ * @return Returns a valid pointer on success or nullptr if an error occurred.
+ * The handle must be released with preferences_free.
+ * In case of error, the error cause can be obtained using the error_message_utf8
+ * function.
+ */
+void *shared_preferences(const char *name);
+
+/**
+ * @brief Opens a thread safe handle to the encrypted preferences with the provided name.
+ * All the handles opened with the same name share a single in-memory preferences set
+ * that is loaded from the device storage only the first time, the reads are performed
+ * concurrently while the writes are serialized.
+ * A handle must not be used concurrently from multiple threads, instead each thread
+ * should open its own handle.
+ * @param name The preferences name, can contains only ascii alphanumeric chars or -, _.
+ * @param password The password used to secure the preferences.
+ * @return Returns a valid pointer on success or nullptr if an error occurred.
+ * The handle must be released with preferences_free.
+ * In case of error, the error cause can be obtained using the error_message_utf8
+ * function.
+ */
+void *shared_encrypted_preferences(const char *name,
+                                   const char *password);
+
 /**
  * @brief Release all the resources owned by a preferences instance.
  * @param preferences Pointer to the preference instance to free.
@@ -193,6 +264,95 @@ int preferences_erase(void *preferences);
  */
 int preferences_save(void *preferences);
 
+/**
+ * @brief Type of the values read or wrote with preferences_get_many and preferences_put_many.
+ */
+typedef enum {
+  PREFERENCE_I32 = 0,
+  PREFERENCE_BOOL = 1,
+  PREFERENCE_STRING = 2,
+  PREFERENCE_BYTES = 3,
+} preference_type_t;
+
+/**
+ * @brief Descriptor of a value read or wrote with preferences_get_many and
+ * preferences_put_many.
+ */
+typedef struct {
+  /**
+   * @brief UTF-8 encoded key, not necessarily null terminated.
+   */
+  const char *key;
+  /**
+   * @brief Length in bytes of key.
+   */
+  size_t key_len;
+  /**
+   * @brief The value type, one of preference_type_t.
+   */
+  int value_type;
+  /**
+   * @brief The value if value_type is PREFERENCE_I32.
+   */
+  int32_t i32_value;
+  /**
+   * @brief The value if value_type is PREFERENCE_BOOL.
+   */
+  bool bool_value;
+  /**
+   * @brief The value if value_type is PREFERENCE_STRING or PREFERENCE_BYTES,
+   * the strings are UTF-8 encoded and not null terminated.
+   */
+  const uint8_t *data;
+  /**
+   * @brief Length in bytes of data.
+   */
+  size_t data_len;
+  /**
+   * @brief Result of the operation on this entry, see preferences_get_many and
+   * preferences_put_many.
+   */
+  int status;
+} preference_entry_t;
+
+/**
+ * @brief Gets multiple values from the preferences with a single call.
+ * @param preferences pointer to the preferences from which will be extracted the values.
+ * @param entries array of entries whose key and value_type tell the values to load.
+ * @param count length of entries.
+ * @param arena buffer where are copied the strings and arrays of bytes, the entries data
+ * will point inside this buffer.
+ * @param arena_len length of arena.
+ * The status of each entry is set to 0 if the value has been loaded, -1 if the value is not
+ * present into the preferences, -2 if the entry key or type is invalid or -3 if the value
+ * don't fit into arena, in this case data_len is set to the value length.
+ * @return Returns the number of bytes of arena required to load all the values, if greater
+ * than arena_len the call can be repeated with a larger arena, or -1 if one of the provided
+ * arguments is invalid or the required length is greater than INT_MAX.
+ * In case the required length is too large, the error cause can be obtained using the
+ * error_message_utf8 function.
+ */
+int preferences_get_many(const void *preferences,
+                         preference_entry_t *entries,
+                         size_t count,
+                         uint8_t *arena,
+                         size_t arena_len);
+
+/**
+ * @brief Puts multiple values into the preferences with a single call.
+ * @param preferences pointer to the preferences where will be stored the values.
+ * @param entries array of entries whose key, value_type and value tell the values to store.
+ * @param count length of entries.
+ * The status of each entry is set to 0 if the value has been stored, -1 if an error
+ * occurred while storing the value or -2 if the entry is invalid.
+ * @return Returns 0 if all the values have been stored or -1 on error.
+ * In case of error, the error cause can be obtained using the error_message_utf8
+ * function.
+ */
+int preferences_put_many(void *preferences,
+                         preference_entry_t *entries,
+                         size_t count);
+
 /**
  * @brief Clears the last error.
  */
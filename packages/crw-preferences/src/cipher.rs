@@ -0,0 +1,183 @@
+//! Module that provides the authenticated encryption used to secure the preferences.
+//!
+//! The encryption key is derived from the password with PBKDF2-HMAC-SHA256 only once, when the
+//! [PreferencesCipher] is created, and then reused to encrypt the data with ChaCha20Poly1305
+//! using a fresh random nonce each time.
+//!
+//! The encrypted data have the following layout:
+//!
+//! | magic `CRWP` | version | salt     | nonce    | ciphertext + tag |
+//! | ------------ | ------- | -------- | -------- | ---------------- |
+//! | 4 bytes      | 1 byte  | 16 bytes | 12 bytes | variable         |
+
+use chacha20poly1305::aead::{Aead, NewAead};
+use chacha20poly1305::{ChaCha20Poly1305, Key, Nonce};
+use hmac::Hmac;
+use sha2::Sha256;
+use thiserror::Error;
+use zeroize::Zeroizing;
+
+/// Magic bytes that identify the data encrypted with a [PreferencesCipher].
+const MAGIC: &[u8; 4] = b"CRWP";
+/// Version of the encrypted data layout.
+const VERSION: u8 = 1;
+/// Number of PBKDF2 iterations used to derive the key, the same used from cocoon.
+const KDF_ITERATIONS: u32 = 100_000;
+const KEY_SIZE: usize = 32;
+const SALT_SIZE: usize = 16;
+const NONCE_SIZE: usize = 12;
+const HEADER_SIZE: usize = MAGIC.len() + 1 + SALT_SIZE + NONCE_SIZE;
+
+#[derive(Error, Debug, PartialEq)]
+pub enum CipherError {
+    #[error("unable to generate random bytes")]
+    Random,
+    #[error("invalid encrypted data")]
+    Malformed,
+    #[error("error while decrypting the data")]
+    DecryptionFailed,
+    #[error("error while encrypting the data")]
+    EncryptionFailed,
+}
+
+/// Cipher that holds the key derived from a password.
+pub struct PreferencesCipher {
+    key: Zeroizing<[u8; KEY_SIZE]>,
+    salt: [u8; SALT_SIZE],
+}
+
+impl PreferencesCipher {
+    /// Creates a new cipher deriving the key from `password` and a random salt.
+    ///
+    /// # Errors
+    /// Returns [CipherError::Random] if the random salt can't be generated.
+    pub fn new(password: &str) -> Result<PreferencesCipher, CipherError> {
+        let mut salt = [0u8; SALT_SIZE];
+        getrandom::getrandom(&mut salt).map_err(|_| CipherError::Random)?;
+
+        Ok(PreferencesCipher::with_salt(password, salt))
+    }
+
+    /// Creates a new cipher deriving the key from `password` and `salt`.
+    fn with_salt(password: &str, salt: [u8; SALT_SIZE]) -> PreferencesCipher {
+        timed!("preferences.kdf");
+        let mut key = Zeroizing::new([0u8; KEY_SIZE]);
+        pbkdf2::pbkdf2::<Hmac<Sha256>>(password.as_bytes(), &salt, KDF_ITERATIONS, &mut *key);
+
+        PreferencesCipher { key, salt }
+    }
+
+    /// Tells if `data` has been encrypted with a [PreferencesCipher].
+    pub fn is_encrypted(data: &[u8]) -> bool {
+        data.len() >= HEADER_SIZE && data.starts_with(MAGIC) && data[MAGIC.len()] == VERSION
+    }
+
+    /// Creates a cipher deriving the key from `password` and the salt stored into `data`, then
+    /// decrypts `data`.
+    /// The returned cipher can be used to encrypt other data with the same key.
+    ///
+    /// # Errors
+    /// Returns [CipherError::Malformed] if `data` has not been encrypted with a
+    /// [PreferencesCipher] or [CipherError::DecryptionFailed] if the password is not valid or the
+    /// data is corrupted.
+    pub fn open_with_password(
+        password: &str,
+        data: &[u8],
+    ) -> Result<(PreferencesCipher, Vec<u8>), CipherError> {
+        if !PreferencesCipher::is_encrypted(data) {
+            return Err(CipherError::Malformed);
+        }
+
+        let salt_start = MAGIC.len() + 1;
+        let mut salt = [0u8; SALT_SIZE];
+        salt.copy_from_slice(&data[salt_start..salt_start + SALT_SIZE]);
+
+        let cipher = PreferencesCipher::with_salt(password, salt);
+        let decrypted = cipher.decrypt(data)?;
+        Ok((cipher, decrypted))
+    }
+
+    /// Encrypts `plaintext` with a fresh random nonce.
+    ///
+    /// # Errors
+    /// Returns [CipherError::Random] if the nonce can't be generated.
+    pub fn encrypt(&self, plaintext: &[u8]) -> Result<Vec<u8>, CipherError> {
+        let mut nonce = [0u8; NONCE_SIZE];
+        getrandom::getrandom(&mut nonce).map_err(|_| CipherError::Random)?;
+
+        let ciphertext = ChaCha20Poly1305::new(Key::from_slice(&*self.key))
+            .encrypt(Nonce::from_slice(&nonce), plaintext)
+            .map_err(|_| CipherError::EncryptionFailed)?;
+
+        let mut data = Vec::with_capacity(HEADER_SIZE + ciphertext.len());
+        data.extend_from_slice(MAGIC);
+        data.push(VERSION);
+        data.extend_from_slice(&self.salt);
+        data.extend_from_slice(&nonce);
+        data.extend_from_slice(&ciphertext);
+        Ok(data)
+    }
+
+    /// Decrypts `data` previously encrypted with a cipher with the same key.
+    ///
+    /// # Errors
+    /// Returns [CipherError::Malformed] if `data` has not been encrypted with a
+    /// [PreferencesCipher] or [CipherError::DecryptionFailed] if the key is not valid or the
+    /// data is corrupted.
+    pub fn decrypt(&self, data: &[u8]) -> Result<Vec<u8>, CipherError> {
+        if !PreferencesCipher::is_encrypted(data) {
+            return Err(CipherError::Malformed);
+        }
+
+        let nonce_start = MAGIC.len() + 1 + SALT_SIZE;
+        let nonce = Nonce::from_slice(&data[nonce_start..HEADER_SIZE]);
+
+        ChaCha20Poly1305::new(Key::from_slice(&*self.key))
+            .decrypt(nonce, &data[HEADER_SIZE..])
+            .map_err(|_| CipherError::DecryptionFailed)
+    }
+}
+
+#[cfg(test)]
+mod test {
+    use crate::cipher::{CipherError, PreferencesCipher};
+
+    #[test]
+    pub fn test_encrypt_decrypt() {
+        let cipher = PreferencesCipher::new("password").unwrap();
+        let data = b"some data to encrypt";
+
+        let encrypted = cipher.encrypt(data).unwrap();
+        assert!(PreferencesCipher::is_encrypted(&encrypted));
+        assert_eq!(data.to_vec(), cipher.decrypt(&encrypted).unwrap());
+
+        // Each encryption uses a different nonce
+        assert_ne!(encrypted, cipher.encrypt(data).unwrap());
+    }
+
+    #[test]
+    pub fn test_open_with_password() {
+        let cipher = PreferencesCipher::new("password").unwrap();
+        let encrypted = cipher.encrypt(b"data").unwrap();
+
+        let (opened, decrypted) =
+            PreferencesCipher::open_with_password("password", &encrypted).unwrap();
+        assert_eq!(b"data".to_vec(), decrypted);
+        // The opened cipher reuses the same key
+        let encrypted = opened.encrypt(b"other data").unwrap();
+        assert_eq!(b"other data".to_vec(), cipher.decrypt(&encrypted).unwrap());
+
+        assert_eq!(
+            CipherError::DecryptionFailed,
+            PreferencesCipher::open_with_password("wrong", &encrypted)
+                .err()
+                .unwrap()
+        );
+        assert_eq!(
+            CipherError::Malformed,
+            PreferencesCipher::open_with_password("password", b"CRWP")
+                .err()
+                .unwrap()
+        );
+    }
+}
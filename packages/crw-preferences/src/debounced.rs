@@ -0,0 +1,374 @@
+//! Module that provides a [Preferences] wrapper that coalesces the saves into the device storage.
+//!
+//! Since each save rewrites the whole preferences set, saving after each change is expensive.
+//! [DebouncedPreferences] instead schedules the save on a background thread that waits for a
+//! time window, so all the changes and the saves requested inside the window result in a
+//! single write to the device storage.
+//!
+//! When the wrapped preferences support [prepare_save](Preferences::prepare_save) the reads
+//! and the writes of the values are blocked only while the preferences are serialized, the
+//! write to the device storage is performed without holding them.
+
+use crate::preferences::{Preferences, PreferencesError, Result};
+use std::sync::{Arc, Condvar, Mutex, MutexGuard};
+use std::thread::JoinHandle;
+use std::time::{Duration, Instant};
+
+/// State shared between the wrapper and the thread that saves the preferences.
+struct State<P> {
+    preferences: P,
+    /// The instant when the scheduled save will be performed, [None] if there isn't a pending
+    /// save.
+    deadline: Option<Instant>,
+    /// The error of the last save performed from the background thread.
+    error: Option<PreferencesError>,
+    stop: bool,
+}
+
+struct Shared<P> {
+    state: Mutex<State<P>>,
+    condvar: Condvar,
+    /// Held for the whole save, so the writes reach the device storage in the same order their
+    /// data were serialized. Must be locked before `state`.
+    write_lock: Mutex<()>,
+}
+
+/// Wrapper of a [Preferences] whose [save](Preferences::save) schedules a single write to the
+/// device storage after a time window instead of writing immediately.
+///
+/// The pending save is performed when the wrapper is dropped, use [flush](Self::flush) to
+/// write the preferences immediately and get the result of the write.
+pub struct DebouncedPreferences<P: Preferences + Send + 'static> {
+    shared: Arc<Shared<P>>,
+    window: Duration,
+    worker: Option<JoinHandle<()>>,
+}
+
+impl<P: Preferences + Send + 'static> DebouncedPreferences<P> {
+    /// Creates a wrapper that coalesces the saves of `preferences` requested within `window`.
+    ///
+    /// * `preferences` - The preferences to save.
+    /// * `window` - The time waited after a save request before writing to the device storage.
+    pub fn new(preferences: P, window: Duration) -> DebouncedPreferences<P> {
+        let shared = Arc::new(Shared {
+            state: Mutex::new(State {
+                preferences,
+                deadline: None,
+                error: None,
+                stop: false,
+            }),
+            condvar: Condvar::new(),
+            write_lock: Mutex::new(()),
+        });
+
+        let worker_shared = shared.clone();
+        let worker = std::thread::Builder::new()
+            .name("crw-preferences-save".to_owned())
+            .spawn(move || save_loop(&worker_shared))
+            .expect("unable to spawn the preferences save thread");
+
+        DebouncedPreferences {
+            shared,
+            window,
+            worker: Some(worker),
+        }
+    }
+
+    fn state(&self) -> MutexGuard<State<P>> {
+        self.shared.state.lock().unwrap()
+    }
+
+    /// Writes the preferences to the device storage immediately, cancelling the pending save.
+    ///
+    /// # Errors
+    /// Returns the error of the write or, if a previous background save failed, its error.
+    pub fn flush(&self) -> Result<()> {
+        let result = write(&self.shared, false);
+
+        match self.state().error.take() {
+            Some(e) if result.is_ok() => Err(e),
+            _ => result,
+        }
+    }
+}
+
+/// Saves the preferences cancelling the pending save, the write to the device storage is
+/// performed after releasing the state if the preferences can be serialized in advance.
+///
+/// * `scheduled` - If true the save is skipped when there isn't a pending save anymore.
+fn write<P: Preferences>(shared: &Shared<P>, scheduled: bool) -> Result<()> {
+    let _write = shared.write_lock.lock().unwrap();
+    let mut state = shared.state.lock().unwrap();
+    if scheduled && state.deadline.is_none() {
+        // Already performed from a flush or cancelled from an erase.
+        return Ok(());
+    }
+
+    state.deadline = None;
+    let prepared = state.preferences.prepare_save();
+    match prepared {
+        Some(Ok(pending)) => {
+            drop(state);
+            pending()
+        }
+        Some(Err(e)) => Err(e),
+        None => state.preferences.save(),
+    }
+}
+
+/// Body of the thread that performs the scheduled saves.
+fn save_loop<P: Preferences>(shared: &Shared<P>) {
+    let mut state = shared.state.lock().unwrap();
+    loop {
+        match state.deadline {
+            Some(deadline) if state.stop || Instant::now() >= deadline => {
+                // The state is released to respect the lock order of write.
+                drop(state);
+                let result = write(shared, true);
+                state = shared.state.lock().unwrap();
+                if let Err(e) = result {
+                    state.error = Some(e);
+                }
+            }
+            _ if state.stop => return,
+            Some(deadline) => {
+                let timeout = deadline.saturating_duration_since(Instant::now());
+                state = shared.condvar.wait_timeout(state, timeout).unwrap().0;
+            }
+            None => state = shared.condvar.wait(state).unwrap(),
+        }
+    }
+}
+
+impl<P: Preferences + Send + 'static> Preferences for DebouncedPreferences<P> {
+    fn get_i32(&self, key: &str) -> Option<i32> {
+        self.state().preferences.get_i32(key)
+    }
+
+    fn put_i32(&mut self, key: &str, value: i32) -> Result<()> {
+        self.state().preferences.put_i32(key, value)
+    }
+
+    fn get_str(&self, key: &str) -> Option<String> {
+        self.state().preferences.get_str(key)
+    }
+
+    fn put_str(&mut self, key: &str, value: String) -> Result<()> {
+        self.state().preferences.put_str(key, value)
+    }
+
+    fn get_bool(&self, key: &str) -> Option<bool> {
+        self.state().preferences.get_bool(key)
+    }
+
+    fn put_bool(&mut self, key: &str, value: bool) -> Result<()> {
+        self.state().preferences.put_bool(key, value)
+    }
+
+    fn get_bytes(&self, key: &str) -> Option<Vec<u8>> {
+        self.state().preferences.get_bytes(key)
+    }
+
+    fn put_bytes(&mut self, key: &str, value: Vec<u8>) -> Result<()> {
+        self.state().preferences.put_bytes(key, value)
+    }
+
+    fn clear(&mut self) {
+        self.state().preferences.clear()
+    }
+
+    fn erase(&mut self) {
+        // Waits the write in progress, so that it can't restore the erased preferences.
+        let _write = self.shared.write_lock.lock().unwrap();
+        let mut state = self.state();
+        // The erased preferences must not be wrote again from a pending save.
+        state.deadline = None;
+        state.preferences.erase()
+    }
+
+    /// Schedules the save of the preferences, the saves requested before the scheduled one is
+    /// performed are coalesced into it.
+    ///
+    /// # Errors
+    /// Returns the error of the last failed background save, if any.
+    fn save(&self) -> Result<()> {
+        let mut state = self.state();
+        if state.deadline.is_none() {
+            state.deadline = Some(Instant::now() + self.window);
+            self.shared.condvar.notify_one();
+        }
+
+        match state.error.take() {
+            Some(e) => Err(e),
+            None => Ok(()),
+        }
+    }
+}
+
+impl<P: Preferences + Send + 'static> Drop for DebouncedPreferences<P> {
+    fn drop(&mut self) {
+        self.state().stop = true;
+        self.shared.condvar.notify_one();
+        if let Some(worker) = self.worker.take() {
+            let _ = worker.join();
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use crate::debounced::DebouncedPreferences;
+    use crate::preferences::{PendingSave, Preferences, Result};
+    use crate::unencrypted::UnencryptedPreferences;
+    use std::sync::atomic::{AtomicUsize, Ordering};
+    use std::sync::mpsc::{channel, Receiver, Sender};
+    use std::sync::{Arc, Mutex};
+    use std::time::Duration;
+
+    /// Preferences that only count the saves.
+    struct CountingPreferences {
+        value: i32,
+        saves: Arc<AtomicUsize>,
+        /// If set the saves are prepared, their write notifies the first channel and waits
+        /// the second one.
+        gate: Option<(Sender<()>, Arc<Mutex<Receiver<()>>>)>,
+    }
+
+    impl Preferences for CountingPreferences {
+        fn get_i32(&self, _key: &str) -> Option<i32> {
+            Some(self.value)
+        }
+
+        fn put_i32(&mut self, _key: &str, value: i32) -> Result<()> {
+            self.value = value;
+            Ok(())
+        }
+
+        fn get_str(&self, _key: &str) -> Option<String> {
+            None
+        }
+
+        fn put_str(&mut self, _key: &str, _value: String) -> Result<()> {
+            Ok(())
+        }
+
+        fn get_bool(&self, _key: &str) -> Option<bool> {
+            None
+        }
+
+        fn put_bool(&mut self, _key: &str, _value: bool) -> Result<()> {
+            Ok(())
+        }
+
+        fn get_bytes(&self, _key: &str) -> Option<Vec<u8>> {
+            None
+        }
+
+        fn put_bytes(&mut self, _key: &str, _value: Vec<u8>) -> Result<()> {
+            Ok(())
+        }
+
+        fn clear(&mut self) {}
+
+        fn erase(&mut self) {}
+
+        fn save(&self) -> Result<()> {
+            self.saves.fetch_add(1, Ordering::SeqCst);
+            Ok(())
+        }
+
+        fn prepare_save(&self) -> Option<Result<PendingSave>> {
+            let (started, release) = self.gate.clone()?;
+            let saves = self.saves.clone();
+            Some(Ok(Box::new(move || {
+                started.send(()).unwrap();
+                release.lock().unwrap().recv().unwrap();
+                saves.fetch_add(1, Ordering::SeqCst);
+                Ok(())
+            })))
+        }
+    }
+
+    fn counting(window: Duration) -> (DebouncedPreferences<CountingPreferences>, Arc<AtomicUsize>) {
+        let saves = Arc::new(AtomicUsize::new(0));
+        let preferences = CountingPreferences {
+            value: 0,
+            saves: saves.clone(),
+            gate: None,
+        };
+        (DebouncedPreferences::new(preferences, window), saves)
+    }
+
+    #[test]
+    pub fn test_saves_coalesced() {
+        let (mut preferences, saves) = counting(Duration::from_millis(100));
+
+        for i in 0..100 {
+            preferences.put_i32("i32", i).unwrap();
+            preferences.save().unwrap();
+        }
+        assert_eq!(0, saves.load(Ordering::SeqCst));
+        assert_eq!(Some(99), preferences.get_i32("i32"));
+
+        std::thread::sleep(Duration::from_millis(300));
+        assert_eq!(1, saves.load(Ordering::SeqCst));
+    }
+
+    #[test]
+    pub fn test_flush_and_drop() {
+        let (preferences, saves) = counting(Duration::from_secs(60));
+
+        preferences.flush().unwrap();
+        assert_eq!(1, saves.load(Ordering::SeqCst));
+
+        // The pending save is performed on drop
+        preferences.save().unwrap();
+        drop(preferences);
+        assert_eq!(2, saves.load(Ordering::SeqCst));
+
+        // Without a pending save nothing is wrote on drop
+        let (preferences, saves) = counting(Duration::from_secs(60));
+        drop(preferences);
+        assert_eq!(0, saves.load(Ordering::SeqCst));
+    }
+
+    #[test]
+    pub fn test_reads_during_write() {
+        let (started_sender, started) = channel();
+        let (release, release_receiver) = channel();
+        let saves = Arc::new(AtomicUsize::new(0));
+        let preferences = CountingPreferences {
+            value: 42,
+            saves: saves.clone(),
+            gate: Some((started_sender, Arc::new(Mutex::new(release_receiver)))),
+        };
+        let mut preferences = DebouncedPreferences::new(preferences, Duration::from_millis(0));
+
+        preferences.save().unwrap();
+        started.recv_timeout(Duration::from_secs(5)).unwrap();
+
+        // The background write is blocked, the values must be still accessible
+        assert_eq!(Some(42), preferences.get_i32("i32"));
+        preferences.put_i32("i32", 43).unwrap();
+        assert_eq!(0, saves.load(Ordering::SeqCst));
+
+        release.send(()).unwrap();
+        drop(preferences);
+        assert_eq!(1, saves.load(Ordering::SeqCst));
+    }
+
+    #[test]
+    pub fn test_debounced_save_to_disk() {
+        let set_name = "debounced-save";
+        let preferences = UnencryptedPreferences::new(set_name).unwrap();
+        let mut preferences = DebouncedPreferences::new(preferences, Duration::from_secs(60));
+        preferences.put_str("str", "str".to_owned()).unwrap();
+        preferences.save().unwrap();
+        drop(preferences);
+
+        let mut preferences = UnencryptedPreferences::new(set_name).unwrap();
+        let str_result = preferences.get_str("str");
+        preferences.erase();
+        assert_eq!("str", str_result.unwrap());
+    }
+}
@@ -1,13 +1,17 @@
 //! Module that provides an implementation of [Preferences] that saves the values encrypted into
 //! the device storage.  
 //! The data are securely stored into the device storage using the Chacha20Poly1305 algorithm.
+//! The encryption key is derived from the password only once, when the preferences set is
+//! loaded, so saving the preferences don't repeat the expensive key derivation.
 
+use crate::cipher::{CipherError, PreferencesCipher};
 use crate::io;
 use crate::io::IoError;
-use crate::preferences::{Preferences, PreferencesError, Result};
+use crate::preferences::{PendingSave, Preferences, PreferencesError, Result};
+use crate::value::Value;
 use base64::DecodeError;
 use cocoon::{Cocoon, Error as CocoonErr};
-use serde::{Deserialize, Serialize};
+use std::borrow::Cow;
 use std::collections::HashMap;
 use std::result::Result as StdResult;
 use thiserror::Error;
@@ -21,17 +25,9 @@ pub enum EncryptedPreferencesError {
     Preferences(Box<PreferencesError>),
 }
 
-#[derive(Serialize, Deserialize, Debug)]
-enum Value {
-    I32(i32),
-    Bool(bool),
-    String(String),
-    Bin(Vec<u8>),
-}
-
 pub struct EncryptedPreferences {
     name: String,
-    password: String,
+    cipher: PreferencesCipher,
     data: HashMap<String, Value>,
 }
 
@@ -52,35 +48,59 @@ impl EncryptedPreferences {
     fn load_from_disk(
         password: &str,
         name: &str,
-    ) -> StdResult<HashMap<String, Value>, EncryptedPreferencesError> {
-        let read_result = io::load(name);
+    ) -> StdResult<(PreferencesCipher, HashMap<String, Value>), EncryptedPreferencesError> {
+        let read_result = io::load_bytes(name);
 
         if read_result.is_err() {
             let err = read_result.err().unwrap();
             return match err {
-                IoError::EmptyData => Ok(HashMap::new()),
+                IoError::EmptyData => Ok((PreferencesCipher::new(password)?, HashMap::new())),
                 IoError::InvalidName(s) => Err(EncryptedPreferencesError::from(
                     PreferencesError::InvalidName(s),
                 )),
                 _ => Err(EncryptedPreferencesError::from(PreferencesError::IO(err))),
             };
         }
-        let base64_data = read_result.unwrap();
+        EncryptedPreferences::decode(password, read_result.unwrap())
+    }
 
-        // Get the data as binary
-        let encrypted = base64::decode(base64_data)
-            .map_err(|_| EncryptedPreferencesError::from(PreferencesError::DeserializationError))?;
+    /// Decrypts and deserializes the stored preferences.
+    ///
+    /// # Errors
+    /// This function can return the following errors:
+    /// * [EncryptedPreferencesError::DecryptionFailed] if the provided password is not valid or the
+    /// data is corrupted.
+    /// * [PreferencesError::DeserializationError] if the data is not valid.
+    fn decode(
+        password: &str,
+        mut encrypted: Vec<u8>,
+    ) -> StdResult<(PreferencesCipher, HashMap<String, Value>), EncryptedPreferencesError> {
+        // The data saved from the previous versions are encoded as base64
+        if !PreferencesCipher::is_encrypted(&encrypted) {
+            if let Ok(decoded) = base64::decode(&encrypted) {
+                encrypted = decoded;
+            }
+        }
 
         // Decrypt the binary data
-        let cocoon = Cocoon::new(password.as_bytes());
-        let decrypted = cocoon.unwrap(&encrypted).map_err(|e| match e {
-            CocoonErr::Cryptography => EncryptedPreferencesError::DecryptionFailed,
-            _ => EncryptedPreferencesError::from(PreferencesError::DeserializationError),
-        })?;
+        let (cipher, decrypted) = if PreferencesCipher::is_encrypted(&encrypted) {
+            PreferencesCipher::open_with_password(password, &encrypted)?
+        } else {
+            // Data saved from a previous version, from the next save they will be encrypted
+            // with the derived key.
+            let cocoon = Cocoon::new(password.as_bytes());
+            let decrypted = cocoon.unwrap(&encrypted).map_err(|e| match e {
+                CocoonErr::Cryptography => EncryptedPreferencesError::DecryptionFailed,
+                _ => EncryptedPreferencesError::from(PreferencesError::DeserializationError),
+            })?;
+            (PreferencesCipher::new(password)?, decrypted)
+        };
 
         // Deserialize the values
-        bincode::deserialize::<HashMap<String, Value>>(&decrypted)
-            .map_err(|_| EncryptedPreferencesError::from(PreferencesError::DeserializationError))
+        let data = bincode::deserialize::<HashMap<String, Value>>(&decrypted)
+            .map_err(|_| EncryptedPreferencesError::from(PreferencesError::DeserializationError))?;
+
+        Ok((cipher, data))
     }
 
     /// Creates a new encrypted preferences set with the provided `name`.
@@ -100,12 +120,58 @@ impl EncryptedPreferences {
         password: &str,
         name: &str,
     ) -> StdResult<EncryptedPreferences, EncryptedPreferencesError> {
+        let (cipher, data) = EncryptedPreferences::load_from_disk(password, name)?;
+
         Ok(EncryptedPreferences {
             name: name.to_owned(),
-            password: password.to_owned(),
-            data: EncryptedPreferences::load_from_disk(password, name)?,
+            cipher,
+            data,
         })
     }
+
+    /// Creates an encrypted preferences set from the data loaded from a storage other than the
+    /// default one.
+    ///
+    /// * `password` - the password used decrypt the preferences set.
+    /// * `name` - the preferences set name.
+    /// * `data` - the stored encrypted data, [None] if the preferences set don't exist yet.
+    ///
+    /// # Errors
+    /// This function can return the following errors:
+    /// * [EncryptedPreferencesError::DecryptionFailed] if the provided password is not valid or the
+    /// data is corrupted.
+    /// * [PreferencesError::DeserializationError] if the data is not valid.
+    #[cfg_attr(not(all(target_arch = "wasm32", feature = "js")), allow(dead_code))]
+    pub(crate) fn from_bytes(
+        password: &str,
+        name: &str,
+        data: Option<Vec<u8>>,
+    ) -> StdResult<EncryptedPreferences, EncryptedPreferencesError> {
+        let (cipher, data) = match data {
+            Some(data) => EncryptedPreferences::decode(password, data)?,
+            None => (PreferencesCipher::new(password)?, HashMap::new()),
+        };
+
+        Ok(EncryptedPreferences {
+            name: name.to_owned(),
+            cipher,
+            data,
+        })
+    }
+
+    /// Serializes and encrypts the preferences set.
+    ///
+    /// # Errors
+    /// This function returns [PreferencesError::SerializationError] if the data can't be
+    /// serialized or encrypted.
+    pub(crate) fn to_bytes(&self) -> Result<Vec<u8>> {
+        let serialized =
+            bincode::serialize(&self.data).map_err(|_| PreferencesError::SerializationError)?;
+
+        self.cipher
+            .encrypt(&serialized)
+            .map_err(|_| PreferencesError::SerializationError)
+    }
 }
 
 impl Preferences for EncryptedPreferences {
@@ -128,6 +194,13 @@ impl Preferences for EncryptedPreferences {
         })
     }
 
+    fn get_str_ref(&self, key: &str) -> Option<Cow<str>> {
+        self.data.get(key).and_then(|v| match v {
+            Value::String(string) => Some(Cow::Borrowed(string.as_str())),
+            _ => None,
+        })
+    }
+
     fn put_str(&mut self, key: &str, value: String) -> Result<()> {
         self.data.insert(key.to_owned(), Value::String(value));
         Ok(())
@@ -152,6 +225,13 @@ impl Preferences for EncryptedPreferences {
         })
     }
 
+    fn get_bytes_ref(&self, key: &str) -> Option<Cow<[u8]>> {
+        self.data.get(key).and_then(|v| match v {
+            Value::Bin(bin) => Some(Cow::Borrowed(bin.as_slice())),
+            _ => None,
+        })
+    }
+
     fn put_bytes(&mut self, key: &str, value: Vec<u8>) -> Result<()> {
         self.data.insert(key.to_owned(), Value::Bin(value));
         Ok(())
@@ -167,18 +247,22 @@ impl Preferences for EncryptedPreferences {
     }
 
     fn save(&self) -> Result<()> {
-        let serialized =
-            bincode::serialize(&self.data).map_err(|_| PreferencesError::SerializationError)?;
-
-        let storage = Cocoon::new(self.password.as_ref());
-        let encrypted = storage
-            .wrap(&serialized)
-            .map(base64::encode)
-            .map_err(|_| PreferencesError::SerializationError)?;
-
-        io::save(&self.name, &encrypted)?;
+        io::save_bytes(&self.name, &self.to_bytes()?)?;
         Ok(())
     }
+
+    fn prepare_save(&self) -> Option<Result<PendingSave>> {
+        let name = self.name.clone();
+        let data = match self.to_bytes() {
+            Ok(data) => data,
+            Err(e) => return Some(Err(e)),
+        };
+
+        Some(Ok(Box::new(move || {
+            io::save_bytes(&name, &data)?;
+            Ok(())
+        })))
+    }
 }
 
 impl From<DecodeError> for PreferencesError {
@@ -187,6 +271,18 @@ impl From<DecodeError> for PreferencesError {
     }
 }
 
+impl From<CipherError> for EncryptedPreferencesError {
+    fn from(e: CipherError) -> Self {
+        match e {
+            CipherError::DecryptionFailed => EncryptedPreferencesError::DecryptionFailed,
+            CipherError::Malformed => {
+                EncryptedPreferencesError::from(PreferencesError::DeserializationError)
+            }
+            _ => EncryptedPreferencesError::from(PreferencesError::SerializationError),
+        }
+    }
+}
+
 impl From<PreferencesError> for EncryptedPreferencesError {
     fn from(e: PreferencesError) -> Self {
         EncryptedPreferencesError::Preferences(Box::new(e))
@@ -195,9 +291,14 @@ impl From<PreferencesError> for EncryptedPreferencesError {
 
 #[cfg(test)]
 mod test {
-    use crate::encrypted::EncryptedPreferences;
+    use crate::encrypted::{EncryptedPreferences, EncryptedPreferencesError};
+    use crate::io;
     use crate::preferences;
     use crate::preferences::Preferences;
+    use crate::value::Value;
+    use cocoon::Cocoon;
+    use std::borrow::Cow;
+    use std::collections::HashMap;
 
     #[test]
     pub fn test_creation() {
@@ -257,6 +358,77 @@ mod test {
         assert_eq!(test_vec, binary_result.unwrap());
     }
 
+    #[test]
+    pub fn test_borrowed_getters() {
+        let mut preferences = EncryptedPreferences::new("password", "encrypted-borrowed").unwrap();
+        preferences.put_str("str", "str".to_owned()).unwrap();
+        preferences.put_bytes("bin", vec![1, 2, 3]).unwrap();
+
+        assert!(matches!(
+            preferences.get_str_ref("str"),
+            Some(Cow::Borrowed("str"))
+        ));
+        assert!(matches!(
+            preferences.get_bytes_ref("bin"),
+            Some(Cow::Borrowed([1, 2, 3]))
+        ));
+        assert_eq!(None, preferences.get_bytes_ref("str"));
+        preferences.erase();
+    }
+
+    #[test]
+    pub fn test_wrong_password() {
+        let set_name = "encrypted-wrong-password";
+
+        let mut p = EncryptedPreferences::new("password", set_name).unwrap();
+        p.put_i32("i32", 42).unwrap();
+        p.save().unwrap();
+
+        let result = EncryptedPreferences::new("wrong", set_name);
+        p.erase();
+        assert!(matches!(
+            result.err().unwrap(),
+            EncryptedPreferencesError::DecryptionFailed
+        ));
+    }
+
+    #[test]
+    pub fn test_legacy_cocoon_data() {
+        let set_name = "encrypted-legacy";
+        let password = "password";
+
+        // Data saved with the previous cocoon based format
+        let mut data = HashMap::new();
+        data.insert("i32".to_owned(), Value::I32(42));
+        let serialized = bincode::serialize(&data).unwrap();
+        let wrapped = Cocoon::new(password.as_bytes()).wrap(&serialized).unwrap();
+        io::save(set_name, &base64::encode(wrapped)).unwrap();
+
+        let preferences = EncryptedPreferences::new(password, set_name).unwrap();
+        assert_eq!(Some(42), preferences.get_i32("i32"));
+
+        // After a save the data are migrated to the new format
+        preferences.save().unwrap();
+        let mut preferences = EncryptedPreferences::new(password, set_name).unwrap();
+        let result = preferences.get_i32("i32");
+        preferences.erase();
+        assert_eq!(Some(42), result);
+    }
+
+    #[test]
+    pub fn test_binary_format() {
+        let set_name = "encrypted-binary";
+
+        let mut p = EncryptedPreferences::new("password", set_name).unwrap();
+        p.put_bytes("bin", vec![0; 64]).unwrap();
+        p.save().unwrap();
+
+        // The data are stored as raw binary, not base64 encoded
+        let stored = io::load_bytes(set_name).unwrap();
+        p.erase();
+        assert!(stored.starts_with(b"CRWP"));
+    }
+
     #[test]
     pub fn test_exist() {
         let set_name = "encrypted-exist";
@@ -1,14 +1,23 @@
 //! Module that provides the FFI to access the preferences from other programming languages.
 
 use crate::encrypted::EncryptedPreferences;
+use crate::journal::JournalPreferences;
+use crate::lazy::LazyPreferences;
 use crate::preferences;
 use crate::preferences::Preferences;
+use crate::shared::SharedPreferences;
 use crate::unencrypted::UnencryptedPreferences;
 use ffi_helpers;
 use libc::{c_char, c_int, c_uchar, c_void};
+use std::borrow::Cow;
+use std::convert::TryFrom;
 use std::ptr::null_mut;
 use std::slice;
 
+// The latency metrics of this library are exported together with its FFI, see crw_metrics.h.
+#[cfg(feature = "metrics")]
+pub use crw_metrics::ffi::{crw_metrics_reset, crw_metrics_snapshot, crw_metrics_string_free};
+
 // Macro to export the ffi_helpers's functions used to access the error message from other programming languages.
 export_error_handling_functions!();
 
@@ -69,15 +78,21 @@ fn unwrap_ptr_mut(ptr: *mut c_void) -> *mut Box<dyn Preferences> {
 /// be created inside the current user app configurations directory.
 /// On Android instead since is not possible to obtain the `appData` directory at runtime
 /// `dir` must be an absolute path to a directory where the application can read and write.
+/// The directory is resolved only once, so this function must be called before accessing any
+/// preferences and can't change the directory already set.
 ///
 /// Returns 0 on success or -1 on error.
 #[no_mangle]
 pub extern "C" fn set_preferences_app_dir(dir: *const c_char) -> c_int {
     let path = check_str!(dir, -1);
 
-    crate::preferences::set_preferences_app_dir(path);
-
-    0
+    match crate::preferences::set_preferences_app_dir(path) {
+        Ok(_) => 0,
+        Err(e) => {
+            ffi_helpers::update_last_error(e);
+            -1
+        }
+    }
 }
 
 /// Check if exist a preference with the provided `name`.
@@ -139,6 +154,119 @@ pub extern "C" fn encrypted_preferences(
     }
 }
 
+/// Creates a new preferences stored into an append-only log with the provided name or load an
+/// already existing one with the provided name.
+///
+/// * `name` - The preferences name, can contains only ascii alphanumeric chars or -, _.
+///
+/// Returns a valid pointer on success or nullptr if an error occurred.
+#[no_mangle]
+pub extern "C" fn journal_preferences(name: *const c_char) -> *mut c_void {
+    let name = check_str!(name, null_mut());
+
+    match JournalPreferences::new(name) {
+        Err(e) => {
+            ffi_helpers::update_last_error(e);
+            null_mut()
+        }
+        Ok(p) => box_to_c_ptr(p),
+    }
+}
+
+/// Creates a new encrypted preferences stored into an append-only log with the provided name
+/// or load an already existing one with the provided name.
+///
+/// * `name` - The preferences name, can contains only ascii alphanumeric chars or -, _.
+/// * `password` - The password used to secure the preferences.
+///
+/// Returns a valid pointer on success or nullptr if an error occurred.
+#[no_mangle]
+pub extern "C" fn encrypted_journal_preferences(
+    name: *const c_char,
+    password: *const c_char,
+) -> *mut c_void {
+    let name = check_str!(name, null_mut());
+    let password = check_str!(password, null_mut());
+
+    match JournalPreferences::new_encrypted(password, name) {
+        Err(e) => {
+            ffi_helpers::update_last_error(e);
+            null_mut()
+        }
+        Ok(p) => box_to_c_ptr(p),
+    }
+}
+
+/// Opens the preferences stored into a not encrypted append-only log with the provided name
+/// building only the index of its keys, the values are loaded from the device storage only
+/// when requested.
+///
+/// * `name` - The preferences name, can contains only ascii alphanumeric chars or -, _.
+///
+/// Returns a valid pointer on success or nullptr if an error occurred.
+#[no_mangle]
+pub extern "C" fn lazy_preferences(name: *const c_char) -> *mut c_void {
+    let name = check_str!(name, null_mut());
+
+    match LazyPreferences::new(name) {
+        Err(e) => {
+            ffi_helpers::update_last_error(e);
+            null_mut()
+        }
+        Ok(p) => box_to_c_ptr(p),
+    }
+}
+
+/// Opens a thread safe handle to the preferences with the provided name, all the handles
+/// opened with the same name share a single in-memory preferences set that is loaded from the
+/// device storage only the first time.
+/// A handle must not be used concurrently from multiple threads, instead each thread should open
+/// its own handle, the accesses to the shared preferences set are synchronized internally.
+/// Fails if the preferences set is already opened with [shared_encrypted_preferences].
+///
+/// * `name` - The preferences name, can contains only ascii alphanumeric chars or -, _.
+///
+/// Returns a valid pointer on success or nullptr if an error occurred.
+#[no_mangle]
+pub extern "C" fn shared_preferences(name: *const c_char) -> *mut c_void {
+    let name = check_str!(name, null_mut());
+
+    match SharedPreferences::open(name, UnencryptedPreferences::new) {
+        Err(e) => {
+            ffi_helpers::update_last_error(e);
+            null_mut()
+        }
+        Ok(p) => box_to_c_ptr(p),
+    }
+}
+
+/// Opens a thread safe handle to the encrypted preferences with the provided name, all the
+/// handles opened with the same name share a single in-memory preferences set that is loaded
+/// from the device storage only the first time.
+/// A handle must not be used concurrently from multiple threads, instead each thread should open
+/// its own handle, the accesses to the shared preferences set are synchronized internally.
+///
+/// * `name` - The preferences name, can contains only ascii alphanumeric chars or -, _.
+/// * `password` - The password used to secure the preferences.
+///
+/// Returns a valid pointer on success or nullptr if an error occurred.
+#[no_mangle]
+pub extern "C" fn shared_encrypted_preferences(
+    name: *const c_char,
+    password: *const c_char,
+) -> *mut c_void {
+    let name = check_str!(name, null_mut());
+    let password = check_str!(password, null_mut());
+
+    match SharedPreferences::open_encrypted(password, name) {
+        Err(e) => {
+            ffi_helpers::update_last_error(e);
+            null_mut()
+        }
+        Ok(p) => box_to_c_ptr(p),
+    }
+}
+
 /// Release all the resources owned by a preferences instance.
 #[no_mangle]
 pub extern "C" fn preferences_free(preferences: *mut c_void) {
@@ -229,7 +357,7 @@ pub extern "C" fn preferences_get_string(
 
     let key = check_str!(key, -1);
     let preferences = unsafe { unwrap_ptr(preferences).as_ref().unwrap() };
-    match preferences.get_str(key) {
+    match preferences.get_str_ref(key) {
         Some(s) => {
             let bytes = s.as_bytes();
             // Use bytes len instead of the string since in UTF-8 strings the length can be
@@ -355,12 +483,12 @@ pub extern "C" fn preferences_get_bytes(
     let key = check_str!(key, -1);
     let preferences = unsafe { unwrap_ptr(preferences).as_ref().unwrap() };
 
-    match preferences.get_bytes(key) {
+    match preferences.get_bytes_ref(key) {
         Some(v) => {
             if v.len() <= buf_len {
-                // The buffer is large enough copy the vec to the dest buffer
+                // The buffer is large enough copy the value to the dest buffer
                 let dest: &mut [u8] = unsafe { slice::from_raw_parts_mut(out_buf, v.len()) };
-                dest.copy_from_slice(v.as_slice());
+                dest.copy_from_slice(&v);
             }
             v.len() as c_int
         }
@@ -454,15 +582,274 @@ pub extern "C" fn preferences_save(preferences: *mut c_void) -> c_int {
     }
 }
 
+/// Type of a value i32 stored into a [PreferenceEntry].
+pub const PREFERENCE_I32: c_int = 0;
+/// Type of a value bool stored into a [PreferenceEntry].
+pub const PREFERENCE_BOOL: c_int = 1;
+/// Type of a value string stored into a [PreferenceEntry].
+pub const PREFERENCE_STRING: c_int = 2;
+/// Type of an array of bytes stored into a [PreferenceEntry].
+pub const PREFERENCE_BYTES: c_int = 3;
+
+/// Descriptor of a value read or wrote with [preferences_get_many] and [preferences_put_many].
+#[repr(C)]
+pub struct PreferenceEntry {
+    /// UTF-8 encoded key, not necessarily null terminated.
+    key: *const c_char,
+    key_len: usize,
+    /// One of [PREFERENCE_I32], [PREFERENCE_BOOL], [PREFERENCE_STRING] or [PREFERENCE_BYTES].
+    value_type: c_int,
+    i32_value: i32,
+    bool_value: bool,
+    /// The string or bytes value, the string is UTF-8 encoded and not null terminated.
+    data: *const c_uchar,
+    data_len: usize,
+    /// Result of the operation on this entry.
+    status: c_int,
+}
+
+impl PreferenceEntry {
+    /// Gets the entry key, returns [None] if the key is not a valid UTF-8 string.
+    fn key(&self) -> Option<&str> {
+        if self.key.is_null() {
+            return None;
+        }
+        let bytes = unsafe { slice::from_raw_parts(self.key as *const u8, self.key_len) };
+        std::str::from_utf8(bytes).ok()
+    }
+
+    /// Gets the entry string or bytes value.
+    fn data(&self) -> Option<&[u8]> {
+        if self.data.is_null() {
+            if self.data_len == 0 {
+                return Some(&[]);
+            }
+            return None;
+        }
+        Some(unsafe { slice::from_raw_parts(self.data, self.data_len) })
+    }
+}
+
+/// Converts the pointer to an array of entries to a slice.
+unsafe fn entries_slice<'a>(
+    entries: *mut PreferenceEntry,
+    count: usize,
+) -> &'a mut [PreferenceEntry] {
+    if count == 0 {
+        &mut []
+    } else {
+        slice::from_raw_parts_mut(entries, count)
+    }
+}
+
+/// Gets multiple values from the preferences with a single call.
+///
+/// * `preferences` - pointer to the preferences from which will be extracted the values.
+/// * `entries` - array of entries whose `key` and `value_type` tell the values to load.
+/// * `count` - length of `entries`.
+/// * `arena` - buffer where are copied the strings and arrays of bytes, the entries `data`
+/// will point inside this buffer.
+/// * `arena_len` - length of `arena`.
+///
+/// The `status` of each entry is set to 0 if the value has been loaded, -1 if the value is not
+/// present into the preferences, -2 if the entry key or type is invalid or -3 if the value
+/// don't fit into `arena`, in this case `data_len` is set to the value length.
+///
+/// Returns the number of bytes of `arena` required to load all the values, if greater than
+/// `arena_len` the call can be repeated with a larger arena, or -1 if one of the provided
+/// arguments is invalid or the required length don't fit into the return type, in this case
+/// the error cause can be obtained using the `error_message_utf8` function.
+#[no_mangle]
+pub extern "C" fn preferences_get_many(
+    preferences: *const c_void,
+    entries: *mut PreferenceEntry,
+    count: usize,
+    arena: *mut c_uchar,
+    arena_len: usize,
+) -> c_int {
+    if preferences.is_null() || (entries.is_null() && count > 0) {
+        return -1;
+    }
+    if arena.is_null() && arena_len > 0 {
+        return -1;
+    }
+
+    let preferences = unsafe { unwrap_ptr(preferences).as_ref().unwrap() };
+    let entries = unsafe { entries_slice(entries, count) };
+    let arena: &mut [u8] = if arena_len == 0 {
+        &mut []
+    } else {
+        unsafe { slice::from_raw_parts_mut(arena, arena_len) }
+    };
+    let mut used = 0usize;
+
+    for entry in entries.iter_mut() {
+        let key = match entry.key() {
+            Some(key) => key,
+            None => {
+                entry.status = -2;
+                continue;
+            }
+        };
+
+        let bytes = match entry.value_type {
+            PREFERENCE_I32 => {
+                entry.status = match preferences.get_i32(key) {
+                    Some(value) => {
+                        entry.i32_value = value;
+                        0
+                    }
+                    None => -1,
+                };
+                continue;
+            }
+            PREFERENCE_BOOL => {
+                entry.status = match preferences.get_bool(key) {
+                    Some(value) => {
+                        entry.bool_value = value;
+                        0
+                    }
+                    None => -1,
+                };
+                continue;
+            }
+            PREFERENCE_STRING => preferences.get_str_ref(key).map(|s| match s {
+                Cow::Borrowed(s) => Cow::Borrowed(s.as_bytes()),
+                Cow::Owned(s) => Cow::Owned(s.into_bytes()),
+            }),
+            PREFERENCE_BYTES => preferences.get_bytes_ref(key),
+            _ => {
+                entry.status = -2;
+                continue;
+            }
+        };
+
+        match bytes {
+            Some(bytes) => {
+                entry.data_len = bytes.len();
+                let end = used.saturating_add(bytes.len());
+                if end <= arena.len() {
+                    arena[used..end].copy_from_slice(&bytes);
+                    entry.data = arena[used..end].as_ptr();
+                    entry.status = 0;
+                } else {
+                    entry.data = std::ptr::null();
+                    entry.status = -3;
+                }
+                used = end;
+            }
+            None => entry.status = -1,
+        }
+    }
+
+    match c_int::try_from(used) {
+        Ok(used) => used,
+        Err(e) => {
+            ffi_helpers::update_last_error(e);
+            -1
+        }
+    }
+}
+
+/// Puts multiple values into the preferences with a single call.
+///
+/// * `preferences` - pointer to the preferences where will be stored the values.
+/// * `entries` - array of entries whose `key`, `value_type` and value tell the values to store.
+/// * `count` - length of `entries`.
+///
+/// The `status` of each entry is set to 0 if the value has been stored, -1 if an error
+/// occurred while storing the value or -2 if the entry is invalid.
+///
+/// Returns 0 if all the values have been stored or -1 on error.
+#[no_mangle]
+pub extern "C" fn preferences_put_many(
+    preferences: *mut c_void,
+    entries: *mut PreferenceEntry,
+    count: usize,
+) -> c_int {
+    if preferences.is_null() || (entries.is_null() && count > 0) {
+        return -1;
+    }
+
+    let preferences = unsafe { unwrap_ptr_mut(preferences).as_mut().unwrap() };
+    let entries = unsafe { entries_slice(entries, count) };
+    let mut rc = 0;
+
+    for entry in entries.iter_mut() {
+        let key = match entry.key() {
+            Some(key) => key,
+            None => {
+                entry.status = -2;
+                rc = -1;
+                continue;
+            }
+        };
+
+        let result = match (entry.value_type, entry.data()) {
+            (PREFERENCE_I32, _) => preferences.put_i32(key, entry.i32_value),
+            (PREFERENCE_BOOL, _) => preferences.put_bool(key, entry.bool_value),
+            (PREFERENCE_STRING, Some(data)) => match std::str::from_utf8(data) {
+                Ok(value) => preferences.put_str(key, value.to_owned()),
+                Err(e) => {
+                    ffi_helpers::update_last_error(e);
+                    entry.status = -2;
+                    rc = -1;
+                    continue;
+                }
+            },
+            (PREFERENCE_BYTES, Some(data)) => preferences.put_bytes(key, data.to_vec()),
+            _ => {
+                entry.status = -2;
+                rc = -1;
+                continue;
+            }
+        };
+
+        entry.status = match result {
+            Ok(_) => 0,
+            Err(e) => {
+                ffi_helpers::update_last_error(e);
+                rc = -1;
+                -1
+            }
+        };
+    }
+
+    rc
+}
+
 #[cfg(test)]
 mod tests {
     use crate::ffi::{
-        encrypted_preferences, preferences, preferences_erase, preferences_free,
-        preferences_get_bool, preferences_get_bytes, preferences_get_i32, preferences_get_string,
-        preferences_put_bool, preferences_put_bytes, preferences_put_i32, preferences_put_string,
-        preferences_save,
+        encrypted_journal_preferences, encrypted_preferences, journal_preferences,
+        lazy_preferences, preferences, preferences_erase, preferences_free, preferences_get_bool,
+        preferences_get_bytes, preferences_get_i32, preferences_get_string, preferences_put_bool,
+        preferences_put_bytes, preferences_put_i32, preferences_put_string, preferences_save,
+        shared_preferences,
+    };
+    use crate::ffi::{
+        preferences_get_many, preferences_put_many, PreferenceEntry, PREFERENCE_BOOL,
+        PREFERENCE_BYTES, PREFERENCE_I32, PREFERENCE_STRING,
     };
     use std::ffi::CString;
+    use std::ptr::null;
+
+    fn entry(key: &'static str, value_type: i32, data: &[u8]) -> PreferenceEntry {
+        PreferenceEntry {
+            key: key.as_ptr() as *const _,
+            key_len: key.len(),
+            value_type,
+            i32_value: 42,
+            bool_value: true,
+            data: if data.is_empty() {
+                null()
+            } else {
+                data.as_ptr()
+            },
+            data_len: data.len(),
+            status: 1,
+        }
+    }
 
     #[test]
     fn test_preferences_creation() {
@@ -488,6 +875,72 @@ mod tests {
         preferences_free(raw_preferences);
     }
 
+    #[test]
+    fn test_journal_preferences_creation() {
+        let preferences_name = CString::new("ffi-journal").unwrap();
+        let preferences_password = CString::new("password").unwrap();
+
+        let raw_preferences = journal_preferences(preferences_name.as_ptr());
+        assert!(!raw_preferences.is_null());
+        let i32_key = CString::new("i32").unwrap();
+        assert_eq!(
+            0,
+            preferences_put_i32(raw_preferences, i32_key.as_ptr(), 42)
+        );
+        assert_eq!(0, preferences_save(raw_preferences));
+        preferences_erase(raw_preferences);
+        preferences_free(raw_preferences);
+
+        let raw_preferences =
+            encrypted_journal_preferences(preferences_name.as_ptr(), preferences_password.as_ptr());
+        assert!(!raw_preferences.is_null());
+        preferences_erase(raw_preferences);
+        preferences_free(raw_preferences);
+    }
+
+    #[test]
+    fn test_lazy_preferences_creation() {
+        let preferences_name = CString::new("ffi-lazy").unwrap();
+
+        let raw_preferences = lazy_preferences(preferences_name.as_ptr());
+        assert!(!raw_preferences.is_null());
+        let i32_key = CString::new("i32").unwrap();
+        assert_eq!(
+            0,
+            preferences_put_i32(raw_preferences, i32_key.as_ptr(), 42)
+        );
+        assert_eq!(0, preferences_save(raw_preferences));
+        preferences_free(raw_preferences);
+
+        let raw_preferences = lazy_preferences(preferences_name.as_ptr());
+        let mut read_val = 0;
+        let read_rc = preferences_get_i32(raw_preferences, i32_key.as_ptr(), &mut read_val);
+        preferences_erase(raw_preferences);
+        preferences_free(raw_preferences);
+        assert_eq!(0, read_rc);
+        assert_eq!(42, read_val);
+    }
+
+    #[test]
+    fn test_shared_preferences() {
+        let preferences_name = CString::new("ffi-shared").unwrap();
+        let first = shared_preferences(preferences_name.as_ptr());
+        let second = shared_preferences(preferences_name.as_ptr());
+        assert!(!first.is_null());
+        assert!(!second.is_null());
+
+        let i32_key = CString::new("i32").unwrap();
+        assert_eq!(0, preferences_put_i32(first, i32_key.as_ptr(), 42));
+        let mut read_val = 0;
+        let read_rc = preferences_get_i32(second, i32_key.as_ptr(), &mut read_val);
+
+        preferences_erase(first);
+        preferences_free(first);
+        preferences_free(second);
+        assert_eq!(0, read_rc);
+        assert_eq!(42, read_val);
+    }
+
     #[test]
     fn test_put_i32() {
         let preferences_name = CString::new("ffi").unwrap();
@@ -595,4 +1048,68 @@ mod tests {
 
         preferences_free(raw_preferences);
     }
+
+    #[test]
+    fn test_get_put_many() {
+        let preferences_name = CString::new("ffi-many").unwrap();
+        let raw_preferences = preferences(preferences_name.as_ptr());
+        assert!(!raw_preferences.is_null());
+
+        let bin = [1u8, 2, 3, 4];
+        let mut entries = [
+            entry("i32", PREFERENCE_I32, &[]),
+            entry("bool", PREFERENCE_BOOL, &[]),
+            entry("str", PREFERENCE_STRING, b"value"),
+            entry("bin", PREFERENCE_BYTES, &bin),
+            entry("invalid", 42, &[]),
+        ];
+        let rc = preferences_put_many(raw_preferences, entries.as_mut_ptr(), entries.len());
+        assert_eq!(-1, rc);
+        let statuses: Vec<i32> = entries.iter().map(|e| e.status).collect();
+        assert_eq!(vec![0, 0, 0, 0, -2], statuses);
+
+        let mut entries = [
+            entry("i32", PREFERENCE_I32, &[]),
+            entry("bool", PREFERENCE_BOOL, &[]),
+            entry("str", PREFERENCE_STRING, &[]),
+            entry("bin", PREFERENCE_BYTES, &[]),
+            entry("missing", PREFERENCE_I32, &[]),
+        ];
+        entries[0].i32_value = 0;
+        entries[1].bool_value = false;
+
+        // Arena too small for the bytes value
+        let mut arena = [0u8; 6];
+        let rc = preferences_get_many(
+            raw_preferences,
+            entries.as_mut_ptr(),
+            entries.len(),
+            arena.as_mut_ptr(),
+            arena.len(),
+        );
+        assert_eq!(9, rc);
+        assert_eq!(-3, entries[3].status);
+        assert_eq!(4, entries[3].data_len);
+
+        let mut arena = [0u8; 9];
+        let rc = preferences_get_many(
+            raw_preferences,
+            entries.as_mut_ptr(),
+            entries.len(),
+            arena.as_mut_ptr(),
+            arena.len(),
+        );
+        preferences_erase(raw_preferences);
+        preferences_free(raw_preferences);
+
+        assert_eq!(9, rc);
+        let statuses: Vec<i32> = entries.iter().map(|e| e.status).collect();
+        assert_eq!(vec![0, 0, 0, 0, -1], statuses);
+        assert_eq!(42, entries[0].i32_value);
+        assert_eq!(true, entries[1].bool_value);
+        let str = unsafe { std::slice::from_raw_parts(entries[2].data, entries[2].data_len) };
+        assert_eq!(b"value", str);
+        let bytes = unsafe { std::slice::from_raw_parts(entries[3].data, entries[3].data_len) };
+        assert_eq!(bin, bytes);
+    }
 }
@@ -0,0 +1,253 @@
+//! Module that provides the functions to asynchronously read and write the preferences from the
+//! browser `IndexedDB`.
+//!
+//! Unlike the `LocalStorage` the `IndexedDB` can store the binary data as they are, so the
+//! preferences sets are stored as `Uint8Array` without encoding them as base64, and it's not
+//! limited to few megabytes.
+//! All the preferences sets are stored inside a single object store using their name as key.
+
+use crate::io::{is_name_valid, IoError, Result};
+use bindgen::closure::Closure;
+use bindgen::{JsCast, JsValue};
+use js_sys::{Function, Promise, Uint8Array};
+use std::cell::RefCell;
+use wasm_bindgen_futures::JsFuture;
+use web_sys::{
+    IdbDatabase, IdbFactory, IdbObjectStore, IdbRequest, IdbTransaction, IdbTransactionMode,
+    Window, WorkerGlobalScope,
+};
+
+/// Name of the database that contains the preferences.
+const DB_NAME: &str = "crw-preferences";
+/// Version of the database schema.
+const DB_VERSION: u32 = 1;
+/// Name of the object store where are stored the preferences sets.
+const STORE_NAME: &str = "preferences";
+
+thread_local! {
+    /// Connection to the database, opened at the first access.
+    static DATABASE: RefCell<Option<IdbDatabase>> = RefCell::new(None);
+}
+
+/// Event handler that resolves or rejects a [Promise].
+type Handler = Closure<dyn FnMut(JsValue)>;
+
+/// Creates a promise together with the handlers that resolve and reject it.
+/// Only one of the handlers is called, so both must be kept alive until the promise settles
+/// and then dropped, after being removed from the event target.
+fn handled_promise() -> (Promise, Handler, Handler) {
+    let mut handlers = None;
+    let promise = Promise::new(&mut |resolve: Function, reject: Function| {
+        let onresolve = Closure::once(move |event: JsValue| {
+            let _ = resolve.call1(&JsValue::UNDEFINED, &event);
+        });
+        let onreject = Closure::once(move |event: JsValue| {
+            let _ = reject.call1(&JsValue::UNDEFINED, &event);
+        });
+        handlers = Some((onresolve, onreject));
+    });
+
+    // The promise executor is called synchronously.
+    let (onresolve, onreject) = handlers.unwrap();
+    (promise, onresolve, onreject)
+}
+
+/// Waits that the `request` completes, resolving to its result.
+///
+/// * `request` - the request to wait.
+/// * `error` - the error returned if the request fails.
+async fn wait_request(request: &IdbRequest, error: IoError) -> Result<JsValue> {
+    let (promise, onsuccess, onerror) = handled_promise();
+    request.set_onsuccess(Some(onsuccess.as_ref().unchecked_ref()));
+    request.set_onerror(Some(onerror.as_ref().unchecked_ref()));
+
+    let result = JsFuture::from(promise).await;
+    request.set_onsuccess(None);
+    request.set_onerror(None);
+
+    result.map_err(|_| error)?;
+    request.result().map_err(|_| IoError::Read)
+}
+
+/// Waits that the `transaction` is committed, the data are persisted only after the
+/// transaction is completed.
+async fn wait_transaction(transaction: &IdbTransaction) -> Result<()> {
+    let (promise, oncomplete, onabort) = handled_promise();
+    transaction.set_oncomplete(Some(oncomplete.as_ref().unchecked_ref()));
+    // A failed request aborts the transaction, so the abort covers the errors too.
+    transaction.set_onabort(Some(onabort.as_ref().unchecked_ref()));
+
+    let result = JsFuture::from(promise).await;
+    transaction.set_oncomplete(None);
+    transaction.set_onabort(None);
+
+    result.map(|_| ()).map_err(|_| IoError::Write)
+}
+
+/// Gets the `IndexedDB` factory from the global scope, that is a `Window` in the main thread
+/// or a `WorkerGlobalScope` inside a Web Worker.
+fn get_factory() -> Result<IdbFactory> {
+    let global = js_sys::global();
+    let factory = if let Some(window) = global.dyn_ref::<Window>() {
+        window.indexed_db()
+    } else if let Some(worker) = global.dyn_ref::<WorkerGlobalScope>() {
+        worker.indexed_db()
+    } else {
+        return Err(IoError::Unsupported(
+            "global scope without IndexedDB".to_owned(),
+        ));
+    };
+
+    factory
+        .map_err(|_| IoError::Unsupported("IndexedDB not supported".to_owned()))?
+        .ok_or(IoError::Unsupported("IndexedDB is null".to_owned()))
+}
+
+/// Gets the connection to the preferences database, opening it and creating the object store
+/// if don't exist.
+///
+/// # Errors
+/// This function returns [IoError::Unsupported] if the browser don't support the IndexedDB API
+/// or the database can't be opened.
+async fn get_database() -> Result<IdbDatabase> {
+    if let Some(database) = DATABASE.with(|db| db.borrow().clone()) {
+        return Ok(database);
+    }
+
+    let request = get_factory()?
+        .open_with_u32(DB_NAME, DB_VERSION)
+        .map_err(|_| IoError::Unsupported("IndexedDB can't be opened".to_owned()))?;
+
+    // Creates the object store the first time that the database is opened.
+    let upgrade_request = request.clone();
+    let onupgradeneeded: Handler = Closure::once(move |_: JsValue| {
+        if let Ok(database) = upgrade_request.result() {
+            let database: IdbDatabase = database.unchecked_into();
+            if !database.object_store_names().contains(STORE_NAME) {
+                let _ = database.create_object_store(STORE_NAME);
+            }
+        }
+    });
+    request.set_onupgradeneeded(Some(onupgradeneeded.as_ref().unchecked_ref()));
+
+    let result = wait_request(
+        &request,
+        IoError::Unsupported("IndexedDB can't be opened".to_owned()),
+    )
+    .await;
+    // The upgrade happens before the success of the request, if ever.
+    request.set_onupgradeneeded(None);
+    drop(onupgradeneeded);
+
+    let database: IdbDatabase = result?.unchecked_into();
+    DATABASE.with(|db| db.replace(Some(database.clone())));
+
+    Ok(database)
+}
+
+/// Opens a transaction over the preferences object store.
+async fn open_store(mode: IdbTransactionMode) -> Result<(IdbTransaction, IdbObjectStore)> {
+    let database = get_database().await?;
+    let transaction = database
+        .transaction_with_str_and_mode(STORE_NAME, mode)
+        .map_err(|_| IoError::Read)?;
+    let store = transaction
+        .object_store(STORE_NAME)
+        .map_err(|_| IoError::Read)?;
+
+    Ok((transaction, store))
+}
+
+/// Loads the binary representation of a preferences set from the browser `IndexedDB`.
+///
+/// * `name` - key that uniquely identify the preferences set that will be loaded.
+/// The `name` key can contain only ascii alphanumeric characters or -, _.
+///
+/// # Errors
+/// This function returns one of the following errors:
+/// * [IoError::Read] - if an error occurred while reading the data from the database
+/// * [IoError::EmptyData] - if the data associated to the provided `name` is empty
+/// * [IoError::Unsupported] - if the browser don't supports the IndexedDB API
+pub async fn load_bytes(name: &str) -> Result<Vec<u8>> {
+    if !is_name_valid(name) {
+        return Err(IoError::InvalidName(name.to_owned()));
+    }
+
+    let (_, store) = open_store(IdbTransactionMode::Readonly).await?;
+    let request = store
+        .get(&JsValue::from_str(name))
+        .map_err(|_| IoError::Read)?;
+    let value = wait_request(&request, IoError::Read).await?;
+
+    if value.is_undefined() || value.is_null() {
+        return Err(IoError::EmptyData);
+    }
+    let data = value
+        .dyn_into::<Uint8Array>()
+        .map_err(|_| IoError::Read)?
+        .to_vec();
+
+    if data.is_empty() {
+        Err(IoError::EmptyData)
+    } else {
+        Ok(data)
+    }
+}
+
+/// Saves the binary representation of preferences set into the browser `IndexedDB`.
+///
+/// * `name` - key that uniquely identify the preferences set that will be saved.
+/// The `name` key can contain only ascii alphanumeric characters or -, _.
+/// * `data` - the preferences set that will be stored.
+///
+/// # Errors
+/// This function can returns one of the following errors:
+/// * [IoError::Write] - if an error occur while writing the data into the database
+/// * [IoError::Unsupported] - if the browser don't supports the IndexedDB API
+pub async fn save_bytes(name: &str, data: &[u8]) -> Result<()> {
+    if !is_name_valid(name) {
+        return Err(IoError::InvalidName(name.to_owned()));
+    }
+
+    let (transaction, store) = open_store(IdbTransactionMode::Readwrite).await?;
+    store
+        .put_with_key(&Uint8Array::from(data), &JsValue::from_str(name))
+        .map_err(|_| IoError::Write)?;
+
+    wait_transaction(&transaction).await
+}
+
+/// Deletes a preferences set from the browser `IndexedDB`.
+pub async fn erase(name: &str) {
+    if !is_name_valid(name) {
+        return;
+    }
+
+    if let Ok((transaction, store)) = open_store(IdbTransactionMode::Readwrite).await {
+        if store.delete(&JsValue::from_str(name)).is_ok() {
+            // The set may not exist, ignore the error.
+            let _ = wait_transaction(&transaction).await;
+        }
+    }
+}
+
+/// Check if exist a preferences set with the provided name into the browser `IndexedDB`.
+pub async fn exist(name: &str) -> bool {
+    if !is_name_valid(name) {
+        return false;
+    }
+
+    let request = match open_store(IdbTransactionMode::Readonly).await {
+        Ok((_, store)) => store.count_with_key(&JsValue::from_str(name)),
+        Err(_) => return false,
+    };
+
+    match request {
+        Ok(request) => wait_request(&request, IoError::Read)
+            .await
+            .ok()
+            .and_then(|count| count.as_f64())
+            .map_or(false, |count| count > 0.0),
+        Err(_) => false,
+    }
+}
@@ -6,6 +6,9 @@
 //! * android
 //! * ios
 //! * wasm32 on browser
+//!
+//! On browser the preferences can also be stored asynchronously into the `IndexedDB` through the
+//! [idb] module.
 
 use std::io::{Error as StdIoError, Error};
 use thiserror::Error;
@@ -14,6 +17,8 @@ mod native;
 #[cfg(not(target_arch = "wasm32"))]
 use native as sys;
 
+#[cfg(not(target_arch = "wasm32"))]
+use memmap2::Mmap;
 #[cfg(not(target_arch = "wasm32"))]
 pub use native::set_preferences_app_dir;
 
@@ -21,6 +26,8 @@ pub use native::set_preferences_app_dir;
 mod wasm;
 #[cfg(all(target_arch = "wasm32", target_os = "unknown", feature = "js"))]
 use wasm as sys;
+#[cfg(all(target_arch = "wasm32", target_os = "unknown", feature = "js"))]
+pub mod idb;
 
 /// Struct that represents a generic I/O error.
 #[derive(Error, Debug)]
@@ -29,6 +36,8 @@ pub enum IoError {
     Std(StdIoError),
     #[error("the preferences app directory was not initialized")]
     EmptyPreferencesPath,
+    #[error("the preferences app directory is already set, can't change it to `{0}`")]
+    AppDirAlreadySet(String),
     #[error("invalid name `{0}`")]
     InvalidName(String),
     #[error("the preferences are empty")]
@@ -66,6 +75,7 @@ fn is_name_valid(name: &str) -> bool {
 /// * [IoError::EmptyData] - if the data associated to the provided `name` is empty
 /// * [IoError::Unsupported] - if the device don't supports this operation
 pub fn load(name: &str) -> Result<String> {
+    timed!("preferences.read");
     if is_name_valid(name) {
         sys::load(name)
     } else {
@@ -84,6 +94,7 @@ pub fn load(name: &str) -> Result<String> {
 /// * [IoError::Write] - if an error occur while writing the data into the device storage
 /// * [IoError::Unsupported] - if the device don't supports this operation
 pub fn save(name: &str, data: &str) -> Result<()> {
+    timed!("preferences.write");
     if is_name_valid(name) {
         sys::save(name, data)
     } else {
@@ -91,6 +102,83 @@ pub fn save(name: &str, data: &str) -> Result<()> {
     }
 }
 
+/// Loads the binary representation of a preferences set.
+///
+/// * `name` - key that uniquely identify the preferences set that will be loaded.  
+/// The `name` key can contain only ascii alphanumeric characters or -, _.
+///
+/// # Errors
+/// This function returns one of the following errors:
+/// * [IoError::Read] - if an error occurred while reading the data from the device storage
+/// * [IoError::EmptyData] - if the data associated to the provided `name` is empty
+/// * [IoError::Unsupported] - if the device don't supports this operation
+pub fn load_bytes(name: &str) -> Result<Vec<u8>> {
+    timed!("preferences.read");
+    if is_name_valid(name) {
+        sys::load_bytes(name)
+    } else {
+        Err(IoError::InvalidName(name.to_owned()))
+    }
+}
+
+/// Saves the binary representation of preferences set into the device storage.
+///
+/// * `name` - key that uniquely identify the preferences set that will be saved.  
+/// The `name` key can contain only ascii alphanumeric characters or -, _.
+/// * `data` - the preferences set that will be stored.
+///
+/// # Errors
+/// This function can returns one of the following errors:
+/// * [IoError::Write] - if an error occur while writing the data into the device storage
+/// * [IoError::Unsupported] - if the device don't supports this operation
+pub fn save_bytes(name: &str, data: &[u8]) -> Result<()> {
+    timed!("preferences.write");
+    if is_name_valid(name) {
+        sys::save_bytes(name, data)
+    } else {
+        Err(IoError::InvalidName(name.to_owned()))
+    }
+}
+
+/// Maps into memory the binary representation of a preferences set, so that the data are
+/// read from the device storage only when accessed.
+///
+/// * `name` - key that uniquely identify the preferences set that will be mapped.  
+/// The `name` key can contain only ascii alphanumeric characters or -, _.
+///
+/// # Errors
+/// This function returns one of the following errors:
+/// * [IoError::Std] - if an error occurred while mapping the data from the device storage
+/// * [IoError::EmptyData] - if the data associated to the provided `name` is empty
+#[cfg(not(target_arch = "wasm32"))]
+pub fn map_bytes(name: &str) -> Result<Mmap> {
+    if is_name_valid(name) {
+        sys::map_bytes(name)
+    } else {
+        Err(IoError::InvalidName(name.to_owned()))
+    }
+}
+
+/// Appends some bytes to the binary representation of a preferences set into the device
+/// storage, if the preferences set don't exist it will be created.
+///
+/// * `name` - key that uniquely identify the preferences set that will be updated.  
+/// The `name` key can contain only ascii alphanumeric characters or -, _.
+/// * `data` - the bytes that will be appended to the preferences set.
+///
+/// # Errors
+/// This function can returns one of the following errors:
+/// * [IoError::Write] - if an error occur while writing the data into the device storage
+/// * [IoError::Unsupported] - if the device don't supports this operation
+pub fn append_bytes(name: &str, data: &[u8]) -> Result<()> {
+    timed!("preferences.write");
+    if is_name_valid(name) {
+        sys::append_bytes(name, data)
+    } else {
+        Err(IoError::InvalidName(name.to_owned()))
+    }
+}
+
 /// Erase a preferences set stored into the device memory.
 pub fn erase(name: &str) {
     if is_name_valid(name) {
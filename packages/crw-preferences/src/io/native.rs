@@ -7,75 +7,84 @@
 //! * ios
 
 use crate::io::{IoError, Result};
-use once_cell::sync::Lazy;
+use memmap2::Mmap;
+use once_cell::sync::OnceCell;
+use std::ffi::OsString;
 use std::fs;
-use std::fs::File;
-use std::path::PathBuf;
-use std::sync::Mutex;
+use std::fs::{File, OpenOptions};
+use std::io::{ErrorKind, Write};
+use std::path::{Path, PathBuf};
 
-/// Global variable that contains the directory name where will be stored the configurations files.
-static PREFERENCES_APP_DIR: Lazy<Mutex<String>> = Lazy::new(|| {
-    let str = option_env!("CARGO_BIN_NAME").unwrap_or("").to_owned();
-    Mutex::new(str)
-});
+/// Directory where are stored the configurations files, resolved and created only once.
+static PREFERENCES_DIR: OnceCell<PathBuf> = OnceCell::new();
 
-/// Gets a file with the provided name from the application configuration directory.
+/// Resolves the directory where will be stored the configurations files, creating it if
+/// don't exist.
 ///
-/// * `name` - the name of the file requested from the user.
-/// * `create` - if true creates also the file if not exist.
+/// * `app_dir` - the application directory provided from the user.
 ///
-/// The file is located inside the application config directory that depends on the target device OS.
+/// The directory is located inside the application config directory that depends on the target device OS.
 ///
 /// |Platform | Example                                                                                                    |
 /// | ------- | -----------------------------------------------------------------------------------------------------------|
-/// | Linux   | `$XDG_CONFIG_HOME`/{PREFERENCES_APP_DIR}/{name} or `$HOME/.config/{PREFERENCES_APP_DIR}/{name}`            |
-/// | macOS   | `$HOME`/Library/Application Support/{PREFERENCES_APP_DIR}/{name}                                           |
-/// | Windows |  C:\Users\`$USER`\AppData\Roaming\{PREFERENCES_APP_DIR}/{name}                                             |
-/// | Android | {PREFERENCES_APP_DIR}/{name}                                                                               |
-/// | iOS     | {PREFERENCES_APP_DIR}/{name}                                                                               |
+/// | Linux   | `$XDG_CONFIG_HOME`/{PREFERENCES_APP_DIR} or `$HOME/.config/{PREFERENCES_APP_DIR}`                          |
+/// | macOS   | `$HOME`/Library/Application Support/{PREFERENCES_APP_DIR}                                                  |
+/// | Windows |  C:\Users\`$USER`\AppData\Roaming\{PREFERENCES_APP_DIR}                                                   |
+/// | Android | {PREFERENCES_APP_DIR}                                                                                      |
+/// | iOS     | {PREFERENCES_APP_DIR}                                                                                      |
 ///
 /// # Errors
 ///
-/// This function return an [std::io::Error] if the file can't be created inside the configuration directory.
-fn get_config_file(name: &str, create: bool) -> Result<PathBuf> {
+/// This function returns [IoError::EmptyPreferencesPath] if `app_dir` is empty or an
+/// [std::io::Error] if the directory can't be created.
+///
+/// * `create` - if true the directory inside the user app configurations directory is created.
+fn resolve_dir(app_dir: &str, create: bool) -> Result<PathBuf> {
     cfg_if! {
         if #[cfg(test)] {
             // In test mode just use the current working directory.
-            let mut config_dir = PathBuf::new();
+            let _ = (app_dir, create);
+            Ok(PathBuf::new())
         }
         else if #[cfg(any(target_os = "android", target_os = "ios"))] {
             // On android or ios we can't obtain the path at runtime so the app dir must be an
             // absolute path to the directory where will be stored the configurations.
-            let dir = PREFERENCES_APP_DIR.lock().unwrap();
-            if dir.is_empty() {
+            let _ = create;
+            if app_dir.is_empty() {
                 return Err(IoError::EmptyPreferencesPath);
             }
-            let mut config_dir = PathBuf::from(dir.as_str());
+            Ok(PathBuf::from(app_dir))
         }
         else {
-            // The application name is resolved as compile from the cargo project name.
-            let dir = PREFERENCES_APP_DIR.lock().unwrap();
-            if dir.is_empty() {
+            if app_dir.is_empty() {
                 return Err(IoError::EmptyPreferencesPath);
             }
-            let mut config_dir = dirs::config_dir().unwrap();
-            // Append the binary name to the default config dir
-            config_dir.push(dir.as_str());
-            // Check if the directory exists, if not create it.
-            if !config_dir.exists() {
+            let mut config_dir = dirs::config_dir().ok_or(IoError::EmptyPreferencesPath)?;
+            // Append the application dir to the default config dir
+            config_dir.push(app_dir);
+            if create {
                 fs::create_dir_all(config_dir.as_path())?;
             }
+            Ok(config_dir)
         }
     }
+}
 
-    // Append the name provided from the user
-    config_dir.push(name);
-    // Check if the file exists, if not create an empty one.
-    if create && !config_dir.exists() {
-        File::create(config_dir.as_path())?;
-    }
-    // Returns the config file path.
-    Ok(config_dir)
+/// Gets the path of the file with the provided name inside the application configuration
+/// directory.
+/// If [set_preferences_app_dir] has not been called the application directory is the cargo
+/// binary name resolved at compile time.
+///
+/// * `name` - the name of the file requested from the user.
+///
+/// # Errors
+///
+/// This function returns an [IoError] if the application configuration directory can't be
+/// resolved.
+fn get_config_file(name: &str) -> Result<PathBuf> {
+    let dir = PREFERENCES_DIR
+        .get_or_try_init(|| resolve_dir(option_env!("CARGO_BIN_NAME").unwrap_or(""), true))?;
+    Ok(dir.join(name))
 }
 
 /// Sets the application directory where will be stored the configurations.
@@ -83,10 +92,41 @@ fn get_config_file(name: &str, create: bool) -> Result<PathBuf> {
 /// be create inside the current user app configurations directory.
 /// On Android and iOS instead since is not possible to obtain the path where the application
 /// can read and write `dir` must be an absolute path to a directory accessible from the application.
-pub fn set_preferences_app_dir(dir: &str) {
-    let mut str = PREFERENCES_APP_DIR.lock().unwrap();
-    str.clear();
-    str.push_str(dir);
+///
+/// The directory is resolved and created only once, so this function must be called before
+/// accessing any preferences set.
+///
+/// # Errors
+/// This function returns [IoError::AppDirAlreadySet] if a different directory has already been
+/// set or used, [IoError::EmptyPreferencesPath] if `dir` is empty or an [std::io::Error] if the
+/// directory can't be created.
+pub fn set_preferences_app_dir(dir: &str) -> Result<()> {
+    // Checks the directory already set before creating it, so a rejected call don't leave an
+    // empty directory behind.
+    if let Some(current) = PREFERENCES_DIR.get() {
+        return if *current == resolve_dir(dir, false)? {
+            Ok(())
+        } else {
+            Err(IoError::AppDirAlreadySet(dir.to_owned()))
+        };
+    }
+
+    let resolved = resolve_dir(dir, true)?;
+    match PREFERENCES_DIR.set(resolved) {
+        Ok(_) => Ok(()),
+        Err(resolved) if PREFERENCES_DIR.get() == Some(&resolved) => Ok(()),
+        Err(_) => Err(IoError::AppDirAlreadySet(dir.to_owned())),
+    }
+}
+
+/// Reads the file at `path`, returns [IoError::EmptyData] if it don't exist or is empty.
+fn read_file(path: PathBuf) -> Result<Vec<u8>> {
+    match fs::read(path) {
+        Ok(content) if content.is_empty() => Err(IoError::EmptyData),
+        Ok(content) => Ok(content),
+        Err(e) if e.kind() == ErrorKind::NotFound => Err(IoError::EmptyData),
+        Err(e) => Err(IoError::from(e)),
+    }
 }
 
 /// Loads the string representation of a preferences set.
@@ -98,14 +138,9 @@ pub fn set_preferences_app_dir(dir: &str) {
 /// * [IoError::Read] if the file with the provided `name` can't be read
 /// * [IoError::EmptyData] if the file is empty
 pub fn load(name: &str) -> Result<String> {
-    let config_file = get_config_file(name, true)?;
-    let content = fs::read_to_string(config_file)?;
+    let content = read_file(get_config_file(name)?)?;
 
-    if content.is_empty() {
-        Err(IoError::EmptyData)
-    } else {
-        Ok(content)
-    }
+    String::from_utf8(content).map_err(|_| IoError::Read)
 }
 
 /// Saves the string representation of preferences set into the device storage.
@@ -116,25 +151,130 @@ pub fn load(name: &str) -> Result<String> {
 /// # Errors
 /// This function returns [IoError::Write] if can't write to the file with the provided `name`.
 pub fn save(name: &str, data: &str) -> Result<()> {
-    let config_file = get_config_file(name, true)?;
-    fs::write(config_file, data)?;
+    save_bytes(name, data.as_bytes())
+}
+
+/// Loads the binary representation of a preferences set.
+///
+/// * `name` - name of the file from which will be loaded the preferences.
+///
+/// # Errors
+/// This function can returns one of the following errors:
+/// * [IoError::Read] if the file with the provided `name` can't be read
+/// * [IoError::EmptyData] if the file is empty
+pub fn load_bytes(name: &str) -> Result<Vec<u8>> {
+    read_file(get_config_file(name)?)
+}
+
+/// Saves the binary representation of preferences set into the device storage.
+///
+/// * `name` - Name of the file where will be stored the data.
+/// * `data` - The bytes that will be stored inside the file.
+///
+/// # Errors
+/// This function returns [IoError::Write] if can't write to the file with the provided `name`.
+pub fn save_bytes(name: &str, data: &[u8]) -> Result<()> {
+    let config_file = get_config_file(name)?;
+    write_atomic(&config_file, data)?;
+    Ok(())
+}
+
+/// Maps into memory the binary representation of a preferences set, so that the data are
+/// read from the device storage only when accessed.
+///
+/// * `name` - name of the file that will be mapped.
+///
+/// # Safety
+/// The returned map is valid as long as the file is not truncated or modified in place from
+/// another process, the files wrote from this crate are only appended or atomically replaced.
+///
+/// # Errors
+/// This function can returns one of the following errors:
+/// * [IoError::Std] if the file with the provided `name` can't be mapped
+/// * [IoError::EmptyData] if the file don't exist or is empty
+pub fn map_bytes(name: &str) -> Result<Mmap> {
+    let file = match File::open(get_config_file(name)?) {
+        Ok(file) => file,
+        Err(e) if e.kind() == ErrorKind::NotFound => return Err(IoError::EmptyData),
+        Err(e) => return Err(IoError::from(e)),
+    };
+    if file.metadata()?.len() == 0 {
+        return Err(IoError::EmptyData);
+    }
+    let map = unsafe { Mmap::map(&file)? };
+    Ok(map)
+}
+
+/// Appends `data` to the binary representation of a preferences set into the device storage,
+/// creating it if not exist.
+///
+/// * `name` - Name of the file where will be appended the data.
+/// * `data` - The bytes that will be appended to the file.
+///
+/// # Errors
+/// This function returns [IoError::Std] if can't write to the file with the provided `name`.
+pub fn append_bytes(name: &str, data: &[u8]) -> Result<()> {
+    let config_file = get_config_file(name)?;
+    let mut file = OpenOptions::new()
+        .create(true)
+        .append(true)
+        .open(config_file)?;
+    file.write_all(data)?;
+    file.sync_data()?;
+    Ok(())
+}
+
+/// Replaces the content of the file at `path` with `data` so that after a crash the file
+/// contains either the previous or the new data, never a truncated one.
+///
+/// The data are wrote to a temporary file inside the same directory that is flushed to the
+/// device and then renamed over `path`, finally the directory is flushed too to persist the
+/// rename.
+fn write_atomic(path: &Path, data: &[u8]) -> std::io::Result<()> {
+    let mut tmp_name = OsString::from(".");
+    tmp_name.push(path.file_name().unwrap_or_default());
+    tmp_name.push(".tmp");
+    let tmp_path = path.with_file_name(tmp_name);
+
+    let result = File::create(&tmp_path).and_then(|mut file| {
+        file.write_all(data)?;
+        file.sync_all()
+    });
+    if let Err(e) = result.and_then(|_| fs::rename(&tmp_path, path)) {
+        let _ = fs::remove_file(&tmp_path);
+        return Err(e);
+    }
+
+    sync_parent_dir(path)
+}
+
+/// Flushes the directory that contains `path` so that a rename inside it is persisted.
+#[cfg(unix)]
+fn sync_parent_dir(path: &Path) -> std::io::Result<()> {
+    let dir = match path.parent() {
+        Some(dir) if !dir.as_os_str().is_empty() => dir,
+        _ => Path::new("."),
+    };
+    File::open(dir)?.sync_all()
+}
+
+/// On non unix systems the directories can't be opened, the rename is persisted from the os.
+#[cfg(not(unix))]
+fn sync_parent_dir(_path: &Path) -> std::io::Result<()> {
     Ok(())
 }
 
 /// Deletes the file with the provide `name` from the device storage.
 pub fn erase(name: &str) {
-    let path = get_config_file(name, false);
-    if let Ok(path) = path {
-        if path.exists() {
-            // Make the compiler happy, an error here should never occur.
-            let _ = fs::remove_file(path);
-        }
+    if let Ok(path) = get_config_file(name) {
+        // The file may not exist, ignore the error.
+        let _ = fs::remove_file(path);
     }
 }
 
 /// Check if exist a preferences set with the provided `name` into the device storage.
 pub fn exist(name: &str) -> bool {
-    let path = get_config_file(name, false);
+    let path = get_config_file(name);
 
     if let Ok(p) = path {
         p.exists()
@@ -142,3 +282,41 @@ pub fn exist(name: &str) -> bool {
         false
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn atomic_save() {
+        let name = "native-atomic-save";
+        save(name, "first").unwrap();
+        save(name, "second").unwrap();
+
+        assert_eq!("second", load(name).unwrap());
+        // The temporary file has been renamed
+        assert!(!Path::new(".native-atomic-save.tmp").exists());
+
+        erase(name);
+        assert!(!exist(name));
+    }
+
+    #[test]
+    fn missing_file() {
+        let name = "native-missing-file";
+
+        assert!(matches!(load(name), Err(IoError::EmptyData)));
+        assert!(matches!(load_bytes(name), Err(IoError::EmptyData)));
+        assert!(matches!(map_bytes(name), Err(IoError::EmptyData)));
+        // Loading don't create the file
+        assert!(!exist(name));
+        erase(name);
+    }
+
+    #[test]
+    fn app_dir_resolved_once() {
+        // In test mode the directory is always the current working directory
+        assert!(set_preferences_app_dir("test").is_ok());
+        assert_eq!(PathBuf::from("name"), get_config_file("name").unwrap());
+    }
+}
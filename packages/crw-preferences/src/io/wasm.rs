@@ -50,6 +50,41 @@ pub fn save(name: &str, value: &str) -> Result<()> {
     Storage::set_item(&storage, name, value).map_err(|_| IoError::Write)
 }
 
+/// Loads the binary representation of a preferences set from the browser `LocalStorage`.
+/// Since the `LocalStorage` can contain only strings the data are stored encoded as base64.
+///
+/// * `name` - key that uniquely identify the preferences set that will be loaded.
+pub fn load_bytes(name: &str) -> Result<Vec<u8>> {
+    let encoded = load(name)?;
+
+    base64::decode(encoded).map_err(|_| IoError::Read)
+}
+
+/// Saves the binary representation of preferences set into the browser `LocalStorage`
+/// encoded as base64.
+///
+/// * `name` - key that uniquely identify the preferences set that will be saved.
+/// * `value` - the preferences set that will be saved into the browser localStorage.
+pub fn save_bytes(name: &str, value: &[u8]) -> Result<()> {
+    save(name, &base64::encode(value))
+}
+
+/// Appends `value` to the binary representation of a preferences set into the browser
+/// `LocalStorage`.
+/// Since the `LocalStorage` items can't be partially updated the whole item is rewrote.
+///
+/// * `name` - key that uniquely identify the preferences set that will be updated.
+/// * `value` - the bytes that will be appended to the preferences set.
+pub fn append_bytes(name: &str, value: &[u8]) -> Result<()> {
+    let mut data = match load_bytes(name) {
+        Ok(data) => data,
+        Err(IoError::EmptyData) => Vec::new(),
+        Err(e) => return Err(e),
+    };
+    data.extend_from_slice(value);
+    save_bytes(name, &data)
+}
+
 /// Deletes the data from the browser `LocalStorage`
 pub fn erase(name: &str) {
     let storage = get_storage();
@@ -0,0 +1,570 @@
+//! Module that provides an implementation of [Preferences] that stores the changes into an
+//! append-only log instead of rewriting the whole preferences set on each save.
+//!
+//! The log starts with a header followed from a sequence of records, each one prefixed with
+//! its length as little endian u32:
+//!
+//! | magic `CRWJ` | version | encrypted flag | record length | record | record length | ... |
+//! | ------------ | ------- | -------------- | ------------- | ------ | ------------- | --- |
+//! | 4 bytes      | 1 byte  | 1 byte         | 4 bytes       | ...    | 4 bytes       | ... |
+//!
+//! Each save appends only the records of the values changed since the previous save, so its
+//! cost don't depend on the preferences set size. When the log contains too many stale records
+//! it's compacted, rewriting it atomically with a single snapshot record.
+//! When the log is encrypted each record is encrypted on its own with the key derived from the
+//! password when the log is opened.
+
+use crate::cipher::PreferencesCipher;
+use crate::encrypted::EncryptedPreferencesError;
+use crate::io;
+use crate::io::IoError;
+use crate::preferences::{Preferences, PreferencesError, Result};
+use crate::value::Value;
+use serde::{Deserialize, Serialize};
+use std::borrow::Cow;
+use std::collections::{HashMap, HashSet};
+use std::convert::TryFrom;
+use std::result::Result as StdResult;
+use std::sync::Mutex;
+
+/// Magic bytes that identify a preferences log.
+const MAGIC: &[u8; 4] = b"CRWJ";
+/// Version of the log layout.
+const VERSION: u8 = 1;
+pub(crate) const FLAG_PLAIN: u8 = 0;
+const FLAG_ENCRYPTED: u8 = 1;
+pub(crate) const HEADER_SIZE: usize = MAGIC.len() + 2;
+pub(crate) const LENGTH_SIZE: usize = 4;
+/// Minimum number of records in the log before considering a compaction.
+pub(crate) const COMPACTION_MIN_RECORDS: usize = 256;
+
+/// Record read from the log.
+#[derive(Deserialize)]
+enum Record {
+    Snapshot(HashMap<String, Value>),
+    Put(String, Value),
+    Clear,
+}
+
+/// Record wrote to the log, its serialization is the same of [Record] but it borrows the data
+/// from the preferences set to avoid to clone them.
+#[derive(Serialize)]
+pub(crate) enum RecordRef<'a> {
+    Snapshot(&'a HashMap<String, Value>),
+    Put(&'a str, &'a Value),
+    Clear,
+}
+
+/// Tells how the records are stored into the log.
+pub(crate) enum Codec {
+    Plain,
+    Encrypted(PreferencesCipher),
+}
+
+impl Codec {
+    fn flag(&self) -> u8 {
+        match self {
+            Codec::Plain => FLAG_PLAIN,
+            Codec::Encrypted(_) => FLAG_ENCRYPTED,
+        }
+    }
+
+    /// Appends `record` to `out` prefixed with its length.
+    pub(crate) fn encode(&self, record: &RecordRef, out: &mut Vec<u8>) -> Result<()> {
+        let serialized =
+            bincode::serialize(record).map_err(|_| PreferencesError::SerializationError)?;
+        let payload = match self {
+            Codec::Plain => serialized,
+            Codec::Encrypted(cipher) => cipher
+                .encrypt(&serialized)
+                .map_err(|_| PreferencesError::SerializationError)?,
+        };
+        let length =
+            u32::try_from(payload.len()).map_err(|_| PreferencesError::SerializationError)?;
+
+        out.extend_from_slice(&length.to_le_bytes());
+        out.extend_from_slice(&payload);
+        Ok(())
+    }
+
+    /// Decodes a record, returns [None] if the record is corrupted.
+    fn decode(&self, payload: &[u8]) -> Option<Record> {
+        match self {
+            Codec::Plain => bincode::deserialize(payload).ok(),
+            Codec::Encrypted(cipher) => bincode::deserialize(&cipher.decrypt(payload).ok()?).ok(),
+        }
+    }
+}
+
+/// Changes not yet wrote to the log.
+#[derive(Default)]
+struct Changes {
+    /// Tells if the preferences have been cleared.
+    cleared: bool,
+    /// Keys of the values changed after the last save or clear.
+    dirty: HashSet<String>,
+    /// Number of records into the log, 0 if the log don't exist yet.
+    records: usize,
+    /// Tells if the log must be rewrote, e.g. because it ends with a corrupted record.
+    compact: bool,
+}
+
+/// Preferences set stored into an append-only log.
+pub struct JournalPreferences {
+    name: String,
+    codec: Codec,
+    data: HashMap<String, Value>,
+    changes: Mutex<Changes>,
+}
+
+impl JournalPreferences {
+    /// Loads the preferences set replaying the log stored into the device storage.
+    ///
+    /// * `name` - the preferences set name.
+    /// * `password` - the password used to decrypt the log, [None] if the log is not encrypted.
+    ///
+    /// # Errors
+    /// This function can return the following errors:
+    /// * [EncryptedPreferencesError::DecryptionFailed] if the provided password is not valid.
+    /// * [PreferencesError::InvalidName] if the provided name contains non ascii alphanumeric chars
+    /// * [PreferencesError::DeserializationError] if the data inside the disc is not a valid log.
+    /// * [PreferencesError::IO] if an error occurred while reading the data from the device storage.
+    fn load(
+        name: &str,
+        password: Option<&str>,
+    ) -> StdResult<JournalPreferences, EncryptedPreferencesError> {
+        let mut preferences = JournalPreferences {
+            name: name.to_owned(),
+            codec: Codec::Plain,
+            data: HashMap::new(),
+            changes: Mutex::new(Changes::default()),
+        };
+
+        let log = match io::load_bytes(name) {
+            Ok(log) => log,
+            Err(IoError::EmptyData) => {
+                if let Some(password) = password {
+                    preferences.codec = Codec::Encrypted(PreferencesCipher::new(password)?);
+                }
+                return Ok(preferences);
+            }
+            Err(IoError::InvalidName(s)) => {
+                return Err(EncryptedPreferencesError::from(
+                    PreferencesError::InvalidName(s),
+                ))
+            }
+            Err(e) => return Err(EncryptedPreferencesError::from(PreferencesError::IO(e))),
+        };
+
+        let expected_flag = if password.is_some() {
+            FLAG_ENCRYPTED
+        } else {
+            FLAG_PLAIN
+        };
+        if !has_log_header(&log, expected_flag) {
+            return Err(EncryptedPreferencesError::from(
+                PreferencesError::DeserializationError,
+            ));
+        }
+
+        let mut changes = Changes::default();
+        let mut offset = HEADER_SIZE;
+        while offset < log.len() {
+            let payload = match next_payload(&log, offset) {
+                Some(payload) => payload,
+                None => {
+                    // The log ends with a record partially wrote.
+                    changes.compact = true;
+                    break;
+                }
+            };
+            offset += LENGTH_SIZE + payload.len();
+
+            let record = match (password, &preferences.codec) {
+                // The first record of an encrypted log gives the salt used to derive the key.
+                (Some(password), Codec::Plain) => {
+                    let (cipher, decrypted) =
+                        PreferencesCipher::open_with_password(password, payload)?;
+                    preferences.codec = Codec::Encrypted(cipher);
+                    bincode::deserialize(&decrypted).ok()
+                }
+                _ => preferences.codec.decode(payload),
+            };
+
+            match record {
+                Some(Record::Snapshot(data)) => preferences.data = data,
+                Some(Record::Put(key, value)) => {
+                    preferences.data.insert(key, value);
+                }
+                Some(Record::Clear) => preferences.data.clear(),
+                None => {
+                    changes.compact = true;
+                    break;
+                }
+            }
+            changes.records += 1;
+        }
+
+        if let (Some(password), Codec::Plain) = (password, &preferences.codec) {
+            preferences.codec = Codec::Encrypted(PreferencesCipher::new(password)?);
+        }
+        preferences.changes = Mutex::new(changes);
+
+        Ok(preferences)
+    }
+
+    /// Creates a new preferences set with the provided `name`.
+    /// If already exist a preferences set with the provided name will be loaded the previous one.
+    ///
+    /// * `name` - The preferences name, can contains only ascii alphanumeric chars or -, _.
+    ///
+    /// # Errors
+    /// This function returns [PreferencesError::InvalidName] if the provided name contains
+    /// non ascii alphanumeric chars or [PreferencesError::DeserializationError] if the data
+    /// associated with the provided name are invalid.
+    pub fn new(name: &str) -> Result<JournalPreferences> {
+        JournalPreferences::load(name, None).map_err(|e| match e {
+            EncryptedPreferencesError::Preferences(e) => *e,
+            EncryptedPreferencesError::DecryptionFailed => PreferencesError::DeserializationError,
+        })
+    }
+
+    /// Creates a new encrypted preferences set with the provided `name`.
+    /// If already exist a preferences set with the provided name will be loaded the previous one.
+    ///
+    /// * `password` - the password used to encrypt the preferences set.
+    /// * `name` - The preferences name, can contains only ascii alphanumeric chars or -, _.
+    ///
+    /// # Errors
+    /// This function can return the following errors:
+    /// * [EncryptedPreferencesError::DecryptionFailed] if the provided password is not valid.
+    /// * [PreferencesError::InvalidName] if the provided name contains non ascii alphanumeric chars
+    /// * [PreferencesError::DeserializationError] if the data inside the disc is not valid.
+    /// * [PreferencesError::IO] if an error occurred while reading the data from the device storage.
+    pub fn new_encrypted(
+        password: &str,
+        name: &str,
+    ) -> StdResult<JournalPreferences, EncryptedPreferencesError> {
+        JournalPreferences::load(name, Some(password))
+    }
+
+    fn put(&mut self, key: &str, value: Value) -> Result<()> {
+        let changes = self.changes.get_mut().unwrap();
+        if !changes.dirty.contains(key) {
+            changes.dirty.insert(key.to_owned());
+        }
+        self.data.insert(key.to_owned(), value);
+        Ok(())
+    }
+
+    /// Rewrites the log with a single snapshot of the preferences set.
+    fn compact(&self, changes: &mut Changes) -> Result<()> {
+        let mut log = log_header(self.codec.flag());
+        self.codec
+            .encode(&RecordRef::Snapshot(&self.data), &mut log)?;
+
+        io::save_bytes(&self.name, &log)?;
+        changes.records = 1;
+        Ok(())
+    }
+
+    /// Appends the pending changes to the log.
+    fn append(&self, changes: &mut Changes) -> Result<()> {
+        let mut records = Vec::new();
+        let mut count = 0;
+        if changes.cleared {
+            self.codec.encode(&RecordRef::Clear, &mut records)?;
+            count += 1;
+        }
+        for key in changes.dirty.iter() {
+            if let Some(value) = self.data.get(key) {
+                self.codec
+                    .encode(&RecordRef::Put(key, value), &mut records)?;
+                count += 1;
+            }
+        }
+
+        // A failed append can leave a partial record at the end of the log, so it's rewrote
+        // on the next save unless the append succeeds.
+        changes.compact = true;
+        io::append_bytes(&self.name, &records)?;
+        changes.compact = false;
+        changes.records += count;
+        Ok(())
+    }
+}
+
+/// Creates the header of a log whose records are stored as told from `flag`.
+pub(crate) fn log_header(flag: u8) -> Vec<u8> {
+    let mut header = Vec::with_capacity(HEADER_SIZE);
+    header.extend_from_slice(MAGIC);
+    header.push(VERSION);
+    header.push(flag);
+    header
+}
+
+/// Tells if `log` starts with the header of a log whose records are stored as told from `flag`.
+pub(crate) fn has_log_header(log: &[u8], flag: u8) -> bool {
+    log.len() >= HEADER_SIZE
+        && log.starts_with(MAGIC)
+        && log[MAGIC.len()] == VERSION
+        && log[MAGIC.len() + 1] == flag
+}
+
+/// Gets the payload of the record that starts at `offset`, returns [None] if the record
+/// is truncated.
+pub(crate) fn next_payload(log: &[u8], offset: usize) -> Option<&[u8]> {
+    let length_end = offset.checked_add(LENGTH_SIZE)?;
+    let mut length = [0u8; LENGTH_SIZE];
+    length.copy_from_slice(log.get(offset..length_end)?);
+    let payload_end = length_end.checked_add(u32::from_le_bytes(length) as usize)?;
+
+    log.get(length_end..payload_end)
+}
+
+impl Preferences for JournalPreferences {
+    fn get_i32(&self, key: &str) -> Option<i32> {
+        self.data.get(key).and_then(|v| match v {
+            Value::I32(i32) => Some(i32.to_owned()),
+            _ => None,
+        })
+    }
+
+    fn put_i32(&mut self, key: &str, value: i32) -> Result<()> {
+        self.put(key, Value::I32(value))
+    }
+
+    fn get_str(&self, key: &str) -> Option<String> {
+        self.data.get(key).and_then(|v| match v {
+            Value::String(string) => Some(string.to_owned()),
+            _ => None,
+        })
+    }
+
+    fn get_str_ref(&self, key: &str) -> Option<Cow<str>> {
+        self.data.get(key).and_then(|v| match v {
+            Value::String(string) => Some(Cow::Borrowed(string.as_str())),
+            _ => None,
+        })
+    }
+
+    fn put_str(&mut self, key: &str, value: String) -> Result<()> {
+        self.put(key, Value::String(value))
+    }
+
+    fn get_bool(&self, key: &str) -> Option<bool> {
+        self.data.get(key).and_then(|v| match v {
+            Value::Bool(bool) => Some(bool.to_owned()),
+            _ => None,
+        })
+    }
+
+    fn put_bool(&mut self, key: &str, value: bool) -> Result<()> {
+        self.put(key, Value::Bool(value))
+    }
+
+    fn get_bytes(&self, key: &str) -> Option<Vec<u8>> {
+        self.data.get(key).and_then(|v| match v {
+            Value::Bin(bin) => Some(bin.to_owned()),
+            _ => None,
+        })
+    }
+
+    fn get_bytes_ref(&self, key: &str) -> Option<Cow<[u8]>> {
+        self.data.get(key).and_then(|v| match v {
+            Value::Bin(bin) => Some(Cow::Borrowed(bin.as_slice())),
+            _ => None,
+        })
+    }
+
+    fn put_bytes(&mut self, key: &str, value: Vec<u8>) -> Result<()> {
+        self.put(key, Value::Bin(value))
+    }
+
+    fn clear(&mut self) {
+        let changes = self.changes.get_mut().unwrap();
+        changes.cleared = true;
+        changes.dirty.clear();
+        self.data.clear()
+    }
+
+    fn erase(&mut self) {
+        self.data.clear();
+        *self.changes.get_mut().unwrap() = Changes::default();
+        io::erase(&self.name);
+    }
+
+    fn save(&self) -> Result<()> {
+        let mut changes = self.changes.lock().unwrap();
+        let pending = changes.cleared || !changes.dirty.is_empty();
+        if !pending && !changes.compact && changes.records > 0 {
+            return Ok(());
+        }
+
+        // Compact when the most of the records are stale.
+        let records = changes.records + changes.dirty.len();
+        if changes.compact
+            || changes.records == 0
+            || records > COMPACTION_MIN_RECORDS.max(self.data.len() * 2)
+        {
+            self.compact(&mut changes)?;
+        } else {
+            self.append(&mut changes)?;
+        }
+
+        changes.cleared = false;
+        changes.dirty.clear();
+        changes.compact = false;
+        Ok(())
+    }
+}
+
+#[cfg(test)]
+mod test {
+    use crate::encrypted::EncryptedPreferencesError;
+    use crate::io;
+    use crate::journal::{JournalPreferences, COMPACTION_MIN_RECORDS};
+    use crate::preferences::Preferences;
+
+    #[test]
+    pub fn test_data_read_write() {
+        let set_name = "journal-rw";
+        let test_vec: Vec<u8> = vec![12, 13, 54, 42];
+
+        let mut preferences = JournalPreferences::new(set_name).unwrap();
+        preferences.put_i32("i32", 42).unwrap();
+        preferences.put_str("str", "str".to_owned()).unwrap();
+        preferences.save().unwrap();
+        preferences.put_bool("bool", true).unwrap();
+        preferences.put_bytes("bin", test_vec.clone()).unwrap();
+        preferences.put_i32("i32", 43).unwrap();
+        preferences.save().unwrap();
+
+        let mut preferences = JournalPreferences::new(set_name).unwrap();
+        let i32_result = preferences.get_i32("i32");
+        let str_result = preferences.get_str("str");
+        let bool_result = preferences.get_bool("bool");
+        let binary_result = preferences.get_bytes("bin");
+
+        preferences.erase();
+        assert_eq!(43, i32_result.unwrap());
+        assert_eq!("str", str_result.unwrap());
+        assert_eq!(true, bool_result.unwrap());
+        assert_eq!(test_vec, binary_result.unwrap());
+    }
+
+    #[test]
+    pub fn test_save_appends_changes() {
+        let set_name = "journal-append";
+
+        let mut preferences = JournalPreferences::new(set_name).unwrap();
+        for i in 0..100 {
+            preferences
+                .put_bytes(&format!("key{}", i), vec![0; 100])
+                .unwrap();
+        }
+        preferences.save().unwrap();
+        let initial_size = io::load_bytes(set_name).unwrap().len();
+
+        preferences.put_bool("bool", true).unwrap();
+        preferences.save().unwrap();
+        let size = io::load_bytes(set_name).unwrap().len();
+
+        preferences.erase();
+        assert!(initial_size > 100 * 100);
+        assert!(size - initial_size < 32);
+    }
+
+    #[test]
+    pub fn test_compaction() {
+        let set_name = "journal-compaction";
+
+        let mut preferences = JournalPreferences::new(set_name).unwrap();
+        for i in 0..COMPACTION_MIN_RECORDS * 2 {
+            preferences.put_i32("i32", i as i32).unwrap();
+            preferences.save().unwrap();
+        }
+        let records = preferences.changes.lock().unwrap().records;
+        let size = io::load_bytes(set_name).unwrap().len();
+
+        let mut preferences = JournalPreferences::new(set_name).unwrap();
+        let result = preferences.get_i32("i32");
+        preferences.erase();
+        assert!(records <= COMPACTION_MIN_RECORDS);
+        assert!(size < COMPACTION_MIN_RECORDS * 32);
+        assert_eq!(Some(COMPACTION_MIN_RECORDS as i32 * 2 - 1), result);
+    }
+
+    #[test]
+    pub fn test_clear() {
+        let set_name = "journal-clear";
+
+        let mut preferences = JournalPreferences::new(set_name).unwrap();
+        preferences.put_i32("i32", 42).unwrap();
+        preferences.save().unwrap();
+        preferences.clear();
+        preferences.put_bool("bool", true).unwrap();
+        preferences.save().unwrap();
+
+        let mut preferences = JournalPreferences::new(set_name).unwrap();
+        let i32_result = preferences.get_i32("i32");
+        let bool_result = preferences.get_bool("bool");
+        preferences.erase();
+        assert_eq!(None, i32_result);
+        assert_eq!(Some(true), bool_result);
+    }
+
+    #[test]
+    pub fn test_truncated_record() {
+        let set_name = "journal-truncated";
+
+        let mut preferences = JournalPreferences::new(set_name).unwrap();
+        preferences.put_i32("i32", 42).unwrap();
+        preferences.save().unwrap();
+        // Simulate a crash while appending a record
+        io::append_bytes(set_name, &[200, 0, 0, 0, 1, 2]).unwrap();
+
+        let mut preferences = JournalPreferences::new(set_name).unwrap();
+        assert_eq!(Some(42), preferences.get_i32("i32"));
+        // The next save drops the truncated record
+        preferences.put_bool("bool", true).unwrap();
+        preferences.save().unwrap();
+
+        let mut preferences = JournalPreferences::new(set_name).unwrap();
+        let i32_result = preferences.get_i32("i32");
+        let bool_result = preferences.get_bool("bool");
+        preferences.erase();
+        assert_eq!(Some(42), i32_result);
+        assert_eq!(Some(true), bool_result);
+    }
+
+    #[test]
+    pub fn test_encrypted() {
+        let set_name = "journal-encrypted";
+        let password = "password";
+
+        let mut preferences = JournalPreferences::new_encrypted(password, set_name).unwrap();
+        preferences.put_str("str", "secret".to_owned()).unwrap();
+        preferences.save().unwrap();
+        preferences.put_i32("i32", 42).unwrap();
+        preferences.save().unwrap();
+
+        let log = io::load_bytes(set_name).unwrap();
+        assert!(!log.windows(6).any(|w| w == b"secret"));
+
+        let wrong = JournalPreferences::new_encrypted("wrong", set_name);
+        let plain = JournalPreferences::new(set_name);
+        let mut preferences = JournalPreferences::new_encrypted(password, set_name).unwrap();
+        let str_result = preferences.get_str("str");
+        let i32_result = preferences.get_i32("i32");
+        preferences.erase();
+
+        assert!(matches!(
+            wrong.err().unwrap(),
+            EncryptedPreferencesError::DecryptionFailed
+        ));
+        assert!(plain.is_err());
+        assert_eq!("secret", str_result.unwrap());
+        assert_eq!(42, i32_result.unwrap());
+    }
+}
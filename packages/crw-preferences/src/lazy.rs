@@ -0,0 +1,644 @@
+//! Module that provides a read-mostly implementation of [Preferences] that loads the values
+//! on demand from a memory mapped preferences log.
+//!
+//! When opened the log wrote from [JournalPreferences] is mapped into memory and only an index
+//! from each key to the position of its last value is built, the values are decoded only when
+//! requested, so the opening time don't depend on the size of the stored values.
+//! The changed values are kept in memory and appended to the log on save, when the log
+//! contains too many stale records it's compacted like the [JournalPreferences] one.
+//!
+//! Only the not encrypted logs can be loaded lazily, since the keys of the encrypted records
+//! can't be read without decrypting the whole record.
+//! On Windows a mapped file can't be replaced, so the log must not be compacted from a
+//! [JournalPreferences] while a [LazyPreferences] of the same set is open. For the same reason
+//! a [LazyPreferences] that needs to compact its log keeps appending to it, the values are
+//! decoded and the log is unmapped on the next change, so the following save can replace it.
+//!
+//! [JournalPreferences]: crate::journal::JournalPreferences
+
+use crate::io;
+use crate::io::IoError;
+use crate::journal::{
+    has_log_header, log_header, next_payload, Codec, RecordRef, COMPACTION_MIN_RECORDS, FLAG_PLAIN,
+    HEADER_SIZE, LENGTH_SIZE,
+};
+use crate::preferences::{Preferences, PreferencesError, Result};
+use crate::value::Value;
+use memmap2::Mmap;
+use std::borrow::Cow;
+use std::collections::{HashMap, HashSet};
+use std::convert::TryInto;
+use std::sync::Mutex;
+
+/// Bincode variant index of the log records.
+const RECORD_SNAPSHOT: u32 = 0;
+const RECORD_PUT: u32 = 1;
+const RECORD_CLEAR: u32 = 2;
+/// Bincode variant index of the values.
+const VALUE_I32: u32 = 0;
+const VALUE_BOOL: u32 = 1;
+const VALUE_STRING: u32 = 2;
+const VALUE_BIN: u32 = 3;
+
+/// Reader of the bincode encoded records that only skips the values.
+struct Reader<'a> {
+    data: &'a [u8],
+    position: usize,
+}
+
+impl<'a> Reader<'a> {
+    fn bytes(&mut self, len: usize) -> Option<&'a [u8]> {
+        let end = self.position.checked_add(len)?;
+        let bytes = self.data.get(self.position..end)?;
+        self.position = end;
+        Some(bytes)
+    }
+
+    fn u32(&mut self) -> Option<u32> {
+        Some(u32::from_le_bytes(self.bytes(4)?.try_into().ok()?))
+    }
+
+    /// Reads a length encoded as u64.
+    fn length(&mut self) -> Option<usize> {
+        let value = u64::from_le_bytes(self.bytes(8)?.try_into().ok()?);
+        value.try_into().ok()
+    }
+
+    fn string(&mut self) -> Option<&'a str> {
+        let len = self.length()?;
+        std::str::from_utf8(self.bytes(len)?).ok()
+    }
+
+    /// Skips a value returning its position.
+    fn skip_value(&mut self) -> Option<usize> {
+        let position = self.position;
+        let len = match self.u32()? {
+            VALUE_I32 => 4,
+            VALUE_BOOL => 1,
+            VALUE_STRING | VALUE_BIN => self.length()?,
+            _ => return None,
+        };
+        self.bytes(len)?;
+        Some(position)
+    }
+}
+
+/// Index of the values of a log.
+struct LogIndex {
+    /// Position of the last value of each key.
+    positions: HashMap<String, usize>,
+    /// Number of valid records.
+    records: usize,
+    /// Tells if the log ends with a record partially wrote.
+    truncated: bool,
+}
+
+/// Builds the index from each key to the position of its last value inside `log`.
+fn build_index(log: &[u8]) -> LogIndex {
+    let mut index = HashMap::new();
+    let mut records = 0;
+    let mut offset = HEADER_SIZE;
+    let mut truncated = false;
+
+    while offset < log.len() {
+        let payload = match next_payload(log, offset) {
+            Some(payload) => payload,
+            None => {
+                truncated = true;
+                break;
+            }
+        };
+        let mut reader = Reader {
+            data: log,
+            position: offset + LENGTH_SIZE,
+        };
+        offset += LENGTH_SIZE + payload.len();
+
+        let indexed = match reader.u32() {
+            Some(RECORD_SNAPSHOT) => {
+                index.clear();
+                reader.length().and_then(|len| {
+                    for _ in 0..len {
+                        let key = reader.string()?;
+                        index.insert(key.to_owned(), reader.skip_value()?);
+                    }
+                    Some(())
+                })
+            }
+            Some(RECORD_PUT) => reader.string().and_then(|key| {
+                index.insert(key.to_owned(), reader.skip_value()?);
+                Some(())
+            }),
+            Some(RECORD_CLEAR) => {
+                index.clear();
+                Some(())
+            }
+            _ => None,
+        };
+
+        if indexed.is_none() || reader.position != offset {
+            truncated = true;
+            break;
+        }
+        records += 1;
+    }
+
+    LogIndex {
+        positions: index,
+        records,
+        truncated,
+    }
+}
+
+/// Changes not yet wrote to the log.
+#[derive(Default)]
+struct Changes {
+    /// Tells if the preferences have been cleared.
+    cleared: bool,
+    /// Keys of the values changed after the last save or clear.
+    dirty: HashSet<String>,
+    /// Number of records into the log.
+    records: usize,
+    /// Tells if the log must be rewrote, because it don't exist yet or it ends with a
+    /// corrupted record.
+    rewrite: bool,
+    /// Tells if the log must be unmapped before being rewrote, see [LazyPreferences::unmap].
+    unmap: bool,
+}
+
+/// Preferences set whose values are loaded on demand from a memory mapped log.
+pub struct LazyPreferences {
+    name: String,
+    map: Option<Mmap>,
+    /// Position of the last value of each key inside `map`.
+    index: HashMap<String, usize>,
+    /// Tells if the values inside `map` have been cleared.
+    cleared: bool,
+    /// Values changed after the log has been mapped.
+    values: HashMap<String, Value>,
+    changes: Mutex<Changes>,
+}
+
+impl LazyPreferences {
+    /// Opens the preferences set with the provided `name` building only the index of its keys.
+    /// If the preferences set don't exist it will be created on the first save.
+    ///
+    /// * `name` - The preferences name, can contains only ascii alphanumeric chars or -, _.
+    ///
+    /// # Errors
+    /// This function can return the following errors:
+    /// * [PreferencesError::InvalidName] if the provided name contains non ascii alphanumeric chars
+    /// * [PreferencesError::DeserializationError] if the data inside the disc is not a not
+    /// encrypted log.
+    /// * [PreferencesError::IO] if an error occurred while mapping the data from the device storage.
+    pub fn new(name: &str) -> Result<LazyPreferences> {
+        let mut preferences = LazyPreferences {
+            name: name.to_owned(),
+            map: None,
+            index: HashMap::new(),
+            cleared: false,
+            values: HashMap::new(),
+            changes: Mutex::new(Changes::default()),
+        };
+
+        let map = match io::map_bytes(name) {
+            Ok(map) => map,
+            Err(IoError::EmptyData) => {
+                preferences.changes.get_mut().unwrap().rewrite = true;
+                return Ok(preferences);
+            }
+            Err(IoError::InvalidName(s)) => return Err(PreferencesError::InvalidName(s)),
+            Err(e) => return Err(PreferencesError::IO(e)),
+        };
+
+        if !has_log_header(&map, FLAG_PLAIN) {
+            return Err(PreferencesError::DeserializationError);
+        }
+
+        let index = build_index(&map);
+        preferences.index = index.positions;
+        preferences.map = Some(map);
+        let changes = preferences.changes.get_mut().unwrap();
+        changes.records = index.records;
+        changes.rewrite = index.truncated;
+        if index.truncated && cfg!(windows) {
+            preferences.unmap();
+        }
+        Ok(preferences)
+    }
+
+    /// Decodes all the values from the log and unmaps it, so that it can be replaced on Windows.
+    fn unmap(&mut self) {
+        let map = match self.map.take() {
+            Some(map) => map,
+            None => return,
+        };
+
+        for (key, position) in self.index.drain() {
+            if self.cleared || self.values.contains_key(&key) {
+                continue;
+            }
+            if let Ok(value) = bincode::deserialize(&map[position..]) {
+                self.values.insert(key, value);
+            }
+        }
+        self.changes.get_mut().unwrap().unmap = false;
+    }
+
+    /// Tells if the log can't be rewrote because it's mapped on Windows.
+    fn is_locked(&self) -> bool {
+        cfg!(windows) && self.map.is_some()
+    }
+
+    /// Gets the value associated to `key`, decoding it from the log if not changed.
+    fn value(&self, key: &str) -> Option<Cow<Value>> {
+        if let Some(value) = self.values.get(key) {
+            return Some(Cow::Borrowed(value));
+        }
+        if self.cleared {
+            return None;
+        }
+
+        let position = *self.index.get(key)?;
+        let map = self.map.as_ref()?;
+        bincode::deserialize(&map[position..]).ok().map(Cow::Owned)
+    }
+
+    /// Gets the bytes of the string or binary value associated to `key` directly from the log.
+    ///
+    /// * `variant` - the variant of the requested value, [VALUE_STRING] or [VALUE_BIN].
+    fn mapped_bytes(&self, key: &str, variant: u32) -> Option<&[u8]> {
+        let mut reader = Reader {
+            data: self.map.as_ref()?,
+            position: *self.index.get(key)?,
+        };
+        if reader.u32()? != variant {
+            return None;
+        }
+        let len = reader.length()?;
+        reader.bytes(len)
+    }
+
+    fn put(&mut self, key: &str, value: Value) -> Result<()> {
+        if self.changes.get_mut().unwrap().unmap {
+            self.unmap();
+        }
+
+        let changes = self.changes.get_mut().unwrap();
+        if !changes.dirty.contains(key) {
+            changes.dirty.insert(key.to_owned());
+        }
+        self.values.insert(key.to_owned(), value);
+        Ok(())
+    }
+
+    /// Rewrites the log with a single snapshot of all the values.
+    fn rewrite(&self) -> Result<()> {
+        let mut snapshot = HashMap::with_capacity(self.index.len() + self.values.len());
+        if !self.cleared {
+            for key in self.index.keys() {
+                if let Some(value) = self.value(key) {
+                    snapshot.insert(key.to_owned(), value.into_owned());
+                }
+            }
+        }
+        for (key, value) in self.values.iter() {
+            snapshot.insert(key.to_owned(), value.clone());
+        }
+
+        let mut log = log_header(FLAG_PLAIN);
+        Codec::Plain.encode(&RecordRef::Snapshot(&snapshot), &mut log)?;
+        io::save_bytes(&self.name, &log)?;
+        Ok(())
+    }
+
+    /// Appends the pending changes to the log.
+    fn append(&self, changes: &mut Changes) -> Result<()> {
+        let mut records = Vec::new();
+        let mut count = 0;
+        if changes.cleared {
+            Codec::Plain.encode(&RecordRef::Clear, &mut records)?;
+            count += 1;
+        }
+        for key in changes.dirty.iter() {
+            if let Some(value) = self.values.get(key) {
+                Codec::Plain.encode(&RecordRef::Put(key, value), &mut records)?;
+                count += 1;
+            }
+        }
+
+        // A failed append can leave a partial record at the end of the log, so it's rewrote
+        // on the next save unless the append succeeds.
+        changes.rewrite = true;
+        io::append_bytes(&self.name, &records)?;
+        changes.rewrite = false;
+        changes.records += count;
+        Ok(())
+    }
+}
+
+impl Preferences for LazyPreferences {
+    fn get_i32(&self, key: &str) -> Option<i32> {
+        self.value(key).and_then(|v| match v.as_ref() {
+            Value::I32(i32) => Some(i32.to_owned()),
+            _ => None,
+        })
+    }
+
+    fn put_i32(&mut self, key: &str, value: i32) -> Result<()> {
+        self.put(key, Value::I32(value))
+    }
+
+    fn get_str(&self, key: &str) -> Option<String> {
+        self.get_str_ref(key).map(Cow::into_owned)
+    }
+
+    fn get_str_ref(&self, key: &str) -> Option<Cow<str>> {
+        if let Some(value) = self.values.get(key) {
+            return match value {
+                Value::String(string) => Some(Cow::Borrowed(string.as_str())),
+                _ => None,
+            };
+        }
+        if self.cleared {
+            return None;
+        }
+
+        self.mapped_bytes(key, VALUE_STRING)
+            .and_then(|bytes| std::str::from_utf8(bytes).ok())
+            .map(Cow::Borrowed)
+    }
+
+    fn put_str(&mut self, key: &str, value: String) -> Result<()> {
+        self.put(key, Value::String(value))
+    }
+
+    fn get_bool(&self, key: &str) -> Option<bool> {
+        self.value(key).and_then(|v| match v.as_ref() {
+            Value::Bool(bool) => Some(bool.to_owned()),
+            _ => None,
+        })
+    }
+
+    fn put_bool(&mut self, key: &str, value: bool) -> Result<()> {
+        self.put(key, Value::Bool(value))
+    }
+
+    fn get_bytes(&self, key: &str) -> Option<Vec<u8>> {
+        self.get_bytes_ref(key).map(Cow::into_owned)
+    }
+
+    fn get_bytes_ref(&self, key: &str) -> Option<Cow<[u8]>> {
+        if let Some(value) = self.values.get(key) {
+            return match value {
+                Value::Bin(bin) => Some(Cow::Borrowed(bin.as_slice())),
+                _ => None,
+            };
+        }
+        if self.cleared {
+            return None;
+        }
+
+        self.mapped_bytes(key, VALUE_BIN).map(Cow::Borrowed)
+    }
+
+    fn put_bytes(&mut self, key: &str, value: Vec<u8>) -> Result<()> {
+        self.put(key, Value::Bin(value))
+    }
+
+    fn clear(&mut self) {
+        if self.changes.get_mut().unwrap().unmap {
+            self.unmap();
+        }
+
+        let changes = self.changes.get_mut().unwrap();
+        changes.cleared = true;
+        changes.dirty.clear();
+        self.cleared = true;
+        self.values.clear();
+    }
+
+    fn erase(&mut self) {
+        self.map = None;
+        self.index.clear();
+        self.cleared = false;
+        self.values.clear();
+        *self.changes.get_mut().unwrap() = Changes {
+            rewrite: true,
+            ..Default::default()
+        };
+        io::erase(&self.name);
+    }
+
+    fn save(&self) -> Result<()> {
+        let mut changes = self.changes.lock().unwrap();
+        if !changes.rewrite && !changes.cleared && changes.dirty.is_empty() {
+            return Ok(());
+        }
+
+        // Compact when the most of the records are stale.
+        let records = changes.records + changes.dirty.len();
+        let values = if self.cleared { 0 } else { self.index.len() } + self.values.len();
+        let compact = records > COMPACTION_MIN_RECORDS.max(values * 2);
+        if (changes.rewrite || compact) && self.is_locked() {
+            // The mapped log can't be replaced, it's unmapped from the next change.
+            changes.unmap = true;
+            if changes.rewrite {
+                return Err(PreferencesError::IO(IoError::Unsupported(
+                    "rewrite of a mapped log".to_owned(),
+                )));
+            }
+            self.append(&mut changes)?;
+        } else if changes.rewrite || compact {
+            self.rewrite()?;
+            changes.records = 1;
+        } else {
+            self.append(&mut changes)?;
+        }
+
+        changes.cleared = false;
+        changes.dirty.clear();
+        changes.rewrite = false;
+        Ok(())
+    }
+}
+
+#[cfg(test)]
+mod test {
+    use crate::io;
+    use crate::journal::{JournalPreferences, COMPACTION_MIN_RECORDS};
+    use crate::lazy::LazyPreferences;
+    use crate::preferences::Preferences;
+    use std::borrow::Cow;
+
+    #[test]
+    pub fn test_lazy_read() {
+        let set_name = "lazy-read";
+        let test_vec: Vec<u8> = vec![12, 13, 54, 42];
+
+        let mut journal = JournalPreferences::new(set_name).unwrap();
+        journal.put_i32("i32", 42).unwrap();
+        journal.put_str("str", "str".to_owned()).unwrap();
+        journal.save().unwrap();
+        journal.put_bool("bool", true).unwrap();
+        journal.put_bytes("bin", test_vec.clone()).unwrap();
+        journal.put_i32("i32", 43).unwrap();
+        journal.save().unwrap();
+
+        let preferences = LazyPreferences::new(set_name).unwrap();
+        let i32_result = preferences.get_i32("i32");
+        let str_result = preferences.get_str("str");
+        let bool_result = preferences.get_bool("bool");
+        let binary_result = preferences.get_bytes("bin");
+        let wrong_type = preferences.get_bool("i32");
+        let borrowed = matches!(preferences.get_bytes_ref("bin"), Some(Cow::Borrowed(_)));
+        let missing = preferences.get_i32("missing");
+
+        journal.erase();
+        assert_eq!(Some(43), i32_result);
+        assert_eq!(Some("str".to_owned()), str_result);
+        assert_eq!(Some(true), bool_result);
+        assert_eq!(Some(test_vec), binary_result);
+        assert_eq!(None, wrong_type);
+        assert!(borrowed);
+        assert_eq!(None, missing);
+    }
+
+    #[test]
+    pub fn test_lazy_write() {
+        let set_name = "lazy-write";
+
+        let mut preferences = LazyPreferences::new(set_name).unwrap();
+        preferences.put_i32("i32", 42).unwrap();
+        preferences.put_str("str", "str".to_owned()).unwrap();
+        preferences.save().unwrap();
+
+        let mut preferences = LazyPreferences::new(set_name).unwrap();
+        assert_eq!(Some(42), preferences.get_i32("i32"));
+        preferences.put_i32("i32", 43).unwrap();
+        preferences.save().unwrap();
+        preferences.clear();
+        preferences.put_bool("bool", true).unwrap();
+        preferences.save().unwrap();
+
+        // The log is readable from the journal preferences too
+        let mut journal = JournalPreferences::new(set_name).unwrap();
+        let i32_result = journal.get_i32("i32");
+        let bool_result = journal.get_bool("bool");
+        journal.erase();
+        assert_eq!(None, i32_result);
+        assert_eq!(Some(true), bool_result);
+    }
+
+    #[test]
+    pub fn test_lazy_compaction() {
+        let set_name = "lazy-compaction";
+
+        let mut preferences = LazyPreferences::new(set_name).unwrap();
+        for i in 0..COMPACTION_MIN_RECORDS * 2 {
+            preferences.put_i32("i32", i as i32).unwrap();
+            preferences.save().unwrap();
+        }
+        let records = preferences.changes.lock().unwrap().records;
+        let size = io::load_bytes(set_name).unwrap().len();
+
+        let mut preferences = LazyPreferences::new(set_name).unwrap();
+        let result = preferences.get_i32("i32");
+        preferences.erase();
+        assert!(records <= COMPACTION_MIN_RECORDS);
+        assert!(size < COMPACTION_MIN_RECORDS * 32);
+        assert_eq!(Some(COMPACTION_MIN_RECORDS as i32 * 2 - 1), result);
+    }
+
+    #[test]
+    pub fn test_mapped_log_compaction() {
+        let set_name = "lazy-mapped-compaction";
+
+        let mut preferences = LazyPreferences::new(set_name).unwrap();
+        preferences.put_str("str", "str".to_owned()).unwrap();
+        preferences.save().unwrap();
+
+        // Compacts the log while it's mapped
+        let mut preferences = LazyPreferences::new(set_name).unwrap();
+        assert!(preferences.map.is_some());
+        for i in 0..COMPACTION_MIN_RECORDS * 2 {
+            preferences.put_i32("i32", i as i32).unwrap();
+            preferences.save().unwrap();
+        }
+        let records = preferences.changes.lock().unwrap().records;
+        let str_result = preferences.get_str("str");
+
+        let mut preferences = LazyPreferences::new(set_name).unwrap();
+        let i32_result = preferences.get_i32("i32");
+        let reopened_str = preferences.get_str("str");
+        preferences.erase();
+        assert!(records <= COMPACTION_MIN_RECORDS);
+        assert_eq!(Some("str".to_owned()), str_result);
+        assert_eq!(Some("str".to_owned()), reopened_str);
+        assert_eq!(Some(COMPACTION_MIN_RECORDS as i32 * 2 - 1), i32_result);
+    }
+
+    #[test]
+    pub fn test_unmap() {
+        let set_name = "lazy-unmap";
+
+        let mut preferences = LazyPreferences::new(set_name).unwrap();
+        preferences.put_str("str", "str".to_owned()).unwrap();
+        preferences.put_i32("i32", 42).unwrap();
+        preferences.save().unwrap();
+
+        // Simulates a compaction requested while the log is mapped on Windows
+        let mut preferences = LazyPreferences::new(set_name).unwrap();
+        preferences.changes.get_mut().unwrap().unmap = true;
+        preferences.put_bool("bool", true).unwrap();
+        assert!(preferences.map.is_none());
+        preferences.changes.get_mut().unwrap().rewrite = true;
+        preferences.save().unwrap();
+
+        let mut preferences = LazyPreferences::new(set_name).unwrap();
+        let str_result = preferences.get_str("str");
+        let i32_result = preferences.get_i32("i32");
+        let bool_result = preferences.get_bool("bool");
+        let records = preferences.changes.lock().unwrap().records;
+        preferences.erase();
+        assert_eq!(Some("str".to_owned()), str_result);
+        assert_eq!(Some(42), i32_result);
+        assert_eq!(Some(true), bool_result);
+        assert_eq!(1, records);
+    }
+
+    #[test]
+    pub fn test_truncated_log() {
+        let set_name = "lazy-truncated";
+
+        let mut preferences = LazyPreferences::new(set_name).unwrap();
+        preferences.put_i32("i32", 42).unwrap();
+        preferences.save().unwrap();
+        io::append_bytes(set_name, &[30, 0, 0, 0, 1]).unwrap();
+
+        let mut preferences = LazyPreferences::new(set_name).unwrap();
+        assert_eq!(Some(42), preferences.get_i32("i32"));
+        preferences.put_bool("bool", true).unwrap();
+        preferences.save().unwrap();
+
+        let mut preferences = LazyPreferences::new(set_name).unwrap();
+        let i32_result = preferences.get_i32("i32");
+        let bool_result = preferences.get_bool("bool");
+        preferences.erase();
+        assert_eq!(Some(42), i32_result);
+        assert_eq!(Some(true), bool_result);
+    }
+
+    #[test]
+    pub fn test_encrypted_log() {
+        let set_name = "lazy-encrypted";
+
+        let mut journal = JournalPreferences::new_encrypted("password", set_name).unwrap();
+        journal.put_i32("i32", 42).unwrap();
+        journal.save().unwrap();
+
+        let result = LazyPreferences::new(set_name);
+        journal.erase();
+        assert!(result.is_err());
+    }
+}
@@ -14,10 +14,23 @@ extern crate cfg_if;
 #[macro_use]
 extern crate ffi_helpers;
 
+// The timed! macros record the measures only when built with the `metrics` feature.
+#[macro_use]
+extern crate crw_metrics;
+
+mod cipher;
+#[cfg(not(target_arch = "wasm32"))]
+pub mod debounced;
 pub mod encrypted;
 mod io;
+pub mod journal;
+#[cfg(not(target_arch = "wasm32"))]
+pub mod lazy;
 pub mod preferences;
+#[cfg(not(target_arch = "wasm32"))]
+pub mod shared;
 pub mod unencrypted;
+mod value;
 
 #[cfg(all(target_arch = "wasm32", target_os = "unknown", feature = "js",))]
 pub mod wasm;
@@ -1,8 +1,13 @@
 //! Module that provides the generic trait to store and load preferences from the device storage.
 
+#[cfg(not(target_arch = "wasm32"))]
+use crate::debounced::DebouncedPreferences;
 use crate::io;
 use crate::io::IoError;
+use std::borrow::Cow;
 use std::result;
+#[cfg(not(target_arch = "wasm32"))]
+use std::time::Duration;
 use thiserror::Error;
 
 #[cfg(not(target_arch = "wasm32"))]
@@ -10,6 +15,9 @@ pub use crate::io::set_preferences_app_dir;
 
 pub type Result<T> = result::Result<T, PreferencesError>;
 
+/// A save whose data have already been serialized, see [Preferences::prepare_save].
+pub type PendingSave = Box<dyn FnOnce() -> Result<()> + Send>;
+
 #[derive(Error, Debug)]
 pub enum PreferencesError {
     #[error("invalid preference name `{0}`")]
@@ -40,6 +48,14 @@ pub trait Preferences {
     /// * `key` - name of the preference that will be loaded.
     fn get_str(&self, key: &str) -> Option<String>;
 
+    /// Gets a string from the preferences borrowing it when the value is stored as a string,
+    /// without cloning it.
+    ///
+    /// * `key` - name of the preference that will be loaded.
+    fn get_str_ref(&self, key: &str) -> Option<Cow<str>> {
+        self.get_str(key).map(Cow::Owned)
+    }
+
     /// Store a string into the preferences.
     ///
     /// * `key` - The name of the preference that will be stored.
@@ -62,6 +78,14 @@ pub trait Preferences {
     /// * `key` - name of the preference that will be loaded.
     fn get_bytes(&self, key: &str) -> Option<Vec<u8>>;
 
+    /// Gets an array of bytes from the preferences borrowing it when the value is stored as an
+    /// array of bytes, without cloning it.
+    ///
+    /// * `key` - name of the preference that will be loaded.
+    fn get_bytes_ref(&self, key: &str) -> Option<Cow<[u8]>> {
+        self.get_bytes(key).map(Cow::Owned)
+    }
+
     /// Store an array of bytes into the preferences.
     ///
     /// * `key` - The name of the preference that will be stored.
@@ -77,6 +101,24 @@ pub trait Preferences {
 
     /// Saves the preferences into the device disk.
     fn save(&self) -> Result<()>;
+
+    /// Serializes the preferences and returns the function that writes them into the device
+    /// storage, so that the write can be performed without accessing the preferences.
+    /// Returns [None] if the preferences can be wrote only with [save](Self::save).
+    fn prepare_save(&self) -> Option<Result<PendingSave>> {
+        None
+    }
+
+    /// Wraps the preferences into a [DebouncedPreferences] whose [save](Preferences::save)
+    /// coalesces all the saves requested within `window` into a single write performed from
+    /// a background thread.
+    #[cfg(not(target_arch = "wasm32"))]
+    fn debounced(self, window: Duration) -> DebouncedPreferences<Self>
+    where
+        Self: Sized + Send + 'static,
+    {
+        DebouncedPreferences::new(self, window)
+    }
 }
 
 /// Deletes a preferences set from the device storage
@@ -0,0 +1,315 @@
+//! Module that provides a thread safe handle to a preferences set shared between all the users
+//! that open it.
+//!
+//! All the [SharedPreferences] opened with the same name refer to a single in-memory
+//! preferences set, so the data are loaded from the device storage only once and the saves
+//! don't race each other.
+//! The reads are performed concurrently while the writes are serialized through a
+//! [RwLock].
+
+use crate::cipher::CipherError;
+use crate::encrypted::{EncryptedPreferences, EncryptedPreferencesError};
+use crate::preferences::{Preferences, PreferencesError, Result};
+use once_cell::sync::Lazy;
+use sha2::{Digest, Sha256};
+use std::collections::HashMap;
+use std::result::Result as StdResult;
+use std::sync::{Arc, Mutex, RwLock, RwLockReadGuard, RwLockWriteGuard, Weak};
+
+use subtle::ConstantTimeEq;
+
+type SyncPreferences = Box<dyn Preferences + Send + Sync>;
+
+const PASSWORD_SALT_SIZE: usize = 16;
+
+/// Salted hash of the password used to open an encrypted set, used to check the password of
+/// the following openings without deriving the key again.
+struct PasswordCheck {
+    salt: [u8; PASSWORD_SALT_SIZE],
+    hash: [u8; 32],
+}
+
+impl PasswordCheck {
+    /// Creates the check of `password` with a random salt.
+    ///
+    /// # Errors
+    /// Returns [CipherError::Random] if the random salt can't be generated.
+    fn new(password: &str) -> StdResult<PasswordCheck, CipherError> {
+        let mut salt = [0u8; PASSWORD_SALT_SIZE];
+        getrandom::getrandom(&mut salt).map_err(|_| CipherError::Random)?;
+        let hash = PasswordCheck::hash(&salt, password);
+
+        Ok(PasswordCheck { salt, hash })
+    }
+
+    fn hash(salt: &[u8], password: &str) -> [u8; 32] {
+        Sha256::new()
+            .chain(salt)
+            .chain(password.as_bytes())
+            .finalize()
+            .into()
+    }
+
+    /// Tells if `password` is the checked one, comparing the hashes in constant time.
+    fn matches(&self, password: &str) -> bool {
+        let hash = PasswordCheck::hash(&self.salt, password);
+        self.hash[..].ct_eq(&hash[..]).into()
+    }
+}
+
+/// A preferences set shared between multiple handles.
+struct Instance {
+    preferences: RwLock<SyncPreferences>,
+    /// Serializes the saves without blocking the readers.
+    save_lock: Mutex<()>,
+    /// Check of the password used to open an encrypted set, [None] if the set is not encrypted.
+    password_check: Option<PasswordCheck>,
+}
+
+/// Global registry of the opened preferences sets.
+static INSTANCES: Lazy<Mutex<HashMap<String, Weak<Instance>>>> =
+    Lazy::new(|| Mutex::new(HashMap::new()));
+
+/// Thread safe handle to a preferences set shared between all the handles opened with the same
+/// name, the preferences set is released when all its handles are dropped.
+#[derive(Clone)]
+pub struct SharedPreferences {
+    instance: Arc<Instance>,
+}
+
+impl SharedPreferences {
+    /// Gets the preferences set with the provided `name` if already opened, otherwise opens it
+    /// with `open`.
+    /// Since the opened sets are identified only by their name, the handles opened after the
+    /// first one refer to the set it opened regardless of `open`, use
+    /// [open_encrypted](Self::open_encrypted) for the encrypted sets so that the password is
+    /// checked on each opening.
+    ///
+    /// * `name` - The preferences name.
+    /// * `open` - Function that opens the preferences set if it's not already opened.
+    ///
+    /// # Errors
+    /// This function returns [PreferencesError::DeserializationError] if the set is already
+    /// opened with [open_encrypted](Self::open_encrypted), otherwise the error of `open`.
+    ///
+    /// # Example
+    /// ```no_run
+    /// use crw_preferences::shared::SharedPreferences;
+    /// use crw_preferences::unencrypted::UnencryptedPreferences;
+    ///
+    /// let preferences = SharedPreferences::open("shared", UnencryptedPreferences::new);
+    /// ```
+    pub fn open<P, E, F>(name: &str, open: F) -> StdResult<SharedPreferences, E>
+    where
+        P: Preferences + Send + Sync + 'static,
+        E: From<PreferencesError>,
+        F: FnOnce(&str) -> StdResult<P, E>,
+    {
+        SharedPreferences::open_instance(
+            name,
+            |password_check| match password_check {
+                // The encrypted sets can be accessed only with their password
+                Some(_) => Err(E::from(PreferencesError::DeserializationError)),
+                None => Ok(()),
+            },
+            |name| {
+                let preferences: SyncPreferences = Box::new(open(name)?);
+                Ok((preferences, None))
+            },
+        )
+    }
+
+    /// Gets the encrypted preferences set with the provided `name` if already opened, otherwise
+    /// opens it with [EncryptedPreferences::new].
+    ///
+    /// * `password` - the password used to decrypt the preferences set.
+    /// * `name` - The preferences name, can contains only ascii alphanumeric chars or -, _.
+    ///
+    /// # Errors
+    /// This function returns [EncryptedPreferencesError::DecryptionFailed] if the set is already
+    /// opened with a different password or not encrypted, otherwise the errors of
+    /// [EncryptedPreferences::new].
+    pub fn open_encrypted(
+        password: &str,
+        name: &str,
+    ) -> StdResult<SharedPreferences, EncryptedPreferencesError> {
+        SharedPreferences::open_instance(
+            name,
+            |password_check| match password_check {
+                Some(password_check) if password_check.matches(password) => Ok(()),
+                _ => Err(EncryptedPreferencesError::DecryptionFailed),
+            },
+            |name| {
+                let password_check = PasswordCheck::new(password)?;
+                let preferences: SyncPreferences =
+                    Box::new(EncryptedPreferences::new(password, name)?);
+                Ok((preferences, Some(password_check)))
+            },
+        )
+    }
+
+    /// Gets the opened preferences set with the provided `name` if `check` accepts its password
+    /// check, otherwise opens it with `open`.
+    fn open_instance<E, C, F>(name: &str, check: C, open: F) -> StdResult<SharedPreferences, E>
+    where
+        C: FnOnce(Option<&PasswordCheck>) -> StdResult<(), E>,
+        F: FnOnce(&str) -> StdResult<(SyncPreferences, Option<PasswordCheck>), E>,
+    {
+        let mut instances = INSTANCES.lock().unwrap();
+        if let Some(instance) = instances.get(name).and_then(Weak::upgrade) {
+            check(instance.password_check.as_ref())?;
+            return Ok(SharedPreferences { instance });
+        }
+
+        let (preferences, password_check) = open(name)?;
+        let instance = Arc::new(Instance {
+            preferences: RwLock::new(preferences),
+            save_lock: Mutex::new(()),
+            password_check,
+        });
+        // Drop the sets that have been released.
+        instances.retain(|_, instance| instance.strong_count() > 0);
+        instances.insert(name.to_owned(), Arc::downgrade(&instance));
+
+        Ok(SharedPreferences { instance })
+    }
+
+    /// Locks the preferences set for reading, the other readers can access it concurrently.
+    pub fn read(&self) -> RwLockReadGuard<SyncPreferences> {
+        self.instance.preferences.read().unwrap()
+    }
+
+    /// Locks the preferences set for writing.
+    pub fn write(&self) -> RwLockWriteGuard<SyncPreferences> {
+        self.instance.preferences.write().unwrap()
+    }
+}
+
+impl Preferences for SharedPreferences {
+    fn get_i32(&self, key: &str) -> Option<i32> {
+        self.read().get_i32(key)
+    }
+
+    fn put_i32(&mut self, key: &str, value: i32) -> Result<()> {
+        self.write().put_i32(key, value)
+    }
+
+    fn get_str(&self, key: &str) -> Option<String> {
+        self.read().get_str(key)
+    }
+
+    fn put_str(&mut self, key: &str, value: String) -> Result<()> {
+        self.write().put_str(key, value)
+    }
+
+    fn get_bool(&self, key: &str) -> Option<bool> {
+        self.read().get_bool(key)
+    }
+
+    fn put_bool(&mut self, key: &str, value: bool) -> Result<()> {
+        self.write().put_bool(key, value)
+    }
+
+    fn get_bytes(&self, key: &str) -> Option<Vec<u8>> {
+        self.read().get_bytes(key)
+    }
+
+    fn put_bytes(&mut self, key: &str, value: Vec<u8>) -> Result<()> {
+        self.write().put_bytes(key, value)
+    }
+
+    fn clear(&mut self) {
+        self.write().clear()
+    }
+
+    fn erase(&mut self) {
+        self.write().erase()
+    }
+
+    fn save(&self) -> Result<()> {
+        let _save = self.instance.save_lock.lock().unwrap();
+        self.read().save()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use crate::encrypted::EncryptedPreferencesError;
+    use crate::preferences::{Preferences, PreferencesError};
+    use crate::shared::SharedPreferences;
+    use crate::unencrypted::UnencryptedPreferences;
+    use std::sync::Arc;
+    use std::thread;
+
+    #[test]
+    pub fn test_same_instance() {
+        let set_name = "shared-same";
+        let mut first = SharedPreferences::open(set_name, UnencryptedPreferences::new).unwrap();
+        let second = SharedPreferences::open(set_name, UnencryptedPreferences::new).unwrap();
+
+        first.put_i32("i32", 42).unwrap();
+        assert_eq!(Some(42), second.get_i32("i32"));
+        assert!(Arc::ptr_eq(&first.instance, &second.instance));
+
+        first.erase();
+        drop(first);
+        drop(second);
+
+        // The released sets are opened again
+        let mut third = SharedPreferences::open(set_name, UnencryptedPreferences::new).unwrap();
+        assert_eq!(None, third.get_i32("i32"));
+        third.erase();
+    }
+
+    #[test]
+    pub fn test_encrypted_password_check() {
+        let set_name = "shared-encrypted";
+        let mut first = SharedPreferences::open_encrypted("password", set_name).unwrap();
+        first.put_i32("i32", 42).unwrap();
+
+        let second = SharedPreferences::open_encrypted("password", set_name).unwrap();
+        let wrong = SharedPreferences::open_encrypted("wrong", set_name);
+        let unencrypted = SharedPreferences::open(set_name, UnencryptedPreferences::new);
+        let result = second.get_i32("i32");
+        first.erase();
+
+        assert_eq!(Some(42), result);
+        assert!(matches!(
+            wrong.err().unwrap(),
+            EncryptedPreferencesError::DecryptionFailed
+        ));
+        assert!(matches!(
+            unencrypted.err().unwrap(),
+            PreferencesError::DeserializationError
+        ));
+    }
+
+    #[test]
+    pub fn test_concurrent_access() {
+        let set_name = "shared-concurrent";
+        let preferences = SharedPreferences::open(set_name, UnencryptedPreferences::new).unwrap();
+
+        let writers: Vec<_> = (0..4)
+            .map(|i| {
+                let mut preferences = preferences.clone();
+                thread::spawn(move || {
+                    for j in 0..100 {
+                        preferences.put_i32(&format!("key{}", i), j).unwrap();
+                        preferences.get_i32(&format!("key{}", (i + 1) % 4));
+                    }
+                    preferences.save().unwrap();
+                })
+            })
+            .collect();
+        for writer in writers {
+            writer.join().unwrap();
+        }
+
+        let mut preferences = preferences;
+        let values: Vec<_> = (0..4)
+            .map(|i| preferences.get_i32(&format!("key{}", i)))
+            .collect();
+        preferences.erase();
+        assert_eq!(vec![Some(99); 4], values);
+    }
+}
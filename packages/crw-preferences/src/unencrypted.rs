@@ -3,8 +3,9 @@
 
 use crate::io;
 use crate::io::IoError;
-use crate::preferences::{Preferences, PreferencesError, Result};
+use crate::preferences::{PendingSave, Preferences, PreferencesError, Result};
 use serde_json::{Map, Value};
+use std::borrow::Cow;
 
 pub struct UnencryptedPreferences {
     name: String,
@@ -32,8 +33,15 @@ impl UnencryptedPreferences {
             };
         }
 
-        serde_json::from_str(&disk_data.unwrap())
-            .map_err(|_| PreferencesError::DeserializationError)
+        UnencryptedPreferences::decode(disk_data.unwrap().as_bytes())
+    }
+
+    /// Deserializes the json preferences.
+    ///
+    /// # Errors
+    /// This function returns [PreferencesError::DeserializationError] if the data is not valid.
+    fn decode(data: &[u8]) -> Result<Map<String, Value>> {
+        serde_json::from_slice(data).map_err(|_| PreferencesError::DeserializationError)
     }
 
     /// Writes the data as json to the device storage.
@@ -71,6 +79,36 @@ impl UnencryptedPreferences {
             data,
         })
     }
+
+    /// Creates a preferences set from the data loaded from a storage other than the default one.
+    ///
+    /// * `name` - The preferences set name.
+    /// * `data` - The stored json data, [None] if the preferences set don't exist yet.
+    ///
+    /// # Errors
+    /// This function returns [PreferencesError::DeserializationError] if the data is not valid.
+    #[cfg_attr(not(all(target_arch = "wasm32", feature = "js")), allow(dead_code))]
+    pub(crate) fn from_bytes(name: &str, data: Option<&[u8]>) -> Result<UnencryptedPreferences> {
+        let data = match data {
+            Some(data) => UnencryptedPreferences::decode(data)?,
+            None => Map::new(),
+        };
+
+        Ok(UnencryptedPreferences {
+            name: name.to_owned(),
+            data,
+        })
+    }
+
+    /// Serializes the preferences set as json.
+    ///
+    /// # Errors
+    /// This function returns [PreferencesError::SerializationError] if the data can't be
+    /// serialized.
+    #[cfg_attr(not(all(target_arch = "wasm32", feature = "js")), allow(dead_code))]
+    pub(crate) fn to_bytes(&self) -> Result<Vec<u8>> {
+        serde_json::to_vec(&self.data).map_err(|_| PreferencesError::SerializationError)
+    }
 }
 
 impl Preferences for UnencryptedPreferences {
@@ -97,6 +135,13 @@ impl Preferences for UnencryptedPreferences {
             .and_then(|v| v.as_str().map(|s| s.to_owned()))
     }
 
+    fn get_str_ref(&self, key: &str) -> Option<Cow<str>> {
+        self.data
+            .get(key)
+            .and_then(|v| v.as_str())
+            .map(Cow::Borrowed)
+    }
+
     fn put_str(&mut self, key: &str, value: String) -> Result<()> {
         self.data.insert(key.to_owned(), Value::from(value));
         Ok(())
@@ -140,6 +185,19 @@ impl Preferences for UnencryptedPreferences {
     fn save(&self) -> Result<()> {
         UnencryptedPreferences::write_to_disk(&self.name, &self.data)
     }
+
+    fn prepare_save(&self) -> Option<Result<PendingSave>> {
+        let name = self.name.clone();
+        let json = match serde_json::to_string(&self.data) {
+            Ok(json) => json,
+            Err(_) => return Some(Err(PreferencesError::SerializationError)),
+        };
+
+        Some(Ok(Box::new(move || {
+            io::save(&name, &json)?;
+            Ok(())
+        })))
+    }
 }
 
 #[cfg(test)]
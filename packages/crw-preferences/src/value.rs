@@ -0,0 +1,12 @@
+//! Module that provides the representation of the values stored into the binary preferences sets.
+
+use serde::{Deserialize, Serialize};
+
+/// A value stored into a preferences set serialized with bincode.
+#[derive(Serialize, Deserialize, Debug, Clone, PartialEq)]
+pub(crate) enum Value {
+    I32(i32),
+    Bool(bool),
+    String(String),
+    Bin(Vec<u8>),
+}
@@ -1,16 +1,49 @@
 //! Module that provides a wrapper to expose a [Preferences] to a js application.
+//!
+//! The preferences sets opened with [preferences] and [encrypted_preferences] are stored into the
+//! browser `LocalStorage`, while the ones opened with [preferences_async] and
+//! [encrypted_preferences_async] are stored into the browser `IndexedDB` and must be saved with
+//! [PreferencesWrapper::save_async].
 
 extern crate bindgen as wasm_bindgen;
 
 use crate::encrypted::{EncryptedPreferences, EncryptedPreferencesError};
+use crate::io::{idb, IoError};
 use crate::preferences;
 use crate::preferences::{Preferences, PreferencesError};
 use crate::unencrypted::UnencryptedPreferences;
+use js_sys::Promise;
 use wasm_bindgen::prelude::*;
+use wasm_bindgen_futures::{future_to_promise, spawn_local};
+
+/// A [Preferences] that can be serialized to be saved into a storage other than the default one.
+trait StoredPreferences: Preferences {
+    fn to_bytes(&self) -> Result<Vec<u8>, PreferencesError>;
+}
+
+impl StoredPreferences for UnencryptedPreferences {
+    fn to_bytes(&self) -> Result<Vec<u8>, PreferencesError> {
+        UnencryptedPreferences::to_bytes(self)
+    }
+}
+
+impl StoredPreferences for EncryptedPreferences {
+    fn to_bytes(&self) -> Result<Vec<u8>, PreferencesError> {
+        EncryptedPreferences::to_bytes(self)
+    }
+}
+
+/// Storage where a preferences set is saved.
+enum Storage {
+    LocalStorage,
+    /// The preferences set is stored into the `IndexedDB` with the contained name.
+    IndexedDb(String),
+}
 
 #[wasm_bindgen(js_name = Preferences)]
 pub struct PreferencesWrapper {
-    container: Box<dyn Preferences>,
+    container: Box<dyn StoredPreferences>,
+    storage: Storage,
 }
 
 #[wasm_bindgen(js_class = Preferences)]
@@ -60,11 +93,48 @@ impl PreferencesWrapper {
     }
 
     pub fn erase(&mut self) {
-        self.container.erase();
+        match &self.storage {
+            Storage::LocalStorage => self.container.erase(),
+            Storage::IndexedDb(name) => {
+                self.container.clear();
+                let name = name.clone();
+                spawn_local(async move { idb::erase(&name).await });
+            }
+        }
     }
 
+    /// Saves the preferences set into the `LocalStorage`, the preferences sets stored into the
+    /// `IndexedDB` must be saved with `saveAsync`.
     pub fn save(&self) -> Result<(), JsValue> {
-        Ok(self.container.save()?)
+        match self.storage {
+            Storage::LocalStorage => Ok(self.container.save()?),
+            Storage::IndexedDb(_) => Err(JsValue::from(
+                "the IndexedDB preferences must be saved with saveAsync",
+            )),
+        }
+    }
+
+    /// Saves the preferences set without blocking the browser main thread, returns a `Promise`
+    /// that is resolved when the data have been persisted.
+    /// The data are serialized when this function is called, so the following changes are not
+    /// saved.
+    #[wasm_bindgen(js_name = "saveAsync")]
+    pub fn save_async(&self) -> Result<Promise, JsValue> {
+        let name = match &self.storage {
+            Storage::LocalStorage => {
+                self.container.save()?;
+                return Ok(Promise::resolve(&JsValue::UNDEFINED));
+            }
+            Storage::IndexedDb(name) => name.clone(),
+        };
+        let data = self.container.to_bytes()?;
+
+        Ok(future_to_promise(async move {
+            idb::save_bytes(&name, &data)
+                .await
+                .map_err(|e| JsValue::from(PreferencesError::IO(e)))?;
+            Ok(JsValue::UNDEFINED)
+        }))
     }
 }
 
@@ -78,11 +148,22 @@ pub fn delete(name: &str) {
     preferences::delete(name);
 }
 
+#[wasm_bindgen(js_name = "existAsync")]
+pub async fn exist_async(name: String) -> bool {
+    idb::exist(&name).await
+}
+
+#[wasm_bindgen(js_name = "deleteAsync")]
+pub async fn delete_async(name: String) {
+    idb::erase(&name).await
+}
+
 #[wasm_bindgen(js_name = "preferences")]
 pub fn preferences(name: &str) -> Result<PreferencesWrapper, JsValue> {
     UnencryptedPreferences::new(name)
         .map(|container| PreferencesWrapper {
             container: Box::new(container),
+            storage: Storage::LocalStorage,
         })
         .map_err(JsValue::from)
 }
@@ -92,6 +173,49 @@ pub fn encrypted_preferences(password: &str, name: &str) -> Result<PreferencesWr
     EncryptedPreferences::new(password, name)
         .map(|container| PreferencesWrapper {
             container: Box::new(container),
+            storage: Storage::LocalStorage,
+        })
+        .map_err(JsValue::from)
+}
+
+/// Loads the binary representation of a preferences set from the `IndexedDB`, returns [None] if
+/// the preferences set don't exist.
+async fn load_from_idb(name: &str) -> Result<Option<Vec<u8>>, PreferencesError> {
+    match idb::load_bytes(name).await {
+        Ok(data) => Ok(Some(data)),
+        Err(IoError::EmptyData) => Ok(None),
+        Err(IoError::InvalidName(name)) => Err(PreferencesError::InvalidName(name)),
+        Err(e) => Err(PreferencesError::IO(e)),
+    }
+}
+
+/// Opens a preferences set stored into the browser `IndexedDB`, returns a `Promise` that is
+/// resolved with the opened preferences set.
+#[wasm_bindgen(js_name = "preferencesAsync")]
+pub async fn preferences_async(name: String) -> Result<PreferencesWrapper, JsValue> {
+    let data = load_from_idb(&name).await?;
+
+    UnencryptedPreferences::from_bytes(&name, data.as_deref())
+        .map(|container| PreferencesWrapper {
+            container: Box::new(container),
+            storage: Storage::IndexedDb(name),
+        })
+        .map_err(JsValue::from)
+}
+
+/// Opens an encrypted preferences set stored into the browser `IndexedDB`, returns a `Promise`
+/// that is resolved with the opened preferences set.
+#[wasm_bindgen(js_name = "encryptedPreferencesAsync")]
+pub async fn encrypted_preferences_async(
+    password: String,
+    name: String,
+) -> Result<PreferencesWrapper, JsValue> {
+    let data = load_from_idb(&name).await?;
+
+    EncryptedPreferences::from_bytes(&password, &name, data)
+        .map(|container| PreferencesWrapper {
+            container: Box::new(container),
+            storage: Storage::IndexedDb(name),
         })
         .map_err(JsValue::from)
 }
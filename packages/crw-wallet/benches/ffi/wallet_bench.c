@@ -0,0 +1,90 @@
+/***
+ * @brief Benchmarks of the wallet FFI defined inside ffi-binding.h.
+ * Build and run it with `make bench-ffi`.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ffi-binding.h"
+
+#define TEST_MNEMONIC "battle call once stool three mammal hybrid list sign field athlete amateur cinnamon eagle shell erupt voyage hero assist maple matrix maximum able barrel"
+#define COSMOS_DERIVATION_PATH "m/44'/118'/0'/0/0"
+#define BATCH_SIZE 100
+
+static double now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void report(const char *name, double start, int iterations) {
+  printf("%-40s %12.0f ns/iter\n", name, (now_ns() - start) / iterations);
+}
+
+static void check(int condition, const char *what) {
+  if (!condition) {
+    fprintf(stderr, "%s failed\n", what);
+    exit(1);
+  }
+}
+
+int main() {
+  const int iterations = 1000;
+  uint8_t data[256];
+  uint8_t signature[64];
+  char address[128];
+  memset(data, 42, sizeof(data));
+
+  double start = now_ns();
+  for (int i = 0; i < 10; i++) {
+    wallet_t *wallet = wallet_from_mnemonic(TEST_MNEMONIC, COSMOS_DERIVATION_PATH);
+    check(wallet != NULL, "wallet_from_mnemonic");
+    wallet_free(wallet);
+  }
+  report("wallet_from_mnemonic", start, 10);
+
+  wallet_t *wallet = wallet_from_mnemonic(TEST_MNEMONIC, COSMOS_DERIVATION_PATH);
+  check(wallet != NULL, "wallet_from_mnemonic");
+
+  start = now_ns();
+  for (int i = 0; i < iterations; i++) {
+    check(wallet_get_bech32_address_into(wallet, "cosmos", address, sizeof(address)) > 0,
+          "wallet_get_bech32_address_into");
+  }
+  report("wallet_get_bech32_address_into", start, iterations);
+
+  start = now_ns();
+  for (int i = 0; i < iterations; i++) {
+    signature_t *sig = wallet_sign(wallet, data, sizeof(data));
+    check(sig != NULL, "wallet_sign");
+    wallet_sign_free(sig);
+  }
+  report("wallet_sign", start, iterations);
+
+  start = now_ns();
+  for (int i = 0; i < iterations; i++) {
+    check(wallet_sign_into(wallet, data, sizeof(data), signature) == 64, "wallet_sign_into");
+  }
+  report("wallet_sign_into", start, iterations);
+
+  const uint8_t *datas[BATCH_SIZE];
+  uint32_t lens[BATCH_SIZE];
+  uint8_t *signatures = malloc(BATCH_SIZE * 64);
+  for (int i = 0; i < BATCH_SIZE; i++) {
+    datas[i] = data;
+    lens[i] = sizeof(data);
+  }
+  start = now_ns();
+  for (int i = 0; i < iterations / BATCH_SIZE; i++) {
+    check(wallet_sign_batch(wallet, datas, lens, BATCH_SIZE, signatures) == BATCH_SIZE,
+          "wallet_sign_batch");
+  }
+  report("wallet_sign_batch (per signature)", start, iterations);
+
+  free(signatures);
+  wallet_free(wallet);
+  return 0;
+}
@@ -0,0 +1,60 @@
+use criterion::{black_box, criterion_group, criterion_main, BatchSize, Criterion};
+use crw_wallet::crypto::MnemonicWallet;
+
+static COSMOS_DERIVATION_PATH: &str = "m/44'/118'/0'/0/0";
+static TEST_MNEMONIC: &str = "battle call once stool three mammal hybrid list sign field athlete amateur cinnamon eagle shell erupt voyage hero assist maple matrix maximum able barrel";
+
+fn bench_new(c: &mut Criterion) {
+    c.bench_function("MnemonicWallet::new", |b| {
+        b.iter(|| MnemonicWallet::new(black_box(TEST_MNEMONIC), COSMOS_DERIVATION_PATH).unwrap())
+    });
+}
+
+fn bench_set_derivation_path(c: &mut Criterion) {
+    let wallet = MnemonicWallet::new(TEST_MNEMONIC, COSMOS_DERIVATION_PATH).unwrap();
+
+    let mut group = c.benchmark_group("MnemonicWallet::set_derivation_path");
+    // Only the address levels are derived from the cached account key
+    group.bench_function("same account", |b| {
+        b.iter_batched_ref(
+            || wallet.clone(),
+            |wallet| wallet.set_derivation_path("m/44'/118'/0'/0/1").unwrap(),
+            BatchSize::SmallInput,
+        )
+    });
+    // The whole path is derived from the master key
+    group.bench_function("other account", |b| {
+        b.iter_batched_ref(
+            || wallet.clone(),
+            |wallet| wallet.set_derivation_path("m/44'/852'/0'/0/0").unwrap(),
+            BatchSize::SmallInput,
+        )
+    });
+    group.finish();
+}
+
+fn bench_sign(c: &mut Criterion) {
+    let wallet = MnemonicWallet::new(TEST_MNEMONIC, COSMOS_DERIVATION_PATH).unwrap();
+    let data = vec![42u8; 256];
+
+    c.bench_function("MnemonicWallet::sign", |b| {
+        b.iter(|| wallet.sign(black_box(&data)).unwrap())
+    });
+}
+
+fn bench_get_bech32_address(c: &mut Criterion) {
+    let wallet = MnemonicWallet::new(TEST_MNEMONIC, COSMOS_DERIVATION_PATH).unwrap();
+
+    c.bench_function("MnemonicWallet::get_bech32_address", |b| {
+        b.iter(|| wallet.get_bech32_address(black_box("cosmos")).unwrap())
+    });
+}
+
+criterion_group!(
+    benches,
+    bench_new,
+    bench_set_derivation_path,
+    bench_sign,
+    bench_get_bech32_address
+);
+criterion_main!(benches);
@@ -2,6 +2,7 @@
  * @brief This C header file exposes the FFI defined inside the ffi crate.
  */
 
+#include <stddef.h>
 #include <stdint.h>
 
 typedef struct wallet wallet_t;
@@ -54,6 +55,30 @@ wallet_t* wallet_from_mnemonic(const char* mnemonic, const char* derivation_path
  */
 void wallet_free(wallet_t* wallet);
 
+/**
+ * @brief Derives the public keys and the bech32 addresses of count children
+ * of base_path starting from the child with index start.
+ * @param wallet: Pointer to the wallet instance.
+ * @param base_path: The derivation path of the children parent, e.g. m/44'/118'/0'/0.
+ * @param start: Index of the first child to derive.
+ * @param count: Number of children to derive.
+ * @param hrp: The addresses human readable part.
+ * @param out_pub_keys: Pointer where will be stored the compressed public keys,
+ * one after the other. Must be at least count * 33 bytes long.
+ * @param out_addresses: Pointer where will be stored the null terminated addresses,
+ * the address of the i-th child starts at out_addresses + i * address_len.
+ * Must be at least count * address_len bytes long.
+ * @param address_len: Number of bytes reserved to each address inside out_addresses.
+ * @return Returns the number of derived children on success, -1 if the provided
+ * arguments are invalid, -2 if an address don't fit into address_len bytes, in
+ * this case nothing is wrote into the output buffers, or -3 if the derivation fails.
+ * In case of derivation error the error cause can be obtained using the
+ * error_message_utf8 function.
+ */
+int wallet_derive_range(wallet_t *wallet, const char* base_path, uint32_t start, uint32_t count,
+                        const char* hrp, uint8_t *out_pub_keys, char *out_addresses,
+                        size_t address_len);
+
 /**
  * @brief Gets the bec32 address associated to the wallet.
  * @param wallet: Pointer to the wallet instance.
@@ -67,6 +92,24 @@ void wallet_free(wallet_t* wallet);
  */
 char* wallet_get_bech32_address(wallet_t *wallet, const char* hrp);
 
+/**
+ * @brief Gets the bec32 address associated to the wallet writing it into a
+ * caller provided buffer.
+ * The addresses are cached inside the wallet, so after the first call with a
+ * given hrp the address is only copied into out_buffer.
+ * @param wallet: Pointer to the wallet instance.
+ * @param hrp: The address human readable part.
+ * @param out_buffer: Pointer where will be stored the null terminated address.
+ * @param size: Size of out_buffer.
+ * @return Returns the length of the address wrote into out_buffer (without the
+ * null terminator) on success, -1 if the provided arguments are invalid, -2 if
+ * the address don't fit into out_buffer or -3 if the hrp is invalid.
+ * In case of invalid hrp the error cause can be obtained using the
+ * error_message_utf8 function.
+ */
+int wallet_get_bech32_address_into(wallet_t *wallet, const char* hrp, char *out_buffer,
+                                   size_t size);
+
 /**
  * @brief Gets secp256 public key from the wallet.
  * @param wallet: Pointer to the wallet instance.
@@ -93,6 +136,38 @@ int wallet_get_public_key(wallet_t *wallet, uint32_t compressed, uint8_t *out_bu
  */
 signature_t* wallet_sign(wallet_t *wallet, const uint8_t* data, uint32_t len);
 
+/**
+ * @brief Performs the signature of the provided data writing it into a
+ * caller provided buffer, without performing any heap allocation.
+ * @param wallet: Pointer to the wallet instance.
+ * @param data: The data to sign.
+ * @param len: The length of the data to sign.
+ * @param out: Buffer where will be stored the signature.
+ * @return Returns the number of bytes wrote into out on success (0 if len is 0),
+ * -1 if the provided arguments are invalid or -2 if the signature fails.
+ * In case of signature error the error cause can be obtained using the
+ * error_message_utf8 function.
+ */
+int wallet_sign_into(wallet_t *wallet, const uint8_t* data, uint32_t len, uint8_t out[64]);
+
+/**
+ * @brief Performs the signature of n payloads, on most platforms the
+ * signatures are generated in parallel across all the cores.
+ * @param wallet: Pointer to the wallet instance.
+ * @param datas: The payloads to sign.
+ * @param lens: The length of each payload.
+ * @param n: Number of payloads.
+ * @param out_sigs: Buffer where will be stored the signatures one after the
+ * other, must be at least n * 64 bytes long.
+ * @return Returns the number of signatures wrote into out_sigs on success,
+ * -1 if the provided arguments are invalid or -2 if one of the payloads is
+ * empty or can't be signed.
+ * In case of signature error the error cause can be obtained using the
+ * error_message_utf8 function.
+ */
+int wallet_sign_batch(wallet_t *wallet, const uint8_t** datas, const uint32_t* lens, size_t n,
+                      uint8_t* out_sigs);
+
 /**
  * @brief Free a signature instance.
  * @param signature: Pointer to the signature to free.
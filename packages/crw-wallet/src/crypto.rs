@@ -8,27 +8,115 @@ use bech32::{ToBase32, Variant::Bech32};
 use bip39::{Language, Mnemonic, MnemonicType, Seed};
 use bitcoin::{
     network::constants::Network,
-    secp256k1::Secp256k1,
-    util::bip32::{DerivationPath, ExtendedPrivKey, ExtendedPubKey},
+    secp256k1::{All, Message, Secp256k1},
+    util::bip32::{ChildNumber, DerivationPath, ExtendedPrivKey, ExtendedPubKey},
     PublicKey,
 };
 use hdpath::StandardHDPath;
 use k256::ecdsa::{signature::Signer, Signature, SigningKey};
+use once_cell::sync::Lazy;
 use ripemd160::Ripemd160;
 use sha2::{Digest, Sha256};
 use std::convert::TryFrom;
+use std::ops::{Deref, Range};
+use std::str::FromStr;
+use std::sync::Mutex;
+use std::{mem, slice};
+use zeroize::Zeroize;
+
+#[cfg(not(target_arch = "wasm32"))]
+use rayon::prelude::*;
+
+/// Number of hardened levels (`purpose'/coin_type'/account'`) that are shared from all the
+/// addresses of the same account.
+const ACCOUNT_LEVELS: usize = 3;
+
+/// Size in bytes of a signature generated from [`MnemonicWallet`].
+pub const SIGNATURE_SIZE: usize = 64;
+
+/// Size in bytes of the account hash encoded into a bech32 address.
+pub const ACCOUNT_HASH_SIZE: usize = 20;
+
+/// Maximum number of bech32 addresses cached for each keychain.
+const ADDRESS_CACHE_SIZE: usize = 8;
+
+/// Secp256k1 context shared from all the keys derivations.
+/// Creating a context is expensive since it allocates and computes the precomputation tables
+/// used to sign and verify, so a single context is lazily created and then reused.
+static SECP256K1: Lazy<Secp256k1<All>> = Lazy::new(Secp256k1::new);
+
+/// Wrapper around an [`ExtendedPrivKey`] that wipes the key material from the memory when dropped.
+#[derive(Clone)]
+struct SecretExtendedKey(ExtendedPrivKey);
+
+impl Deref for SecretExtendedKey {
+    type Target = ExtendedPrivKey;
+
+    fn deref(&self) -> &ExtendedPrivKey {
+        &self.0
+    }
+}
+
+impl Drop for SecretExtendedKey {
+    fn drop(&mut self) {
+        // ExtendedPrivKey don't implement Zeroize, so wipe the bytes of its secret parts.
+        // Both are plain 32 bytes arrays, so is safe to see them as a byte slice.
+        unsafe {
+            slice::from_raw_parts_mut(
+                &mut self.0.private_key.key as *mut _ as *mut u8,
+                mem::size_of_val(&self.0.private_key.key),
+            )
+            .zeroize();
+            slice::from_raw_parts_mut(
+                &mut self.0.chain_code as *mut _ as *mut u8,
+                mem::size_of_val(&self.0.chain_code),
+            )
+            .zeroize();
+        }
+    }
+}
+
+/// Small cache of the bech32 addresses of a keychain, identified by their human readable part.
+#[derive(Default)]
+struct AddressCache(Mutex<Vec<(String, String)>>);
+
+impl Clone for AddressCache {
+    fn clone(&self) -> Self {
+        AddressCache(Mutex::new(self.0.lock().unwrap().clone()))
+    }
+}
 
 /// Represents a Secp256k1 key pair.
 #[derive(Clone)]
 struct Keychain {
     pub ext_public_key: ExtendedPubKey,
-    pub ext_private_key: ExtendedPrivKey,
+    pub ext_private_key: SecretExtendedKey,
+    /// Key used to sign, parsed once from `ext_private_key`.
+    pub signing_key: SigningKey,
+    /// RIPEMD-160(SHA-256(public key)), the bytes encoded into the bech32 addresses.
+    pub account_hash: [u8; ACCOUNT_HASH_SIZE],
+    pub addresses: AddressCache,
+}
+
+/// A public key and its bech32 address derived with [`MnemonicWallet::derive_range`].
+#[derive(Clone, Debug)]
+pub struct DerivedAddress {
+    /// Index of the derivation path last level.
+    pub index: u32,
+    pub pub_key: PublicKey,
+    pub address: String,
 }
 
 /// Facility used to manage a Secp256k1 key pair and generate signatures.
+///
+/// The wallet keeps in memory the master key derived from the mnemonic and the hardened
+/// account key (`m/purpose'/coin_type'/account'`), so that changing the derivation path
+/// don't require to recompute the mnemonic seed.
 #[derive(Clone)]
 pub struct MnemonicWallet {
-    mnemonic: Mnemonic,
+    master_key: SecretExtendedKey,
+    account_path: Vec<ChildNumber>,
+    account_key: SecretExtendedKey,
     derivation_path: String,
     keychain: Keychain,
 }
@@ -54,20 +142,30 @@ impl MnemonicWallet {
         mnemonic_phrase: &str,
         derivation_path: &str,
     ) -> Result<MnemonicWallet, WalletError> {
+        timed!("wallet.new");
+
         // Create mnemonic and generate seed from it
         let mnemonic = Mnemonic::from_phrase(mnemonic_phrase, Language::English)
             .map_err(|err| WalletError::Mnemonic(err.to_string()))?;
 
-        let seed = Seed::new(&mnemonic, "");
-
         // Set hd_path for master_key generation
-        let hd_path = StandardHDPath::try_from(derivation_path)
-            .map_err(|_| WalletError::DerivationPath(derivation_path.to_string()))?;
+        let path = MnemonicWallet::parse_derivation_path(derivation_path)?;
+        let children: &[ChildNumber] = path.as_ref();
+        let (account_path, address_path) = children.split_at(ACCOUNT_LEVELS);
+
+        // The seed is computed only here, then the wallet keeps the master key.
+        let seed = Seed::new(&mnemonic, "");
+        let master_key = ExtendedPrivKey::new_master(Network::Bitcoin, seed.as_bytes())
+            .map(SecretExtendedKey)
+            .map_err(|err| WalletError::PrivateKey(err.to_string()))?;
 
-        let keychain = MnemonicWallet::generate_keychain(hd_path, seed)?;
+        let account_key = MnemonicWallet::derive_key(&master_key, account_path)?;
+        let keychain = MnemonicWallet::generate_keychain(&account_key, address_path)?;
 
         Ok(MnemonicWallet {
-            mnemonic,
+            master_key,
+            account_path: account_path.to_vec(),
+            account_key,
             keychain,
             derivation_path: derivation_path.to_owned(),
         })
@@ -97,6 +195,8 @@ impl MnemonicWallet {
 
     /// Changes the derivation path used used to derive the key pair from the mnemonic.
     /// This function force the regenerations of the wallet internal keypair.
+    /// If the new path belongs to the same account of the current one only the last
+    /// non hardened levels are derived.
     ///
     /// # Errors
     ///
@@ -107,14 +207,18 @@ impl MnemonicWallet {
             return Ok(());
         }
 
-        let seed = Seed::new(&self.mnemonic, "");
+        let path = MnemonicWallet::parse_derivation_path(derivation_path)?;
+        let children: &[ChildNumber] = path.as_ref();
+        let (account_path, address_path) = children.split_at(ACCOUNT_LEVELS);
 
-        // Set hd_path for master_key generation
-        let hd_path = StandardHDPath::try_from(derivation_path)
-            .map_err(|_| WalletError::DerivationPath(derivation_path.to_string()))?;
+        // Derive the account key again only if the account is changed.
+        if account_path != self.account_path.as_slice() {
+            self.account_key = MnemonicWallet::derive_key(&self.master_key, account_path)?;
+            self.account_path = account_path.to_vec();
+        }
 
         // Regenerate the keychain with the new derivation path
-        let keychain = MnemonicWallet::generate_keychain(hd_path, seed)?;
+        let keychain = MnemonicWallet::generate_keychain(&self.account_key, address_path)?;
 
         // Update the wallet.
         self.keychain = keychain;
@@ -123,19 +227,40 @@ impl MnemonicWallet {
         Ok(())
     }
 
-    /// Utility function to generate the Secp256k1 keypair.
-    fn generate_keychain(hd_path: StandardHDPath, seed: Seed) -> Result<Keychain, WalletError> {
-        let private_key = ExtendedPrivKey::new_master(Network::Bitcoin, seed.as_bytes())
-            .and_then(|priv_key| {
-                priv_key.derive_priv(&Secp256k1::new(), &DerivationPath::from(hd_path))
-            })
-            .map_err(|err| WalletError::PrivateKey(err.to_string()))?;
+    /// Utility function to parse a BIP-44 derivation path.
+    fn parse_derivation_path(derivation_path: &str) -> Result<DerivationPath, WalletError> {
+        StandardHDPath::try_from(derivation_path)
+            .map(DerivationPath::from)
+            .map_err(|_| WalletError::DerivationPath(derivation_path.to_string()))
+    }
 
-        let public_key = ExtendedPubKey::from_private(&Secp256k1::new(), &private_key);
+    /// Utility function to derive the child of `parent` identified from `path`.
+    fn derive_key(
+        parent: &ExtendedPrivKey,
+        path: &[ChildNumber],
+    ) -> Result<SecretExtendedKey, WalletError> {
+        parent
+            .derive_priv(&*SECP256K1, &path)
+            .map(SecretExtendedKey)
+            .map_err(|err| WalletError::PrivateKey(err.to_string()))
+    }
+
+    /// Utility function to generate the Secp256k1 keypair from the account key.
+    fn generate_keychain(
+        account_key: &ExtendedPrivKey,
+        address_path: &[ChildNumber],
+    ) -> Result<Keychain, WalletError> {
+        let private_key = MnemonicWallet::derive_key(account_key, address_path)?;
+        let public_key = ExtendedPubKey::from_private(&*SECP256K1, &private_key);
+        let signing_key = SigningKey::from_bytes(&private_key.private_key.to_bytes())
+            .map_err(|err| WalletError::PrivateKey(err.to_string()))?;
 
         Ok(Keychain {
+            account_hash: account_hash(&public_key.public_key.to_bytes()),
+            addresses: AddressCache::default(),
             ext_private_key: private_key,
             ext_public_key: public_key,
+            signing_key,
         })
     }
 
@@ -153,44 +278,218 @@ impl MnemonicWallet {
     /// * If the hrp contains any non-ASCII characters (outside 33..=126).
     /// * If the hrp is outside 1..83 characters long.
     pub fn get_bech32_address(&self, hrp: &str) -> Result<String, WalletError> {
-        let mut hasher = Sha256::new();
-        let pub_key_bytes = self.get_pub_key().to_bytes();
-        hasher.update(pub_key_bytes);
-
-        // Read hash digest over the public key bytes & consume hasher
-        let pk_hash = hasher.finalize();
+        self.with_bech32_address(hrp, str::to_owned)
+    }
 
-        // Insert the hash result in the ripdem hash function
-        let mut rip_hasher = Ripemd160::new();
-        rip_hasher.update(pk_hash);
-        let rip_result = rip_hasher.finalize();
+    /// Calls `f` with the bech32 address derived from the mnemonic and the provided
+    /// human readable part.
+    /// The addresses are cached, so after the first request with a given `hrp` the address
+    /// is borrowed from the cache without being computed or allocated again.
+    ///
+    /// # Errors
+    /// Returns an [`Err`] if the provided `hrp` is invalid, see [`MnemonicWallet::get_bech32_address`].
+    pub fn with_bech32_address<R>(
+        &self,
+        hrp: &str,
+        f: impl FnOnce(&str) -> R,
+    ) -> Result<R, WalletError> {
+        let mut cache = self.keychain.addresses.0.lock().unwrap();
+
+        if let Some((_, address)) = cache.iter().find(|(cached_hrp, _)| cached_hrp == hrp) {
+            return Ok(f(address));
+        }
 
-        let address_bytes = rip_result.to_vec();
+        let address = encode_address(&self.keychain.account_hash, hrp)?;
+        if cache.len() == ADDRESS_CACHE_SIZE {
+            cache.remove(0);
+        }
+        cache.push((hrp.to_owned(), address));
 
-        let bech32_address = bech32::encode(hrp, address_bytes.to_base32(), Bech32)
-            .map_err(|err| WalletError::Hrp(err.to_string()))?;
+        Ok(f(&cache[cache.len() - 1].1))
+    }
 
-        Ok(bech32_address)
+    /// Derives the public keys and the bech32 addresses of the `count` children of `base_path`
+    /// starting from the child with index `start`, e.g. with `base_path` equal to
+    /// `m/44'/118'/0'/0` are derived the addresses from `m/44'/118'/0'/0/{start}` to
+    /// `m/44'/118'/0'/0/{start + count - 1}`.
+    ///
+    /// The common parent is derived only once and, since the children are non hardened, they are
+    /// derived from its public key. On native targets the children are derived in parallel.
+    ///
+    /// # Errors
+    /// Returns an [`Err`] if `base_path` is invalid, if one of the children indexes is not a valid
+    /// non hardened index or if the provided `hrp` is invalid.
+    ///
+    /// # Examples
+    ///
+    /// ```
+    /// use crw_wallet::crypto::MnemonicWallet;
+    ///
+    /// let mnemonic = "battle call once stool three mammal hybrid list sign field athlete amateur cinnamon eagle shell erupt voyage hero assist maple matrix maximum able barrel";
+    /// let wallet = MnemonicWallet::new(mnemonic, "m/44'/118'/0'/0/0").unwrap();
+    ///
+    /// let addresses = wallet.derive_range("m/44'/118'/0'/0", 0, 20, "cosmos").unwrap();
+    /// ```
+    pub fn derive_range(
+        &self,
+        base_path: &str,
+        start: u32,
+        count: u32,
+        hrp: &str,
+    ) -> Result<Vec<DerivedAddress>, WalletError> {
+        let end = start
+            .checked_add(count)
+            .ok_or_else(|| WalletError::DerivationPath(format!("{}/{}", base_path, u32::MAX)))?;
+
+        let path = DerivationPath::from_str(base_path)
+            .map_err(|_| WalletError::DerivationPath(base_path.to_string()))?;
+        let children: &[ChildNumber] = path.as_ref();
+
+        // Reuse the cached account key if the base path is inside the current account.
+        let parent = if children.starts_with(&self.account_path) {
+            MnemonicWallet::derive_key(&self.account_key, &children[ACCOUNT_LEVELS..])?
+        } else {
+            MnemonicWallet::derive_key(&self.master_key, children)?
+        };
+        let parent = ExtendedPubKey::from_private(&*SECP256K1, &parent);
+
+        map_indexes(start..end, |index| {
+            let child = ChildNumber::from_normal_idx(index)
+                .and_then(|child| parent.ckd_pub(&*SECP256K1, child))
+                .map_err(|_| WalletError::DerivationPath(format!("{}/{}", base_path, index)))?;
+
+            Ok(DerivedAddress {
+                index,
+                address: encode_address(&account_hash(&child.public_key.to_bytes()), hrp)?,
+                pub_key: child.public_key,
+            })
+        })
     }
 
     /// Returns the signature of the provided data.
     pub fn sign(&self, data: &[u8]) -> Result<Vec<u8>, WalletError> {
+        let mut signature = [0u8; SIGNATURE_SIZE];
+        let len = self.sign_into(data, &mut signature)?;
+
+        Ok(signature[..len].to_vec())
+    }
+
+    /// Writes the signature of the provided data into `out` without allocating.
+    /// Returns the number of bytes wrote into `out`, that is 0 if `data` is empty.
+    pub fn sign_into(
+        &self,
+        data: &[u8],
+        out: &mut [u8; SIGNATURE_SIZE],
+    ) -> Result<usize, WalletError> {
         if data.is_empty() {
-            return Result::Ok(Vec::new());
+            return Result::Ok(0);
         }
-        //  Get the sign key from the private key
-        let sign_key =
-            SigningKey::from_bytes(&self.keychain.ext_private_key.private_key.to_bytes()).unwrap();
+        timed!("wallet.sign");
 
         // Sign the data provided data
-        let signature: Signature = sign_key
+        let signature: Signature = self
+            .keychain
+            .signing_key
             .try_sign(data)
             .map_err(|err| WalletError::Sign(err.to_string()))?;
 
-        Ok(signature.as_ref().to_vec())
+        out.copy_from_slice(signature.as_ref());
+        Ok(SIGNATURE_SIZE)
+    }
+
+    /// Returns the signatures of all the provided `payloads`, in the same order.
+    /// On native targets the signatures are generated in parallel across all the cores.
+    ///
+    /// # Errors
+    /// Returns an [`Err`] if one of the payloads is empty or can't be signed.
+    pub fn sign_batch(&self, payloads: &[&[u8]]) -> Result<Vec<[u8; SIGNATURE_SIZE]>, WalletError> {
+        map_slice(payloads, |data| {
+            let mut signature = [0u8; SIGNATURE_SIZE];
+            if self.sign_into(data, &mut signature)? == 0 {
+                return Err(WalletError::Sign("can't sign an empty payload".to_owned()));
+            }
+            Ok(signature)
+        })
+    }
+
+    /// Returns the signature of a message given its SHA-256 `hash`.
+    ///
+    /// Both this function and [`MnemonicWallet::sign`] produce deterministic (RFC 6979) low-S
+    /// signatures, so `sign_prehashed(&sha256(data))` returns the same signature of `sign(data)`.
+    pub fn sign_prehashed(&self, hash: &[u8; 32]) -> Result<Vec<u8>, WalletError> {
+        let message =
+            Message::from_slice(hash).map_err(|err| WalletError::Sign(err.to_string()))?;
+
+        let signature = SECP256K1.sign(&message, &self.keychain.ext_private_key.private_key.key);
+
+        Ok(signature.serialize_compact().to_vec())
     }
 }
 
+/// Computes the account hash, RIPEMD-160(SHA-256(pub_key)), associated to the
+/// compressed secp256k1 public key `pub_key`.
+/// The account hash are the bytes encoded into the bech32 addresses.
+pub fn account_hash(pub_key: &[u8]) -> [u8; ACCOUNT_HASH_SIZE] {
+    let mut hasher = Sha256::new();
+    hasher.update(pub_key);
+
+    // Read hash digest over the public key bytes & consume hasher
+    let pk_hash = hasher.finalize();
+
+    // Insert the hash result in the ripdem hash function
+    let mut rip_hasher = Ripemd160::new();
+    rip_hasher.update(pk_hash);
+
+    let mut hash = [0u8; ACCOUNT_HASH_SIZE];
+    hash.copy_from_slice(&rip_hasher.finalize());
+    hash
+}
+
+/// Encodes an account hash as a bech32 address with the provided human readable part.
+fn encode_address(account_hash: &[u8], hrp: &str) -> Result<String, WalletError> {
+    bech32::encode(hrp, account_hash.to_base32(), Bech32)
+        .map_err(|err| WalletError::Hrp(err.to_string()))
+}
+
+/// Applies `f` to all the `indexes`, on native targets the work is split across all the cores.
+#[cfg(not(target_arch = "wasm32"))]
+fn map_indexes<T, F>(indexes: Range<u32>, f: F) -> Result<Vec<T>, WalletError>
+where
+    T: Send,
+    F: Fn(u32) -> Result<T, WalletError> + Send + Sync,
+{
+    indexes.into_par_iter().map(f).collect()
+}
+
+/// Applies `f` to all the `indexes`.
+#[cfg(target_arch = "wasm32")]
+fn map_indexes<T, F>(indexes: Range<u32>, f: F) -> Result<Vec<T>, WalletError>
+where
+    F: Fn(u32) -> Result<T, WalletError>,
+{
+    indexes.map(f).collect()
+}
+
+/// Applies `f` to all the `items`, on native targets the work is split across all the cores.
+#[cfg(not(target_arch = "wasm32"))]
+fn map_slice<I, T, F>(items: &[I], f: F) -> Result<Vec<T>, WalletError>
+where
+    I: Sync,
+    T: Send,
+    F: Fn(&I) -> Result<T, WalletError> + Send + Sync,
+{
+    items.par_iter().map(f).collect()
+}
+
+/// Applies `f` to all the `items`.
+#[cfg(target_arch = "wasm32")]
+fn map_slice<I, T, F>(items: &[I], f: F) -> Result<Vec<T>, WalletError>
+where
+    F: Fn(&I) -> Result<T, WalletError>,
+{
+    items.iter().map(f).collect()
+}
+
 #[cfg(test)]
 mod tests {
     use super::*;
@@ -280,6 +579,172 @@ mod tests {
         );
     }
 
+    #[test]
+    fn cached_bech32_address() {
+        let mut wallet = MnemonicWallet::new(TEST_MNEMONIC, COSMOS_DERIVATION_PATH).unwrap();
+
+        for _ in 0..2 {
+            assert_eq!(
+                "cosmos1dzczdka6wpzwvmawpps7tf8047gkft0e5cupun",
+                wallet.get_bech32_address("cosmos").unwrap()
+            );
+        }
+        // Fill the cache to check the eviction of the old entries
+        for i in 0..ADDRESS_CACHE_SIZE {
+            wallet.get_bech32_address(&format!("hrp{}", i)).unwrap();
+        }
+        assert_eq!(
+            "cosmos1dzczdka6wpzwvmawpps7tf8047gkft0e5cupun",
+            wallet.get_bech32_address("cosmos").unwrap()
+        );
+
+        // The cache must be invalidated when the path changes
+        wallet.set_derivation_path(DESMOS_DERIVATION_PATH).unwrap();
+        assert_eq!(
+            "desmos1k8u92hx3k33a5vgppkyzq6m4frxx7ewnlkyjrh",
+            wallet.get_bech32_address("desmos").unwrap()
+        );
+        assert_ne!(
+            "cosmos1dzczdka6wpzwvmawpps7tf8047gkft0e5cupun",
+            wallet.get_bech32_address("cosmos").unwrap()
+        );
+    }
+
+    #[test]
+    fn set_derivation_path_same_account() {
+        let mut wallet = MnemonicWallet::new(TEST_MNEMONIC, COSMOS_DERIVATION_PATH).unwrap();
+        let reference = MnemonicWallet::new(TEST_MNEMONIC, "m/44'/118'/0'/0/1").unwrap();
+
+        wallet.set_derivation_path("m/44'/118'/0'/0/1").unwrap();
+
+        assert_eq!(
+            reference.get_bech32_address("cosmos").unwrap(),
+            wallet.get_bech32_address("cosmos").unwrap()
+        );
+    }
+
+    #[test]
+    fn set_derivation_path_different_account() {
+        let mut wallet = MnemonicWallet::new(TEST_MNEMONIC, COSMOS_DERIVATION_PATH).unwrap();
+
+        wallet.set_derivation_path(DESMOS_DERIVATION_PATH).unwrap();
+
+        assert_eq!(
+            wallet.get_bech32_address("desmos").unwrap(),
+            "desmos1k8u92hx3k33a5vgppkyzq6m4frxx7ewnlkyjrh"
+        );
+    }
+
+    #[test]
+    fn set_invalid_derivation_path() {
+        let mut wallet = MnemonicWallet::new(TEST_MNEMONIC, COSMOS_DERIVATION_PATH).unwrap();
+
+        let result = wallet.set_derivation_path("m/44'/118'");
+
+        assert!(match result.err().unwrap() {
+            WalletError::DerivationPath(_) => true,
+            _ => false,
+        });
+        // The wallet must be still usable with the previous path.
+        assert_eq!(
+            wallet.get_bech32_address("cosmos").unwrap(),
+            "cosmos1dzczdka6wpzwvmawpps7tf8047gkft0e5cupun"
+        );
+    }
+
+    #[test]
+    fn derive_range() {
+        let wallet = MnemonicWallet::new(TEST_MNEMONIC, DESMOS_DERIVATION_PATH).unwrap();
+        let second = MnemonicWallet::new(TEST_MNEMONIC, "m/44'/118'/0'/0/1").unwrap();
+
+        let derived = wallet
+            .derive_range("m/44'/118'/0'/0", 0, 3, "cosmos")
+            .unwrap();
+
+        assert_eq!(3, derived.len());
+        assert_eq!(
+            "cosmos1dzczdka6wpzwvmawpps7tf8047gkft0e5cupun",
+            derived[0].address
+        );
+        assert_eq!(1, derived[1].index);
+        assert_eq!(second.get_pub_key(), derived[1].pub_key);
+        assert_eq!(
+            second.get_bech32_address("cosmos").unwrap(),
+            derived[1].address
+        );
+    }
+
+    #[test]
+    fn derive_range_invalid_args() {
+        let wallet = MnemonicWallet::new(TEST_MNEMONIC, COSMOS_DERIVATION_PATH).unwrap();
+
+        assert!(wallet
+            .derive_range("44'/118'/0'/0", 0, 1, "cosmos")
+            .is_err());
+        assert!(wallet
+            .derive_range("m/44'/118'/0'/0", u32::MAX, 2, "cosmos")
+            .is_err());
+        // Hardened indexes can't be derived from the public key.
+        assert!(wallet
+            .derive_range("m/44'/118'/0'/0", 1 << 31, 1, "cosmos")
+            .is_err());
+        assert!(wallet.derive_range("m/44'/118'/0'/0", 0, 1, "").is_err());
+    }
+
+    #[test]
+    fn sign_prehashed() {
+        let wallet = MnemonicWallet::new(TEST_MNEMONIC, DESMOS_DERIVATION_PATH).unwrap();
+
+        let data = "some simple data".as_bytes();
+        let mut hash = [0u8; 32];
+        hash.copy_from_slice(&Sha256::digest(data));
+
+        let signature = wallet.sign_prehashed(&hash).unwrap();
+
+        assert_eq!(wallet.sign(data).unwrap(), signature);
+    }
+
+    #[test]
+    fn sign_after_derivation_path_change() {
+        let mut wallet = MnemonicWallet::new(TEST_MNEMONIC, COSMOS_DERIVATION_PATH).unwrap();
+        let reference = MnemonicWallet::new(TEST_MNEMONIC, DESMOS_DERIVATION_PATH).unwrap();
+
+        wallet.set_derivation_path(DESMOS_DERIVATION_PATH).unwrap();
+
+        let data = "some simple data".as_bytes();
+        assert_eq!(reference.sign(data).unwrap(), wallet.sign(data).unwrap());
+    }
+
+    #[test]
+    fn sign_batch() {
+        let wallet = MnemonicWallet::new(TEST_MNEMONIC, DESMOS_DERIVATION_PATH).unwrap();
+        let payloads = vec![
+            "some simple data".as_bytes(),
+            "other data".as_bytes(),
+            "some simple data".as_bytes(),
+        ];
+
+        let signatures = wallet.sign_batch(&payloads).unwrap();
+
+        assert_eq!(3, signatures.len());
+        for (payload, signature) in payloads.iter().zip(signatures.iter()) {
+            assert_eq!(wallet.sign(payload).unwrap(), signature.to_vec());
+        }
+    }
+
+    #[test]
+    fn sign_batch_with_empty_payload() {
+        let wallet = MnemonicWallet::new(TEST_MNEMONIC, DESMOS_DERIVATION_PATH).unwrap();
+        let payloads = vec!["some simple data".as_bytes(), "".as_bytes()];
+
+        let result = wallet.sign_batch(&payloads);
+
+        assert!(match result.err().unwrap() {
+            WalletError::Sign(_) => true,
+            _ => false,
+        });
+    }
+
     #[test]
     fn empty_sign() {
         let wallet = MnemonicWallet::new(TEST_MNEMONIC, COSMOS_DERIVATION_PATH).unwrap();
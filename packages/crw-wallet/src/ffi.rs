@@ -1,12 +1,17 @@
 //! Provides the FFI to interact with [`MnemonicWallet`] from other programming languages.
-use crate::crypto::MnemonicWallet;
+use crate::crypto::{MnemonicWallet, SIGNATURE_SIZE};
 use crate::WalletError;
 use bip39::{Language, Mnemonic, MnemonicType};
+use bitcoin::secp256k1::constants::PUBLIC_KEY_SIZE;
 use libc::{c_char, c_int, c_uchar, c_uint, size_t};
 use std::ffi::{CStr, CString};
 use std::ptr::null_mut;
 use std::{mem, slice};
 
+// The latency metrics of this library are exported together with its FFI, see crw_metrics.h.
+#[cfg(feature = "metrics")]
+pub use crw_metrics::ffi::{crw_metrics_reset, crw_metrics_snapshot, crw_metrics_string_free};
+
 #[repr(C)]
 pub struct Signature {
     len: c_uint,
@@ -93,6 +98,85 @@ pub extern "C" fn wallet_free(ptr: *mut MnemonicWallet) {
     Box::from(ptr);
 }
 
+/// Derives the public keys and the bech32 addresses of the `count` children of `base_path`
+/// starting from the child with index `start`.
+/// The compressed public keys are stored one after the other into `out_pub_keys` that must be
+/// at least `count * 33` bytes long.
+/// The addresses are stored as null terminated strings into `out_addresses`, the address of the
+/// i-th child starts at `out_addresses + i * address_len` so `out_addresses` must be at least
+/// `count * address_len` bytes long.
+///
+/// This function returns the number of derived children.
+///
+/// # Errors
+/// Returns -1 if the provided arguments are invalid, -2 if an address don't fit into `address_len`
+/// bytes, in this case the output buffers are left untouched, or -3 if the derivation fails, in this case the error cause is stored in a local thread
+/// global variable that can be accessed using the [error_message_utf8](ffi_helpers::error_handling::error_message_utf8) function.
+#[no_mangle]
+#[allow(clippy::too_many_arguments)]
+pub extern "C" fn wallet_derive_range(
+    ptr: *const MnemonicWallet,
+    base_path: *const c_char,
+    start: c_uint,
+    count: c_uint,
+    hrp: *const c_char,
+    out_pub_keys: *mut c_uchar,
+    out_addresses: *mut c_char,
+    address_len: size_t,
+) -> c_int {
+    if ptr.is_null()
+        || base_path.is_null()
+        || hrp.is_null()
+        || out_pub_keys.is_null()
+        || out_addresses.is_null()
+        || count > c_int::MAX as c_uint
+    {
+        return -1;
+    }
+
+    let base_path = unsafe { CStr::from_ptr(base_path).to_string_lossy() };
+    let hrp = unsafe { CStr::from_ptr(hrp).to_string_lossy() };
+
+    let derived = unsafe {
+        match ptr
+            .as_ref()
+            .unwrap()
+            .derive_range(base_path.as_ref(), start, count, hrp.as_ref())
+        {
+            Ok(d) => d,
+            Err(e) => {
+                ffi_helpers::update_last_error(e);
+                return -3;
+            }
+        }
+    };
+
+    // Check that all the addresses fit before writing anything into the caller buffers,
+    // keeping a byte for the null terminator.
+    if derived
+        .iter()
+        .any(|child| child.address.len() >= address_len)
+    {
+        return -2;
+    }
+
+    let pub_keys =
+        unsafe { slice::from_raw_parts_mut(out_pub_keys, derived.len() * PUBLIC_KEY_SIZE) };
+    let addresses =
+        unsafe { slice::from_raw_parts_mut(out_addresses as *mut u8, derived.len() * address_len) };
+
+    for (i, child) in derived.iter().enumerate() {
+        pub_keys[i * PUBLIC_KEY_SIZE..(i + 1) * PUBLIC_KEY_SIZE]
+            .copy_from_slice(&child.pub_key.key.serialize());
+
+        let address = &mut addresses[i * address_len..(i + 1) * address_len];
+        address[..child.address.len()].copy_from_slice(child.address.as_bytes());
+        address[child.address.len()] = 0;
+    }
+
+    derived.len() as c_int
+}
+
 /// Gets the bech32 address derived from the mnemonic and the provided human readable part.
 ///
 /// # Errors
@@ -133,6 +217,56 @@ pub extern "C" fn wallet_get_bech32_address(
     address_c_str.into_raw()
 }
 
+/// Gets the bech32 address derived from the mnemonic and the provided human readable part writing
+/// it as a null terminated string into `out_buffer`.
+/// Unlike [`wallet_get_bech32_address`] this function don't allocate the returned address and,
+/// since the addresses are cached inside the wallet, after the first call with a given `hrp`
+/// the address is only copied into `out_buffer`.
+///
+/// This function returns the length of the address wrote into `out_buffer`, without the null
+/// terminator.
+///
+/// # Errors
+/// Returns -1 if the provided arguments are invalid, -2 if the address don't fit into `out_buffer`
+/// or -3 if `hrp` is not a valid human readable part, in this case the error cause is stored in
+/// a local thread global variable that can be accessed using the [error_message_utf8](ffi_helpers::error_handling::error_message_utf8) function.
+#[no_mangle]
+pub extern "C" fn wallet_get_bech32_address_into(
+    ptr: *const MnemonicWallet,
+    hrp: *const c_char,
+    out_buffer: *mut c_char,
+    size: size_t,
+) -> c_int {
+    if ptr.is_null() || hrp.is_null() || out_buffer.is_null() {
+        return -1;
+    }
+
+    let hrp_cstr = unsafe { CStr::from_ptr(hrp).to_string_lossy() };
+    let out_buf = unsafe { slice::from_raw_parts_mut(out_buffer as *mut u8, size) };
+
+    let result = unsafe {
+        ptr.as_ref()
+            .unwrap()
+            .with_bech32_address(hrp_cstr.as_ref(), |address| {
+                // Keep a byte for the null terminator.
+                if address.len() >= out_buf.len() {
+                    return -2;
+                }
+                out_buf[..address.len()].copy_from_slice(address.as_bytes());
+                out_buf[address.len()] = 0;
+                address.len() as c_int
+            })
+    };
+
+    match result {
+        Ok(len) => len,
+        Err(e) => {
+            ffi_helpers::update_last_error(e);
+            -3
+        }
+    }
+}
+
 /// Gets the wallet public key.
 /// This function returns the number of bytes copied into `out_buffer`.
 ///
@@ -210,6 +344,106 @@ pub extern "C" fn wallet_sign(
     Box::into_raw(Box::from(signature))
 }
 
+/// Generates a signature of the provided data and writes it into `out` that must be at least
+/// 64 bytes long.
+/// Unlike [`wallet_sign`] this function don't perform any heap allocation.
+///
+/// This function returns the number of bytes wrote into `out`, 0 if `data_len` is 0.
+///
+/// # Errors
+/// Returns -1 if the provided arguments are invalid or -2 if an error occurs while signing,
+/// in this case the error cause is stored in a local thread global variable that can be
+/// accessed using the [error_message_utf8](ffi_helpers::error_handling::error_message_utf8) function.
+#[no_mangle]
+pub extern "C" fn wallet_sign_into(
+    ptr: *const MnemonicWallet,
+    data: *const c_uchar,
+    data_len: c_uint,
+    out: *mut c_uchar,
+) -> c_int {
+    if ptr.is_null() || data.is_null() || out.is_null() {
+        return -1;
+    }
+
+    let (wallet, data, out) = unsafe {
+        (
+            ptr.as_ref().unwrap(),
+            slice::from_raw_parts(data, data_len as usize),
+            &mut *(out as *mut [u8; SIGNATURE_SIZE]),
+        )
+    };
+
+    match wallet.sign_into(data, out) {
+        Ok(len) => len as c_int,
+        Err(e) => {
+            ffi_helpers::update_last_error(e);
+            -2
+        }
+    }
+}
+
+/// Generates the signatures of `n` payloads, the i-th payload is `datas[i]` and is `lens[i]`
+/// bytes long. The signatures are stored one after the other into `out_sigs` that must be at
+/// least `n * 64` bytes long.
+/// On most platforms the signatures are generated in parallel across all the cores.
+///
+/// This function returns the number of signatures wrote into `out_sigs`.
+///
+/// # Errors
+/// Returns -1 if the provided arguments are invalid or -2 if an error occurs while signing,
+/// in this case the error cause is stored in a local thread global variable that can be
+/// accessed using the [error_message_utf8](ffi_helpers::error_handling::error_message_utf8) function.
+#[no_mangle]
+pub extern "C" fn wallet_sign_batch(
+    ptr: *const MnemonicWallet,
+    datas: *const *const c_uchar,
+    lens: *const c_uint,
+    n: size_t,
+    out_sigs: *mut c_uchar,
+) -> c_int {
+    if ptr.is_null()
+        || datas.is_null()
+        || lens.is_null()
+        || out_sigs.is_null()
+        || n > c_int::MAX as size_t
+    {
+        return -1;
+    }
+
+    let (datas, lens) = unsafe {
+        (
+            slice::from_raw_parts(datas, n),
+            slice::from_raw_parts(lens, n),
+        )
+    };
+    if datas.iter().any(|data| data.is_null()) {
+        return -1;
+    }
+
+    let payloads: Vec<&[u8]> = datas
+        .iter()
+        .zip(lens.iter())
+        .map(|(data, len)| unsafe { slice::from_raw_parts(*data, *len as usize) })
+        .collect();
+
+    let signatures = unsafe {
+        match ptr.as_ref().unwrap().sign_batch(&payloads) {
+            Ok(s) => s,
+            Err(e) => {
+                ffi_helpers::update_last_error(e);
+                return -2;
+            }
+        }
+    };
+
+    let out = unsafe { slice::from_raw_parts_mut(out_sigs, n * SIGNATURE_SIZE) };
+    for (dest, signature) in out.chunks_exact_mut(SIGNATURE_SIZE).zip(signatures.iter()) {
+        dest.copy_from_slice(signature);
+    }
+
+    n as c_int
+}
+
 /// Deallocate a [`Signature`] instance.
 #[no_mangle]
 pub extern "C" fn wallet_sign_free(ptr: *mut Signature) {
@@ -236,11 +470,13 @@ export_error_handling_functions!();
 #[cfg(test)]
 mod tests {
     use crate::ffi::{
-        cstring_free, wallet_free, wallet_from_mnemonic, wallet_get_bech32_address,
-        wallet_get_public_key, wallet_random_mnemonic, wallet_sign, wallet_sign_free,
+        cstring_free, wallet_derive_range, wallet_free, wallet_from_mnemonic,
+        wallet_get_bech32_address, wallet_get_bech32_address_into, wallet_get_public_key,
+        wallet_random_mnemonic, wallet_sign, wallet_sign_batch, wallet_sign_free, wallet_sign_into,
     };
     use ffi_helpers::error_handling::error_message;
-    use std::ffi::CString;
+    use libc::c_char;
+    use std::ffi::{CStr, CString};
     use std::mem;
     use std::ptr::null_mut;
 
@@ -362,6 +598,105 @@ mod tests {
         cstring_free(c_dp);
     }
 
+    #[test]
+    fn derive_range() {
+        let c_mnemonic = CString::new(TEST_MNEMONIC).unwrap().into_raw();
+        let c_dp = CString::new(COSMOS_DERIVATION_PATH).unwrap().into_raw();
+        let wallet = wallet_from_mnemonic(c_mnemonic, c_dp);
+
+        let base_path = CString::new("m/44'/118'/0'/0").unwrap();
+        let hrp = CString::new("cosmos").unwrap();
+        let mut pub_keys = [0u8; 33 * 2];
+        let mut addresses = [0 as c_char; 64 * 2];
+
+        let derived = wallet_derive_range(
+            wallet,
+            base_path.as_ptr(),
+            0,
+            2,
+            hrp.as_ptr(),
+            pub_keys.as_mut_ptr(),
+            addresses.as_mut_ptr(),
+            64,
+        );
+        assert_eq!(2, derived);
+
+        assert_eq!(
+            "028b3f1f48e4dbc68287473da1a76d81bd827aac22622b7da5f351e2580d14b282",
+            hex::encode(&pub_keys[..33])
+        );
+        let first_address = unsafe { CStr::from_ptr(addresses.as_ptr()) };
+        assert_eq!(
+            "cosmos1dzczdka6wpzwvmawpps7tf8047gkft0e5cupun",
+            first_address.to_string_lossy()
+        );
+
+        // Too small address buffer, nothing is wrote into the buffers
+        let mut small_pub_keys = [0u8; 66];
+        let mut small_addresses = [0 as c_char; 20];
+        let derived = wallet_derive_range(
+            wallet,
+            base_path.as_ptr(),
+            0,
+            2,
+            hrp.as_ptr(),
+            small_pub_keys.as_mut_ptr(),
+            small_addresses.as_mut_ptr(),
+            10,
+        );
+        assert_eq!(-2, derived);
+        assert!(small_pub_keys.iter().all(|b| *b == 0));
+        assert!(small_addresses.iter().all(|c| *c == 0));
+
+        wallet_free(wallet);
+        cstring_free(c_mnemonic);
+        cstring_free(c_dp);
+    }
+
+    #[test]
+    fn bech32_address_into() {
+        let c_mnemonic = CString::new(TEST_MNEMONIC).unwrap().into_raw();
+        let c_dp = CString::new(COSMOS_DERIVATION_PATH).unwrap().into_raw();
+        let wallet = wallet_from_mnemonic(c_mnemonic, c_dp);
+
+        let hrp = CString::new("cosmos").unwrap();
+        let mut out_buffer = [0 as c_char; 64];
+        for _ in 0..2 {
+            let len = wallet_get_bech32_address_into(
+                wallet,
+                hrp.as_ptr(),
+                out_buffer.as_mut_ptr(),
+                out_buffer.len(),
+            );
+            let address = unsafe { CStr::from_ptr(out_buffer.as_ptr()) };
+
+            assert_eq!(45, len);
+            assert_eq!(
+                "cosmos1dzczdka6wpzwvmawpps7tf8047gkft0e5cupun",
+                address.to_string_lossy()
+            );
+        }
+
+        // Buffer too small
+        let len = wallet_get_bech32_address_into(wallet, hrp.as_ptr(), out_buffer.as_mut_ptr(), 45);
+        assert_eq!(-2, len);
+
+        // Invalid hrp
+        let invalid_hrp = CString::new("").unwrap();
+        let len = wallet_get_bech32_address_into(
+            wallet,
+            invalid_hrp.as_ptr(),
+            out_buffer.as_mut_ptr(),
+            out_buffer.len(),
+        );
+        assert_eq!(-3, len);
+        assert!(error_message().is_some());
+
+        wallet_free(wallet);
+        cstring_free(c_mnemonic);
+        cstring_free(c_dp);
+    }
+
     #[test]
     fn get_public_key() {
         let ref_public_key = "048b3f1f48e4dbc68287473da1a76d81bd827aac22622b7da5f351e2580d14b2823fe447037648f5d83b11dd2ea88e06db6c452b5376aa4c70e7a8c9c7b13cf39a";
@@ -489,4 +824,98 @@ mod tests {
         cstring_free(c_mnemonic);
         cstring_free(c_dp);
     }
+
+    #[test]
+    fn sign_into() {
+        let ref_hex_signature = "5590171f32520497dd9ca07a3f03ef69ceff972471821902ebe31532d7f13be51021b7c8849431340fe6e91321987a90ffe5598d5e87fe4d55acf1bb90a000e9";
+        let c_mnemonic = CString::new(TEST_MNEMONIC).unwrap().into_raw();
+        let c_dp = CString::new(COSMOS_DERIVATION_PATH).unwrap().into_raw();
+        let wallet = wallet_from_mnemonic(c_mnemonic, c_dp);
+
+        let data = "some simple data".as_bytes();
+        let mut signature = [0u8; 64];
+        let written = wallet_sign_into(
+            wallet,
+            data.as_ptr(),
+            data.len() as u32,
+            signature.as_mut_ptr(),
+        );
+
+        assert_eq!(64, written);
+        assert_eq!(ref_hex_signature, hex::encode(signature));
+
+        wallet_free(wallet);
+        cstring_free(c_mnemonic);
+        cstring_free(c_dp);
+    }
+
+    #[test]
+    fn sign_into_invalid_args() {
+        let c_mnemonic = CString::new(TEST_MNEMONIC).unwrap().into_raw();
+        let c_dp = CString::new(COSMOS_DERIVATION_PATH).unwrap().into_raw();
+        let wallet = wallet_from_mnemonic(c_mnemonic, c_dp);
+
+        let data = "some simple data".as_bytes();
+        let mut signature = [0u8; 64];
+
+        assert_eq!(
+            -1,
+            wallet_sign_into(null_mut(), data.as_ptr(), 1, signature.as_mut_ptr())
+        );
+        assert_eq!(
+            -1,
+            wallet_sign_into(wallet, null_mut(), 1, signature.as_mut_ptr())
+        );
+        assert_eq!(-1, wallet_sign_into(wallet, data.as_ptr(), 1, null_mut()));
+        // Empty data
+        assert_eq!(
+            0,
+            wallet_sign_into(wallet, data.as_ptr(), 0, signature.as_mut_ptr())
+        );
+
+        wallet_free(wallet);
+        cstring_free(c_mnemonic);
+        cstring_free(c_dp);
+    }
+
+    #[test]
+    fn sign_batch() {
+        let ref_hex_signature = "5590171f32520497dd9ca07a3f03ef69ceff972471821902ebe31532d7f13be51021b7c8849431340fe6e91321987a90ffe5598d5e87fe4d55acf1bb90a000e9";
+        let c_mnemonic = CString::new(TEST_MNEMONIC).unwrap().into_raw();
+        let c_dp = CString::new(COSMOS_DERIVATION_PATH).unwrap().into_raw();
+        let wallet = wallet_from_mnemonic(c_mnemonic, c_dp);
+
+        let data = "some simple data".as_bytes();
+        let datas = [data.as_ptr(), data.as_ptr()];
+        let lens = [data.len() as u32, data.len() as u32];
+        let mut signatures = [0u8; 64 * 2];
+
+        let signed = wallet_sign_batch(
+            wallet,
+            datas.as_ptr(),
+            lens.as_ptr(),
+            datas.len(),
+            signatures.as_mut_ptr(),
+        );
+
+        assert_eq!(2, signed);
+        assert_eq!(ref_hex_signature, hex::encode(&signatures[..64]));
+        assert_eq!(ref_hex_signature, hex::encode(&signatures[64..]));
+
+        // Empty payloads can't be signed
+        let lens = [data.len() as u32, 0];
+        let signed = wallet_sign_batch(
+            wallet,
+            datas.as_ptr(),
+            lens.as_ptr(),
+            datas.len(),
+            signatures.as_mut_ptr(),
+        );
+        assert_eq!(-2, signed);
+        assert!(error_message().is_some());
+
+        wallet_free(wallet);
+        cstring_free(c_mnemonic);
+        cstring_free(c_dp);
+    }
 }
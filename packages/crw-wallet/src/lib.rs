@@ -2,6 +2,10 @@
 #[macro_use]
 extern crate ffi_helpers;
 
+// The timed! macros record the measures only when built with the `metrics` feature.
+#[macro_use]
+extern crate crw_metrics;
+
 pub mod crypto;
 mod error;
 pub use crate::error::WalletError;
@@ -3,7 +3,9 @@
 use crate::crypto::MnemonicWallet;
 extern crate bindgen as wasm_bindgen;
 use bip39::{Language, Mnemonic, MnemonicType};
+use js_sys::{Array, Object, Reflect, Uint8Array};
 use wasm_bindgen::prelude::*;
+use wasm_bindgen::JsCast;
 
 #[wasm_bindgen(js_name = MnemonicWallet)]
 pub struct JsMnemonicWallet {
@@ -55,6 +57,63 @@ impl JsMnemonicWallet {
             .sign(&data)
             .map_err(|e| JsValue::from(e.to_string()))?)
     }
+
+    /// Signs all the `payloads`, an array of `Uint8Array`, returning an array with their
+    /// signatures in the same order.
+    #[wasm_bindgen(js_name = signBatch)]
+    pub fn sign_batch(&self, payloads: Array) -> Result<Array, JsValue> {
+        let payloads = payloads
+            .iter()
+            .map(|payload| {
+                payload
+                    .dyn_into::<Uint8Array>()
+                    .map(|payload| payload.to_vec())
+                    .map_err(|_| JsValue::from("the payloads must be Uint8Array"))
+            })
+            .collect::<Result<Vec<_>, _>>()?;
+        let payloads: Vec<&[u8]> = payloads.iter().map(Vec::as_slice).collect();
+
+        let signatures = self
+            .wallet
+            .sign_batch(&payloads)
+            .map_err(|e| JsValue::from(e.to_string()))?;
+
+        Ok(signatures
+            .iter()
+            .map(|signature| Uint8Array::from(&signature[..]))
+            .collect())
+    }
+
+    /// Derives `count` addresses starting from `base_path/start`, returning an array of
+    /// `{ index, address, pubKey }` objects.
+    #[wasm_bindgen(js_name = deriveRange)]
+    pub fn derive_range(
+        &self,
+        base_path: &str,
+        start: u32,
+        count: u32,
+        hrp: &str,
+    ) -> Result<Array, JsValue> {
+        let derived = self
+            .wallet
+            .derive_range(base_path, start, count, hrp)
+            .map_err(|e| JsValue::from(e.to_string()))?;
+
+        derived
+            .iter()
+            .map(|derived| {
+                let entry = Object::new();
+                Reflect::set(&entry, &"index".into(), &derived.index.into())?;
+                Reflect::set(&entry, &"address".into(), &derived.address.as_str().into())?;
+                Reflect::set(
+                    &entry,
+                    &"pubKey".into(),
+                    &Uint8Array::from(&derived.pub_key.key.serialize()[..]),
+                )?;
+                Ok(JsValue::from(entry))
+            })
+            .collect()
+    }
 }
 
 #[wasm_bindgen(js_name = randomMnemonic)]